@@ -0,0 +1,248 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+/* This file measures the speed of reading and writing gro files.
+ * Compile it using 'make benchmarks' and run it from the 'benchmarks' directory as
+ * './gro_benchmark [SCALE]'. The benchmark creates a large gro file by replicating
+ * the atoms of 'examples/example.gro' SCALE times (default: 100, i.e. ~4.8M atoms).
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+#include <groan.h>
+
+#define INPUT_GRO_FILE "../examples/example.gro"
+#define SCALED_GRO_FILE "scaled.gro"
+
+/* Returns the current time in seconds. */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Original segment parsers slicing every segment into a newly allocated string. */
+static int legacy_parse_int(const char *line, const size_t start, const size_t len, groint_t *element)
+{
+    char *segment = malloc(len + 1);
+    get_fragment(line, segment, start, len);
+    if (!isdecimal(segment)) {
+        free(segment);
+        return 1;
+    }
+    *element = (groint_t) atoi(segment);
+    free(segment);
+    return 0;
+}
+
+static int legacy_parse_string(const char *line, const size_t start, const size_t len, char *element)
+{
+    char *segment = malloc(len + 1);
+    get_fragment(line, segment, start, len);
+    sscanf(segment, "%s", element);
+    free(segment);
+    return 0;
+}
+
+static int legacy_parse_float(const char *line, const size_t start, const size_t len, float *element)
+{
+    char *segment = malloc(len + 1);
+    get_fragment(line, segment, start, len);
+    if (!isdecimalf(segment)) {
+        free(segment);
+        return 1;
+    }
+    *element = atof(segment);
+    free(segment);
+    return 0;
+}
+
+static int legacy_parse_gro_line(const char *line, atom_t *atom)
+{
+    if (legacy_parse_int(line, 0, 5, &(atom->residue_number)) != 0) return 1;
+    if (legacy_parse_string(line, 5, 5, atom->residue_name) != 0) return 1;
+    if (legacy_parse_string(line, 10, 5, atom->atom_name) != 0) return 1;
+    if (legacy_parse_int(line, 15, 5, &(atom->atom_number)) != 0) return 1;
+    for (short i = 0; i < 3; ++i) {
+        if (legacy_parse_float(line, 20 + i * 8, 8, &(atom->position[i])) != 0) return 1;
+    }
+
+    short vel_present = 1;
+    for (short i = 44; i < 68; ++i) {
+        if (line[i] == '\0') vel_present = 0;
+    }
+
+    if (vel_present) {
+        for (short i = 0; i < 3; ++i) {
+            if (legacy_parse_float(line, 44 + i * 8, 8, &(atom->velocity[i])) != 0) return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Original gro writer using fprintf for every atom. */
+static void legacy_write_gro(FILE *stream, const atom_selection_t *atoms, const box_t boxsize, const write_mode_t write_mode, const char *comment)
+{
+    fprintf(stream, "%s\n", comment);
+    fprintf(stream, "%ld\n", atoms->n_atoms);
+
+    for (size_t i = 0; i < atoms->n_atoms; ++i) {
+        atom_t *atom = atoms->atoms[i];
+        fprintf(stream, "%5u%-5s%5s%5u%8.3f%8.3f%8.3f",
+        atom->residue_number, atom->residue_name, atom->atom_name, atom->atom_number,
+        atom->position[0], atom->position[1], atom->position[2]);
+
+        if (write_mode != no_velocities) {
+            fprintf(stream, "%8.4f%8.4f%8.4f", atom->velocity[0], atom->velocity[1], atom->velocity[2]);
+        }
+
+        fprintf(stream, "\n");
+    }
+
+    for (int i = 0; i < 9; ++i) {
+        fprintf(stream, " %9.5f", boxsize[i]);
+    }
+    fprintf(stream, "\n");
+}
+
+/* Writes a gro file containing the atoms of the system replicated 'scale' times. */
+static int write_scaled_gro(const system_t *system, size_t scale)
+{
+    FILE *output = fopen(SCALED_GRO_FILE, "w");
+    if (output == NULL) return 1;
+
+    size_t n_atoms = system->n_atoms * scale;
+    fprintf(output, "Scaled system\n%lu\n", n_atoms);
+    for (size_t s = 0; s < scale; ++s) {
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            const atom_t *atom = &(system->atoms[i]);
+            fprintf(output, "%5u%-5s%5s%5lu%8.3f%8.3f%8.3f%8.4f%8.4f%8.4f\n",
+                    atom->residue_number, atom->residue_name, atom->atom_name,
+                    (s * system->n_atoms + i + 1) % 100000,
+                    atom->position[0], atom->position[1], atom->position[2],
+                    atom->velocity[0], atom->velocity[1], atom->velocity[2]);
+        }
+    }
+    fprintf(output, "%10.5f%10.5f%10.5f\n", system->box[0], system->box[1], system->box[2]);
+
+    return fclose(output);
+}
+
+/* Reads the scaled gro file into memory and splits it into lines. Returns the atom lines. */
+static char **read_atom_lines(char **content, size_t n_atoms)
+{
+    FILE *input = fopen(SCALED_GRO_FILE, "rb");
+    if (input == NULL) return NULL;
+    fseek(input, 0, SEEK_END);
+    long size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+
+    *content = malloc(size + 1);
+    if (fread(*content, 1, size, input) != (size_t) size) {
+        fclose(input);
+        return NULL;
+    }
+    fclose(input);
+    (*content)[size] = '\0';
+
+    // skip the title and the number of atoms; terminate each line in place
+    char **lines = malloc(n_atoms * sizeof(char *));
+    char *position = strchr(strchr(*content, '\n') + 1, '\n') + 1;
+    for (size_t i = 0; i < n_atoms; ++i) {
+        lines[i] = position;
+        position = strchr(position, '\n');
+        *position++ = '\0';
+    }
+
+    return lines;
+}
+
+/* Parses all atom lines using the provided parser. Returns elapsed time. */
+static double time_parser(int (*parser)(const char *, atom_t *), char **lines, atom_t *atoms, size_t n_atoms)
+{
+    double start = now();
+    for (size_t i = 0; i < n_atoms; ++i) {
+        parser(lines[i], &(atoms[i]));
+    }
+    return now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    size_t scale = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    if (system == NULL || scale == 0) return 1;
+
+    if (write_scaled_gro(system, scale) != 0) {
+        fprintf(stderr, "Could not write %s.\n", SCALED_GRO_FILE);
+        return 1;
+    }
+    size_t n_atoms = system->n_atoms * scale;
+    printf("Benchmark gro file: %lu atoms\n\n", n_atoms);
+
+    atom_t *legacy_atoms = calloc(n_atoms, sizeof(atom_t));
+    atom_t *atoms = calloc(n_atoms, sizeof(atom_t));
+
+    char *content = NULL;
+    char **lines = read_atom_lines(&content, n_atoms);
+    if (lines == NULL) return 1;
+
+    double legacy_time = time_parser(legacy_parse_gro_line, lines, legacy_atoms, n_atoms);
+    double parse_time = time_parser(parse_gro_line, lines, atoms, n_atoms);
+    printf("%-40s %8.3f s\n", "parse_gro_line (legacy, malloc)", legacy_time);
+    printf("%-40s %8.3f s   (%.1fx)\n", "parse_gro_line (in-place)", parse_time, legacy_time / parse_time);
+
+    if (memcmp(atoms, legacy_atoms, n_atoms * sizeof(atom_t)) != 0) {
+        fprintf(stderr, "Parsed atoms differ!\n");
+        return 1;
+    }
+
+    double start = now();
+    system_t *scaled = load_gro_parallel(SCALED_GRO_FILE, 1);
+    printf("%-40s %8.3f s\n", "load_gro (1 thread)", now() - start);
+    free(scaled);
+
+    start = now();
+    scaled = load_gro(SCALED_GRO_FILE);
+    printf("%-40s %8.3f s\n", "load_gro (automatic threads)", now() - start);
+
+    select_t *all = select_system(scaled);
+    FILE *output = fopen(SCALED_GRO_FILE, "w");
+    start = now();
+    legacy_write_gro(output, all, scaled->box, velocities, "Scaled system");
+    fflush(output);
+    double legacy_write_time = now() - start;
+    fclose(output);
+    printf("\n%-40s %8.3f s\n", "write_gro (legacy, fprintf)", legacy_write_time);
+
+    output = fopen(SCALED_GRO_FILE, "w");
+    start = now();
+    write_gro(output, all, scaled->box, velocities, "Scaled system");
+    fflush(output);
+    double write_time = now() - start;
+    fclose(output);
+    printf("%-40s %8.3f s   (%.1fx)\n", "write_gro (buffered)", write_time, legacy_write_time / write_time);
+
+    output = fopen(SCALED_GRO_FILE, "w");
+    start = now();
+    write_gro_parallel(output, all, scaled->box, velocities, "Scaled system", 0);
+    fflush(output);
+    write_time = now() - start;
+    fclose(output);
+    printf("%-40s %8.3f s   (%.1fx)\n", "write_gro_parallel (automatic threads)", write_time, legacy_write_time / write_time);
+
+    free(all);
+    free(scaled);
+
+    free(lines);
+    free(content);
+    free(atoms);
+    free(legacy_atoms);
+    free(system);
+    remove(SCALED_GRO_FILE);
+    return 0;
+}
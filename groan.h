@@ -9,7 +9,15 @@
 #include "src/gro_io.h"
 #include "src/xtc_io.h"
 #include "src/trr_io.h"
+#include "src/traj_reader.h"
+#include "src/traj_index.h"
+#include "src/traj_scan.h"
+#include "src/xtc_parallel.h"
+#include "src/xtc_prefetch.h"
+#include "src/xtc_writer.h"
 #include "src/analysis_tools.h"
 #include "src/selection.h"
+#include "src/atom_bitmap.h"
+#include "src/topology_index.h"
 
 #endif /* GROAN_H */
\ No newline at end of file
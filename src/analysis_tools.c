@@ -111,6 +111,43 @@ void calc_vector(vec_t result, const vec_t particle1, const vec_t particle2, con
     result[2] = pymod(particle2[2] - particle1[2] + boxz2, box[2]) - boxz2;
 }
 
+/* Adds the position to the sums of the magic angles used to calculate center of geometry. */
+static inline void cog_accumulate(const vec_t position, const float rec_box[3], const box_t box, float sum_xi[3], float sum_zeta[3])
+{
+    // make sure that each coordinate is inside the box
+    float real_x = position[0];
+    float real_y = position[1];
+    float real_z = position[2];
+    wrap_coordinate(&real_x, box[0]);
+    wrap_coordinate(&real_y, box[1]);
+    wrap_coordinate(&real_z, box[2]);
+
+    // then calculate magic angles
+    float theta_x = real_x * rec_box[0] * M_PI_X2;
+    float theta_y = real_y * rec_box[1] * M_PI_X2;
+    float theta_z = real_z * rec_box[2] * M_PI_X2;
+    
+    sum_xi[0]     += cosf(theta_x);
+    sum_xi[1]     += cosf(theta_y);
+    sum_xi[2]     += cosf(theta_z);
+    sum_zeta[0]   += sinf(theta_x);
+    sum_zeta[1]   += sinf(theta_y);
+    sum_zeta[2]   += sinf(theta_z); 
+}
+
+/* Transforms the sums of the magic angles into center of geometry. */
+static inline void cog_finish(const float sum_xi[3], const float sum_zeta[3], vec_t center, const box_t box)
+{
+    // transform magic angles into real coordinates
+    float final_theta_x = atan2f(-sum_zeta[0], -sum_xi[0]) + M_PI;
+    float final_theta_y = atan2f(-sum_zeta[1], -sum_xi[1]) + M_PI;
+    float final_theta_z = atan2f(-sum_zeta[2], -sum_xi[2]) + M_PI;
+
+    center[0] = box[0] * (final_theta_x / M_PI_X2);
+    center[1] = box[1] * (final_theta_y / M_PI_X2);
+    center[2] = box[2] * (final_theta_z / M_PI_X2);
+}
+
 int center_of_geometry(const atom_selection_t *selection, vec_t center, box_t box)
 {
     if (selection == NULL || selection->n_atoms == 0) return 1;
@@ -120,52 +157,67 @@ int center_of_geometry(const atom_selection_t *selection, vec_t center, box_t bo
     // (except for completely homogeneous distribution)
 
     // reciprocal box sizes
-    float rec_box_x = 1 / box[0];
-    float rec_box_y = 1 / box[1];
-    float rec_box_z = 1 / box[2];
+    float rec_box[3] = {1 / box[0], 1 / box[1], 1 / box[2]};
 
     float sum_xi[3] = {0.0f};
     float sum_zeta[3] = {0.0f};
 
     for (size_t i = 0; i < selection->n_atoms; ++i) {
-        atom_t *atom = selection->atoms[i];
-
-        // make sure that each coordinate is inside the box
-        float real_x = atom->position[0];
-        float real_y = atom->position[1];
-        float real_z = atom->position[2];
-        wrap_coordinate(&real_x, box[0]);
-        wrap_coordinate(&real_y, box[1]);
-        wrap_coordinate(&real_z, box[2]);
-
-        // then calculate magic angles
-        float theta_x = real_x * rec_box_x * M_PI_X2;
-        float theta_y = real_y * rec_box_y * M_PI_X2;
-        float theta_z = real_z * rec_box_z * M_PI_X2;
-        
-        sum_xi[0]     += cosf(theta_x);
-        sum_xi[1]     += cosf(theta_y);
-        sum_xi[2]     += cosf(theta_z);
-        sum_zeta[0]   += sinf(theta_x);
-        sum_zeta[1]   += sinf(theta_y);
-        sum_zeta[2]   += sinf(theta_z); 
-        
+        cog_accumulate(selection->atoms[i]->position, rec_box, box, sum_xi, sum_zeta);
     }
 
-    // transform magic angles into real coordinates
-    float final_theta_x = atan2f(-sum_zeta[0], -sum_xi[0]) + M_PI;
-    float final_theta_y = atan2f(-sum_zeta[1], -sum_xi[1]) + M_PI;
-    float final_theta_z = atan2f(-sum_zeta[2], -sum_xi[2]) + M_PI;
-
-    center[0] = box[0] * (final_theta_x / M_PI_X2);
-    center[1] = box[1] * (final_theta_y / M_PI_X2);
-    center[2] = box[2] * (final_theta_z / M_PI_X2);
+    cog_finish(sum_xi, sum_zeta, center, box);
 
     //printf("%f %f %f\n", center[0], center[1], center[2]);
 
     return 0;
 }
 
+int center_of_geometry_block(vec_t *positions, const size_t *indices, size_t n_items, vec_t center, box_t box)
+{
+    if (positions == NULL || n_items == 0) return 1;
+
+    // same approach as in center_of_geometry()
+    float rec_box[3] = {1 / box[0], 1 / box[1], 1 / box[2]};
+
+    float sum_xi[3] = {0.0f};
+    float sum_zeta[3] = {0.0f};
+
+    // separate loops so that the contiguous case streams through the block
+    if (indices == NULL) {
+        for (size_t i = 0; i < n_items; ++i) {
+            cog_accumulate(positions[i], rec_box, box, sum_xi, sum_zeta);
+        }
+    } else {
+        for (size_t i = 0; i < n_items; ++i) {
+            cog_accumulate(positions[indices[i]], rec_box, box, sum_xi, sum_zeta);
+        }
+    }
+
+    cog_finish(sum_xi, sum_zeta, center, box);
+
+    return 0;
+}
+
+void distance3D_block(
+        vec_t *positions,
+        const size_t *indices,
+        size_t n_items,
+        const vec_t reference,
+        box_t box,
+        float *distances)
+{
+    if (indices == NULL) {
+        for (size_t i = 0; i < n_items; ++i) {
+            distances[i] = distance3D(positions[i], reference, box);
+        }
+    } else {
+        for (size_t i = 0; i < n_items; ++i) {
+            distances[i] = distance3D(positions[indices[i]], reference, box);
+        }
+    }
+}
+
 int center_of_geometry_naive(const atom_selection_t *selection, vec_t center)
 {
     if (selection == NULL || selection->n_atoms == 0) return 1;
@@ -110,6 +110,48 @@ void calc_vector(vec_t result, const vec_t particle1, const vec_t particle2, con
 int center_of_geometry(const atom_selection_t *selection, vec_t center, box_t box);
 
 
+/*! @brief Calculates center of geometry for positions stored in a contiguous block. Handles rectangular PBC.
+ *
+ * @paragraph Details
+ * Uses the same approach as center_of_geometry(), but reads positions from a contiguous
+ * array (e.g. system->positions, see system_positions_enable()) instead of atom_t structures.
+ * If indices is NULL, the first n_items positions of the block are used.
+ * Otherwise, positions[indices[0]] to positions[indices[n_items - 1]] are used
+ * (see selection_get_indices()).
+ *
+ * @param positions             contiguous block of positions
+ * @param indices               indices of positions to use or NULL
+ * @param n_items               number of positions to use
+ * @param center                pointer to an array for saving center of geometry
+ * @param box                   current size of the simulation box
+ *
+ * @return Zero, if successful; else non-zero.
+ */
+int center_of_geometry_block(vec_t *positions, const size_t *indices, size_t n_items, vec_t center, box_t box);
+
+
+/*! @brief Calculates distances of positions stored in a contiguous block from a reference point. Handles rectangular PBC.
+ *
+ * @paragraph Details
+ * Equivalent to calling distance3D() for every position. If indices is NULL, the first n_items positions
+ * of the block are used. Otherwise, positions[indices[0]] to positions[indices[n_items - 1]] are used.
+ *
+ * @param positions             contiguous block of positions
+ * @param indices               indices of positions to use or NULL
+ * @param n_items               number of positions to use
+ * @param reference             reference point
+ * @param box                   current size of the simulation box
+ * @param distances             array of n_items floats for saving the distances
+ */
+void distance3D_block(
+        vec_t *positions,
+        const size_t *indices,
+        size_t n_items,
+        const vec_t reference,
+        box_t box,
+        float *distances);
+
+
 /*! @brief Calculates center of geometry for selected atoms DISREGARDING PBC!
  * 
  * @param selection             selection of atoms
@@ -0,0 +1,148 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <string.h>
+#include "selection.h"
+
+/*! @brief Counts set bits in a 64-bit word. */
+static inline size_t popcount64(uint64_t word)
+{
+#ifdef __GNUC__
+    return (size_t) __builtin_popcountll(word);
+#else
+    size_t count = 0;
+    for (; word != 0; word &= word - 1) ++count;
+    return count;
+#endif
+}
+
+/*! @brief Returns the index of the lowest set bit of a non-zero 64-bit word. */
+static inline size_t lowest_bit64(uint64_t word)
+{
+#ifdef __GNUC__
+    return (size_t) __builtin_ctzll(word);
+#else
+    size_t index = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+/*! @brief Gets the index of the bit corresponding to the atom. Returns 0 if the atom is covered by the bitmap, else 1. */
+static inline int atom_bitmap_index(const atom_bitmap_t *bitmap, const atom_t *atom, size_t *index)
+{
+    // atoms are compared as addresses so that pointers into other arrays are handled safely
+    uintptr_t offset = (uintptr_t) atom - (uintptr_t) bitmap->base;
+    if (offset % sizeof(atom_t) != 0) return 1;
+
+    size_t i = offset / sizeof(atom_t);
+    if (i >= bitmap->n_atoms) return 1;
+
+    *index = i;
+    return 0;
+}
+
+atom_bitmap_t *atom_bitmap_create(atom_t *base, size_t n_atoms)
+{
+    size_t n_words = (n_atoms + 63) / 64;
+    atom_bitmap_t *bitmap = calloc(1, sizeof(atom_bitmap_t) + n_words * sizeof(uint64_t));
+    if (bitmap == NULL) return NULL;
+
+    bitmap->base = base;
+    bitmap->n_atoms = n_atoms;
+    bitmap->n_words = n_words;
+
+    return bitmap;
+}
+
+atom_bitmap_t *atom_bitmap_from_selection(const atom_selection_t *selection, system_t *system)
+{
+    atom_bitmap_t *bitmap = atom_bitmap_create(system->atoms, system->n_atoms);
+    if (bitmap == NULL) return NULL;
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        if (atom_bitmap_add(bitmap, selection->atoms[i]) != 0) {
+            free(bitmap);
+            return NULL;
+        }
+    }
+
+    return bitmap;
+}
+
+atom_selection_t *atom_bitmap_to_selection(const atom_bitmap_t *bitmap)
+{
+    atom_selection_t *selection = selection_create(atom_bitmap_count(bitmap));
+
+    for (size_t w = 0; w < bitmap->n_words; ++w) {
+        uint64_t word = bitmap->words[w];
+        while (word != 0) {
+            selection->atoms[selection->n_atoms++] = &(bitmap->base[w * 64 + lowest_bit64(word)]);
+            word &= word - 1;
+        }
+    }
+
+    return selection;
+}
+
+int atom_bitmap_add(atom_bitmap_t *bitmap, const atom_t *atom)
+{
+    size_t index = 0;
+    if (atom_bitmap_index(bitmap, atom, &index) != 0) return 1;
+
+    bitmap->words[index / 64] |= (uint64_t) 1 << (index % 64);
+    return 0;
+}
+
+int atom_bitmap_contains(const atom_bitmap_t *bitmap, const atom_t *atom)
+{
+    size_t index = 0;
+    if (atom_bitmap_index(bitmap, atom, &index) != 0) return 0;
+
+    return (bitmap->words[index / 64] >> (index % 64)) & 1;
+}
+
+size_t atom_bitmap_count(const atom_bitmap_t *bitmap)
+{
+    size_t count = 0;
+    for (size_t w = 0; w < bitmap->n_words; ++w) count += popcount64(bitmap->words[w]);
+
+    return count;
+}
+
+int atom_bitmap_union(atom_bitmap_t *result, const atom_bitmap_t *other)
+{
+    if (result->base != other->base || result->n_atoms != other->n_atoms) return 1;
+
+    for (size_t w = 0; w < result->n_words; ++w) result->words[w] |= other->words[w];
+    return 0;
+}
+
+int atom_bitmap_intersect(atom_bitmap_t *result, const atom_bitmap_t *other)
+{
+    if (result->base != other->base || result->n_atoms != other->n_atoms) return 1;
+
+    for (size_t w = 0; w < result->n_words; ++w) result->words[w] &= other->words[w];
+    return 0;
+}
+
+int atom_bitmap_difference(atom_bitmap_t *result, const atom_bitmap_t *other)
+{
+    if (result->base != other->base || result->n_atoms != other->n_atoms) return 1;
+
+    for (size_t w = 0; w < result->n_words; ++w) result->words[w] &= ~other->words[w];
+    return 0;
+}
+
+void atom_bitmap_complement(atom_bitmap_t *bitmap)
+{
+    for (size_t w = 0; w < bitmap->n_words; ++w) bitmap->words[w] = ~bitmap->words[w];
+
+    // bits beyond the covered atoms must stay unset
+    if (bitmap->n_atoms % 64 != 0) {
+        bitmap->words[bitmap->n_words - 1] &= ((uint64_t) 1 << (bitmap->n_atoms % 64)) - 1;
+    }
+}
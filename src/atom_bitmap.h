@@ -0,0 +1,113 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef ATOM_BITMAP_H
+#define ATOM_BITMAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "gro.h"
+
+/*! @brief Set of atoms of a system represented as an array of bits.
+ *
+ * @paragraph Details
+ * Bit i corresponds to the atom base[i], i.e. to the atom with index i in system->atoms if the bitmap
+ * was created for a system. Unlike atom_selection_t, the bitmap contains every atom at most once and
+ * does not keep any order. Set operations on two bitmaps covering the same atoms process 64 atoms at once.
+ *
+ * Bitmaps are allocated as a single block of memory and can be deallocated using free().
+ */
+typedef struct atom_bitmap {
+    atom_t *base;           /* atom corresponding to the first bit */
+    size_t n_atoms;         /* number of atoms covered by the bitmap */
+    size_t n_words;         /* number of 64-bit words */
+    uint64_t words[];       /* bits; bits beyond n_atoms are always zero */
+} atom_bitmap_t;
+
+
+/*! @brief Creates an empty bitmap covering n_atoms atoms starting at base.
+ *
+ * @paragraph Details
+ * To create a bitmap for all atoms of a system, use atom_bitmap_create(system->atoms, system->n_atoms).
+ *
+ * @param base          first atom covered by the bitmap
+ * @param n_atoms       number of atoms covered by the bitmap
+ *
+ * @return Pointer to the created atom_bitmap_t structure. NULL if the memory could not be allocated.
+ */
+atom_bitmap_t *atom_bitmap_create(atom_t *base, size_t n_atoms);
+
+
+/*! @brief Creates a bitmap of the atoms of a selection.
+ *
+ * @param selection     selection of atoms
+ * @param system        system containing the selected atoms
+ *
+ * @return Pointer to the created atom_bitmap_t structure. NULL if any of the selected atoms
+ * does not belong to the system or if the memory could not be allocated.
+ */
+atom_bitmap_t *atom_bitmap_from_selection(const atom_selection_t *selection, system_t *system);
+
+
+/*! @brief Creates a selection of the atoms present in the bitmap.
+ *
+ * @paragraph Details
+ * Atoms in the selection are ordered in the same way as in the system.
+ *
+ * @param bitmap        bitmap of atoms
+ *
+ * @return Pointer to the created atom_selection_t structure.
+ */
+atom_selection_t *atom_bitmap_to_selection(const atom_bitmap_t *bitmap);
+
+
+/*! @brief Adds an atom to the bitmap.
+ *
+ * @param bitmap        bitmap to change
+ * @param atom          atom to add
+ *
+ * @return 0 if successful, 1 if the atom is not covered by the bitmap.
+ */
+int atom_bitmap_add(atom_bitmap_t *bitmap, const atom_t *atom);
+
+
+/*! @brief Checks whether the atom is present in the bitmap.
+ *
+ * @param bitmap        bitmap of atoms
+ * @param atom          atom to look for
+ *
+ * @return 1 if the atom is present, 0 if it is not present or if it is not covered by the bitmap.
+ */
+int atom_bitmap_contains(const atom_bitmap_t *bitmap, const atom_t *atom);
+
+
+/*! @brief Returns the number of atoms present in the bitmap. */
+size_t atom_bitmap_count(const atom_bitmap_t *bitmap);
+
+
+/*! @brief Adds all atoms of 'other' to 'result'.
+ *
+ * @paragraph Details
+ * Both bitmaps must cover the same atoms (same base and n_atoms). The same applies to
+ * atom_bitmap_intersect() and atom_bitmap_difference().
+ *
+ * @param result        bitmap to change
+ * @param other         bitmap of atoms to add
+ *
+ * @return 0 if successful, 1 if the bitmaps do not cover the same atoms.
+ */
+int atom_bitmap_union(atom_bitmap_t *result, const atom_bitmap_t *other);
+
+
+/*! @brief Removes all atoms that are not present in 'other' from 'result'. Returns 0 if successful, else 1. */
+int atom_bitmap_intersect(atom_bitmap_t *result, const atom_bitmap_t *other);
+
+
+/*! @brief Removes all atoms present in 'other' from 'result'. Returns 0 if successful, else 1. */
+int atom_bitmap_difference(atom_bitmap_t *result, const atom_bitmap_t *other);
+
+
+/*! @brief Replaces the atoms in the bitmap with all the covered atoms that were not present in it. */
+void atom_bitmap_complement(atom_bitmap_t *bitmap);
+
+#endif /* ATOM_BITMAP_H */
@@ -20,21 +20,32 @@ typedef uint32_t groint_t;
 /* An array of nine floats. */
 typedef float box_t[9];
 
-/* Structure containing all the available information about a specific atom. */
+/* Structure containing all the available information about a specific atom.
+ * gmx_atom_number is the last member so that the structure contains no padding (64 bytes on 64-bit systems). */
 typedef struct atom {
     groint_t residue_number;
     char residue_name[6];
     char atom_name[6];
     groint_t atom_number;      /* this is an atom number as taken from gro file */
-    size_t gmx_atom_number;    /* this is an atom number as gromacs uses it */
     vec_t position;
     vec_t velocity;
     vec_t force;
+    size_t gmx_atom_number;    /* this is an atom number as gromacs uses it */
 } atom_t;
 
+/* Lookup tables of names and numbers of atoms of a system (see topology_index.h). */
+struct topology_index;
+
 /*
  * Structure containing information about the system, or more specifically
  * about the simulation box, time-step of the simulation, and the atoms in the system.
+ *
+ * If 'positions' is not NULL, it is a contiguous block of n_atoms positions
+ * (see system_positions_enable()) into which the trajectory readers write
+ * the positions of atoms instead of the atoms themselves.
+ *
+ * If 'topology' is not NULL, it is the topology index of the system (see system_topology_enable())
+ * used by the selection functions taking the system as an argument (e.g. smart_select_system()).
  */
 typedef struct system {
     box_t box;           /* box dimensions */
@@ -42,6 +53,8 @@ typedef struct system {
     float time;          /* simulation time in ps */
     float precision;     /* input precision of positions*/
     float lambda;        /* gromacs lambda value */
+    vec_t *positions;    /* optional contiguous block of positions of atoms (NULL if not used) */
+    struct topology_index *topology; /* optional topology index of the system (NULL if not used) */
     size_t n_atoms;      /* number of atoms in the system */
     atom_t atoms[];      /* array of atoms in the system */
 } system_t;
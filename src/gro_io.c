@@ -1,8 +1,34 @@
 // Released under MIT License.
 // Copyright (c) 2022 Ladislav Bartos
 
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
 #include "gro_io.h"
 
+/* Gro files are memory-mapped and processed in parallel on systems supporting POSIX mmap and threads. */
+#if defined(__unix__) || defined(__APPLE__)
+#define GRO_MMAP
+#define GRO_THREADS
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Minimal number of atoms parsed by a single thread when the number of threads is chosen automatically. */
+#define GRO_ATOMS_PER_THREAD 20000
+
+/* Maximal number of threads used when the number of threads is chosen automatically. */
+#define GRO_MAX_THREADS 16
+
+/* Number of atoms formatted into a single output buffer by write_gro_parallel(). */
+#define GRO_WRITE_CHUNK 16384
+
+/* Upper bound of the length of a single formatted field; longer fields are only produced for huge floats. */
+#define GRO_MAX_FIELD 64
+
 int isdecimal(const char *string) 
 {
     short plusminus = 0;
@@ -37,47 +63,122 @@ void get_fragment(const char *src, char *dest, const size_t start, const size_t
     dest[len] = '\0';
 }
 
+/* 
+ * The following functions parse the segments directly from the line, without copying them.
+ * The validation is the same as performed by isdecimal() and isdecimalf() for the sliced segment
+ * and the parsed values are identical to the values obtained using atoi(), atof() and sscanf("%s").
+ */
+
+/* Character classification equivalent to isdigit(), isblank() and isspace() in the "C" locale, but inlined. */
+static inline int is_digit_c(const char c) { return c >= '0' && c <= '9'; }
+static inline int is_blank_c(const char c) { return c == ' ' || c == '\t'; }
+static inline int is_space_c(const char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/* Powers of ten exactly representable as doubles. */
+static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
 int parse_int(const char *line, const size_t start, const size_t len, groint_t *element)
 {
-    char *segment = malloc(len + 1);
-    get_fragment(line, segment, start, len);
-    // check that only digits were loaded
-    if (!isdecimal(segment)) {
-        free(segment);
-        return 1;
+    const char *segment = line + start;
+
+    // check that only digits were loaded (same as isdecimal)
+    size_t end = 0;
+    short plusminus = 0;
+    for (; end < len && segment[end] != '\0'; ++end) {
+        if (!is_digit_c(segment[end]) && !is_blank_c(segment[end])) {
+            if (plusminus == 0 && (segment[end] == '+' || segment[end] == '-') ) ++plusminus;
+            else return 1;
+        }
     }
 
     // TODO: check that the segment is not negative
-    *element = (groint_t) atoi(segment);
+    // same as atoi: skip whitespace, read optional sign and then digits until the first non-digit
+    size_t i = 0;
+    while (i < end && is_blank_c(segment[i])) ++i;
+
+    int negative = 0;
+    if (i < end && (segment[i] == '+' || segment[i] == '-')) {
+        negative = segment[i] == '-';
+        ++i;
+    }
+
+    unsigned int value = 0;
+    for (; i < end && is_digit_c(segment[i]); ++i) value = 10 * value + (unsigned int) (segment[i] - '0');
 
-    free(segment);
+    *element = (groint_t) (negative ? -value : value);
     return 0;
 }
 
 int parse_string(const char *line, const size_t start, const size_t len, char *element)
 {
-    char *segment = malloc(len + 1);
-    get_fragment(line, segment, start, len);
+    const char *segment = line + start;
+
     // trim string; this will only work if there is only one word
-    sscanf(segment, "%s", element);
+    size_t i = 0;
+    while (i < len && segment[i] != '\0' && is_space_c(segment[i])) ++i;
+
+    // element is not changed if the segment only contains whitespace (same as sscanf)
+    if (i >= len || segment[i] == '\0') return 0;
+
+    size_t n = 0;
+    for (; i < len && segment[i] != '\0' && !is_space_c(segment[i]); ++i) element[n++] = segment[i];
+    element[n] = '\0';
 
-    free(segment);
     return 0;
 
 }
 
 int parse_float(const char *line, const size_t start, const size_t len, float *element)
 {
-    char *segment = malloc(len + 1);
-    get_fragment(line, segment, start, len);
-    // check that only digits or '.' were loaded
-    if (!isdecimalf(segment)) {
-        free(segment);
-        return 1;
+    const char *segment = line + start;
+
+    // check that only digits or '.' were loaded (same as isdecimalf)
+    size_t end = 0;
+    short point = 0;
+    short plusminus = 0;
+    for (; end < len && segment[end] != '\0'; ++end) {
+        if (!is_digit_c(segment[end]) && !is_blank_c(segment[end])) {
+            if (point == 0 && segment[end] == '.') ++point;
+            else if (plusminus == 0 && (segment[end] == '+' || segment[end] == '-') ) ++plusminus;
+            else return 1;
+        }
+    }
+
+    // same as atof: skip whitespace, read optional sign, digits, optional '.' and digits
+    size_t i = 0;
+    while (i < end && is_blank_c(segment[i])) ++i;
+
+    int negative = 0;
+    if (i < end && (segment[i] == '+' || segment[i] == '-')) {
+        negative = segment[i] == '-';
+        ++i;
+    }
+
+    // the value is read as an integer mantissa and the number of decimal places
+    int64_t mantissa = 0;
+    int n_digits = 0;
+    int decimals = 0;
+    for (; i < end && is_digit_c(segment[i]); ++i, ++n_digits) mantissa = 10 * mantissa + (segment[i] - '0');
+    if (i < end && segment[i] == '.') {
+        for (++i; i < end && is_digit_c(segment[i]); ++i, ++n_digits, ++decimals) mantissa = 10 * mantissa + (segment[i] - '0');
+    }
+
+    // fall back to the library conversion for unusually long segments
+    if (n_digits > 15) {
+        char buffer[64] = "";
+        memcpy(buffer, segment, end < sizeof(buffer) - 1 ? end : sizeof(buffer) - 1);
+        *element = atof(buffer);
+        return 0;
     }
-    *element = atof(segment);
-    
-    free(segment);
+
+    // atof returns positive zero if no digits are found
+    if (n_digits == 0) negative = 0;
+
+    // both the mantissa and the power of ten are exact, so the division is rounded
+    // exactly like the conversion performed by atof
+    double value = (double) mantissa / powers_of_ten[decimals];
+
+    *element = (float) (negative ? -value : value);
     return 0;
 }
 
@@ -117,7 +218,8 @@ int parse_gro_line(const char *line, atom_t *atom)
 
 }
 
-system_t *load_gro(const char *filename)
+/*! @brief Reads a gro file line by line. Prints an error message and returns NULL if the file is invalid. */
+static system_t *load_gro_serial(const char *filename)
 {
     FILE *gro_file = fopen(filename, "r");
     if (gro_file == NULL) {
@@ -205,41 +307,446 @@ system_t *load_gro(const char *filename)
 
 }
 
-int write_gro(
+#ifdef GRO_MMAP
+
+/* Range of atoms parsed by a single thread. */
+typedef struct gro_range {
+    const char *lines;      /* start of the first atom line in the file */
+    size_t line_length;     /* length of each atom line including the newline character */
+    size_t first;           /* index of the first atom of the range */
+    size_t last;            /* index after the last atom of the range */
+    atom_t *atoms;          /* atoms of the system */
+    pthread_t thread;
+    int error;              /* set if the range could not be parsed */
+} gro_range_t;
+
+/*! @brief Parses a range of atom lines of a memory-mapped gro file. */
+static void *gro_parse_range(void *arg)
+{
+    gro_range_t *range = (gro_range_t *) arg;
+    size_t length = range->line_length;
+
+    // the memory for the atoms is only cleared here, so that it is touched by the thread using it
+    memset(&(range->atoms[range->first]), 0, (range->last - range->first) * sizeof(atom_t));
+
+    char line[1024] = "";
+    for (size_t i = range->first; i < range->last; ++i) {
+        const char *source = range->lines + i * length;
+
+        // each line must have the same length as the first one
+        if (source[length - 1] != '\n' || memchr(source, '\n', length - 1) != NULL) {
+            range->error = 1;
+            return NULL;
+        }
+
+        // the line is terminated exactly like a line read using fgets
+        memcpy(line, source, length);
+        line[length] = '\0';
+
+        if (parse_gro_line(line, &(range->atoms[i])) != 0) {
+            range->error = 1;
+            return NULL;
+        }
+
+        // assign real gromacs atom number
+        range->atoms[i].gmx_atom_number = i + 1;
+    }
+
+    return NULL;
+}
+
+/*! @brief Copies the line starting at 'start' into 'line' like fgets would. Returns the position after the line or NULL. */
+static const char *gro_get_line(const char *start, const char *end, char *line)
+{
+    const char *newline = memchr(start, '\n', end - start);
+    if (newline == NULL) return NULL;
+
+    // longer lines would be split by fgets
+    size_t length = newline - start + 1;
+    if (length > 1023) return NULL;
+
+    memcpy(line, start, length);
+    line[length] = '\0';
+    return newline + 1;
+}
+
+/*! @brief Parses a memory-mapped gro file with regular atom lines. Returns NULL if the file is irregular or invalid. */
+static system_t *gro_parse_mapped(const char *data, size_t size, size_t n_threads)
+{
+    const char *end = data + size;
+    char line[1024] = "";
+
+    // title line
+    const char *position = gro_get_line(data, end, line);
+    if (position == NULL) return NULL;
+
+    // number of atoms
+    position = gro_get_line(position, end, line);
+    if (position == NULL) return NULL;
+
+    size_t n_atoms = 0;
+    if (sscanf(line, "%lu", &n_atoms) != 1) return NULL;
+
+    // the length of all atom lines must be the same as the length of the first atom line
+    const char *first_line = position;
+    const char *newline = memchr(first_line, '\n', end - first_line);
+    if (newline == NULL) return NULL;
+    size_t line_length = newline - first_line + 1;
+    if (line_length > 1023 || n_atoms > (size_t) (end - first_line) / line_length) return NULL;
+
+    // read information about the simulation box
+    position = first_line + n_atoms * line_length;
+    size_t box_length = end - position < 1023 ? (size_t) (end - position) : 1023;
+    const char *box_end = memchr(position, '\n', box_length);
+    if (box_end != NULL) box_length = box_end - position + 1;
+    if (box_length == 0) return NULL;
+    memcpy(line, position, box_length);
+    line[box_length] = '\0';
+
+    // memory for the atoms is cleared by the threads
+    system_t *system = malloc(sizeof(system_t) + n_atoms * sizeof(atom_t));
+    if (system == NULL) return NULL;
+    memset(system, 0, sizeof(system_t));
+    system->n_atoms = n_atoms;
+    system->precision = 1000.;
+
+    int loaded_values = sscanf(line, "%f %f %f %f %f %f %f %f %f",
+    &(system->box[0]), &(system->box[1]), &(system->box[2]),
+    &(system->box[3]), &(system->box[4]), &(system->box[5]), 
+    &(system->box[6]), &(system->box[7]), &(system->box[8]));
+
+    if (loaded_values != 9 && loaded_values != 3) {
+        free(system);
+        return NULL;
+    }
+
+    if (n_threads == 0) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n_cpus > 0 ? (size_t) n_cpus : 1;
+        if (n_threads > GRO_MAX_THREADS) n_threads = GRO_MAX_THREADS;
+        if (n_threads > n_atoms / GRO_ATOMS_PER_THREAD) n_threads = n_atoms / GRO_ATOMS_PER_THREAD;
+    }
+    if (n_threads > n_atoms) n_threads = n_atoms;
+    if (n_threads == 0) n_threads = 1;
+
+    gro_range_t *ranges = calloc(n_threads, sizeof(gro_range_t));
+    if (ranges == NULL) {
+        free(system);
+        return NULL;
+    }
+
+    size_t n_started = 0;
+    for (size_t t = 0; t < n_threads; ++t) {
+        gro_range_t *range = &(ranges[t]);
+        range->lines = first_line;
+        range->line_length = line_length;
+        range->first = t * n_atoms / n_threads;
+        range->last = (t + 1) * n_atoms / n_threads;
+        range->atoms = system->atoms;
+
+        // the first range is parsed by the calling thread
+        if (t == 0) continue;
+        if (pthread_create(&(range->thread), NULL, gro_parse_range, range) != 0) break;
+        ++n_started;
+    }
+
+    // ranges for which a thread could not be started are parsed by the calling thread
+    gro_parse_range(&(ranges[0]));
+    for (size_t t = n_started + 1; t < n_threads; ++t) gro_parse_range(&(ranges[t]));
+    for (size_t t = 1; t <= n_started; ++t) pthread_join(ranges[t].thread, NULL);
+
+    int error = 0;
+    for (size_t t = 0; t < n_threads; ++t) error |= ranges[t].error;
+    free(ranges);
+
+    if (error) {
+        free(system);
+        return NULL;
+    }
+
+    return system;
+}
+
+#endif /* GRO_MMAP */
+
+system_t *load_gro_parallel(const char *filename, size_t n_threads)
+{
+#ifdef GRO_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        system_t *system = NULL;
+
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                posix_madvise(data, (size_t) info.st_size, POSIX_MADV_SEQUENTIAL);
+                system = gro_parse_mapped((const char *) data, (size_t) info.st_size, n_threads);
+                munmap(data, (size_t) info.st_size);
+            }
+        }
+
+        close(fd);
+        if (system != NULL) return system;
+    }
+#else
+    (void) n_threads;
+#endif
+
+    // irregular or invalid files are read line by line; this also reports the errors
+    return load_gro_serial(filename);
+}
+
+system_t *load_gro(const char *filename)
+{
+    return load_gro_parallel(filename, 0);
+}
+
+/* Powers of ten used to convert floats into fixed-point numbers. */
+static const double write_powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5};
+
+/*! @brief Writes 'length' characters of 'string' into 'out' padded with spaces to 'width'. Returns the end of the output. */
+static inline char *gro_format_padded(char *out, const char *string, size_t length, size_t width, int left)
+{
+    size_t padding = length < width ? width - length : 0;
+    if (!left) {
+        memset(out, ' ', padding);
+        out += padding;
+    }
+    memcpy(out, string, length);
+    out += length;
+    if (left) {
+        memset(out, ' ', padding);
+        out += padding;
+    }
+    return out;
+}
+
+/*! @brief Formats an unsigned integer like printf("%*u"). Returns the end of the output. */
+static inline char *gro_format_uint(char *out, unsigned int value, size_t width)
+{
+    char digits[16];
+    size_t n = sizeof(digits);
+    do {
+        digits[--n] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    return gro_format_padded(out, digits + n, sizeof(digits) - n, width, 0);
+}
+
+/*! @brief Formats a float like printf("%*.*f"). Returns the end of the output.
+ *
+ * The float multiplied by a power of ten (at most 10^5) is exactly representable as a double,
+ * so rounding it to an integer in the current rounding mode gives exactly the digits printed by printf.
+ */
+static inline char *gro_format_fixed(char *out, float value, size_t width, int decimals)
+{
+    double scaled = (double) value * write_powers_of_ten[decimals];
+
+    // huge values, infinities and NaNs are formatted by the library
+    if (!(fabs(scaled) < 1e15)) {
+        return out + sprintf(out, "%*.*f", (int) width, decimals, (double) value);
+    }
+
+    uint64_t number = (uint64_t) fabs(nearbyint(scaled));
+
+    char digits[32];
+    size_t n = sizeof(digits);
+    for (int i = 0; i < decimals; ++i) {
+        digits[--n] = '0' + number % 10;
+        number /= 10;
+    }
+    if (decimals > 0) digits[--n] = '.';
+    do {
+        digits[--n] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    // printf keeps the sign of negative values rounded to zero
+    if (signbit(value)) digits[--n] = '-';
+
+    return gro_format_padded(out, digits + n, sizeof(digits) - n, width, 0);
+}
+
+/* Chunk of atoms formatted into a single output buffer. */
+typedef struct gro_chunk {
+    const atom_selection_t *atoms;
+    write_mode_t write_mode;
+    size_t first;           /* index of the first atom of the chunk */
+    size_t last;            /* index after the last atom of the chunk */
+    char *buffer;
+    size_t size;            /* number of bytes written into the buffer */
+    size_t capacity;        /* number of bytes allocated for the buffer */
+    int error;              /* set if the buffer could not be allocated */
+#ifdef GRO_THREADS
+    pthread_t thread;
+#endif
+} gro_chunk_t;
+
+/*! @brief Formats the atoms of the chunk into its buffer. */
+static void *gro_format_chunk(void *arg)
+{
+    gro_chunk_t *chunk = (gro_chunk_t *) arg;
+    chunk->size = 0;
+
+    // 10 fields, each at most GRO_MAX_FIELD characters, and the newline
+    const size_t max_line = 10 * GRO_MAX_FIELD + 1;
+
+    for (size_t i = chunk->first; i < chunk->last; ++i) {
+        if (chunk->capacity - chunk->size < max_line) {
+            size_t new_capacity = 2 * chunk->capacity + 64 * max_line;
+            char *new_buffer = realloc(chunk->buffer, new_capacity);
+            if (new_buffer == NULL) {
+                chunk->error = 1;
+                return NULL;
+            }
+            chunk->buffer = new_buffer;
+            chunk->capacity = new_capacity;
+        }
+
+        const atom_t *atom = chunk->atoms->atoms[i];
+        char *out = chunk->buffer + chunk->size;
+
+        // same as "%5u%-5s%5s%5u%8.3f%8.3f%8.3f"
+        out = gro_format_uint(out, atom->residue_number, 5);
+        out = gro_format_padded(out, atom->residue_name, strlen(atom->residue_name), 5, 1);
+        out = gro_format_padded(out, atom->atom_name, strlen(atom->atom_name), 5, 0);
+        out = gro_format_uint(out, atom->atom_number, 5);
+        for (int d = 0; d < 3; ++d) out = gro_format_fixed(out, atom->position[d], 8, 3);
+
+        // same as "%8.4f%8.4f%8.4f"
+        if (chunk->write_mode != no_velocities) {
+            for (int d = 0; d < 3; ++d) out = gro_format_fixed(out, atom->velocity[d], 8, 4);
+        }
+
+        *out++ = '\n';
+        chunk->size = out - chunk->buffer;
+    }
+
+    return NULL;
+}
+
+int write_gro_parallel(
         FILE *stream, 
         const atom_selection_t *atoms,
         const box_t boxsize,
         const write_mode_t write_mode,
-        const char *comment)
+        const char *comment,
+        size_t n_threads)
 {
     if (atoms == NULL || stream == NULL) return 1;
 
-    fprintf(stream, "%s\n", comment);
-    fprintf(stream, "%ld\n", atoms->n_atoms);
-
-    // loop through atoms printing information about them
-    for (size_t i = 0; i < atoms->n_atoms; ++i) {
+#ifdef GRO_THREADS
+    if (n_threads == 0) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n_cpus > 0 ? (size_t) n_cpus : 1;
+        if (n_threads > GRO_MAX_THREADS) n_threads = GRO_MAX_THREADS;
+    }
+#else
+    n_threads = 1;
+#endif
+    // there is no point in using more threads than chunks
+    size_t n_chunks = (atoms->n_atoms + GRO_WRITE_CHUNK - 1) / GRO_WRITE_CHUNK;
+    if (n_threads > n_chunks) n_threads = n_chunks;
+    if (n_threads == 0) n_threads = 1;
 
-        atom_t *atom = atoms->atoms[i];
+    gro_chunk_t *chunks = calloc(n_threads, sizeof(gro_chunk_t));
+    if (chunks == NULL) return 1;
 
-        fprintf(stream, "%5u%-5s%5s%5u%8.3f%8.3f%8.3f",
-        atom->residue_number, atom->residue_name, atom->atom_name, atom->atom_number,
-        atom->position[0], atom->position[1], atom->position[2]);
+    fprintf(stream, "%s\n", comment);
+    fprintf(stream, "%ld\n", atoms->n_atoms);
 
-        // print velocities if not forbidden
-        if (write_mode != no_velocities) {
-            fprintf(stream, "%8.4f%8.4f%8.4f", 
-            atom->velocity[0], atom->velocity[1], atom->velocity[2]);
+    // chunks of atoms are formatted by n_threads threads at once and then written in order
+    int error = 0;
+    for (size_t start = 0; start < atoms->n_atoms && !error; start += n_threads * GRO_WRITE_CHUNK) {
+        size_t n_used = 0;
+        for (size_t t = 0; t < n_threads && start + t * GRO_WRITE_CHUNK < atoms->n_atoms; ++t, ++n_used) {
+            gro_chunk_t *chunk = &(chunks[t]);
+            chunk->atoms = atoms;
+            chunk->write_mode = write_mode;
+            chunk->first = start + t * GRO_WRITE_CHUNK;
+            chunk->last = chunk->first + GRO_WRITE_CHUNK < atoms->n_atoms ? chunk->first + GRO_WRITE_CHUNK : atoms->n_atoms;
         }
 
-        fprintf(stream, "\n");
+#ifdef GRO_THREADS
+        // the first chunk is formatted by the calling thread; chunks for which
+        // a thread could not be started are formatted by the calling thread too
+        size_t n_started = 0;
+        for (size_t t = 1; t < n_used; ++t, ++n_started) {
+            if (pthread_create(&(chunks[t].thread), NULL, gro_format_chunk, &(chunks[t])) != 0) break;
+        }
+        gro_format_chunk(&(chunks[0]));
+        for (size_t t = n_started + 1; t < n_used; ++t) gro_format_chunk(&(chunks[t]));
+        for (size_t t = 1; t <= n_started; ++t) pthread_join(chunks[t].thread, NULL);
+#else
+        gro_format_chunk(&(chunks[0]));
+#endif
+
+        for (size_t t = 0; t < n_used; ++t) {
+            if (chunks[t].error || fwrite(chunks[t].buffer, 1, chunks[t].size, stream) != chunks[t].size) {
+                error = 1;
+                break;
+            }
+        }
     }
 
+    for (size_t t = 0; t < n_threads; ++t) free(chunks[t].buffer);
+    free(chunks);
+    if (error) return 1;
+
     // print box information
+    char box_line[9 * (GRO_MAX_FIELD + 1) + 2];
+    char *out = box_line;
     for (int i = 0; i < 9; ++i) {
-        fprintf(stream, " %9.5f", boxsize[i]);
+        *out++ = ' ';
+        out = gro_format_fixed(out, boxsize[i], 9, 5);
     }
-    fprintf(stream, "\n");
+    *out++ = '\n';
+    if (fwrite(box_line, 1, out - box_line, stream) != (size_t) (out - box_line)) return 1;
 
     return 0;
-}
\ No newline at end of file
+}
+
+int write_gro(
+        FILE *stream, 
+        const atom_selection_t *atoms,
+        const box_t boxsize,
+        const write_mode_t write_mode,
+        const char *comment)
+{
+    return write_gro_parallel(stream, atoms, boxsize, write_mode, comment, 1);
+}
+
+int system_positions_enable(system_t *system)
+{
+    if (system->positions == NULL) {
+        // at least one item is allocated so that the block can be enabled even for empty systems
+        system->positions = malloc((system->n_atoms > 0 ? system->n_atoms : 1) * sizeof(vec_t));
+        if (system->positions == NULL) return 1;
+    }
+
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        memcpy(system->positions[i], system->atoms[i].position, sizeof(vec_t));
+    }
+
+    return 0;
+}
+
+void system_positions_sync(system_t *system)
+{
+    if (system->positions == NULL) return;
+
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        memcpy(system->atoms[i].position, system->positions[i], sizeof(vec_t));
+    }
+}
+
+void system_positions_disable(system_t *system)
+{
+    if (system->positions == NULL) return;
+
+    system_positions_sync(system);
+    free(system->positions);
+    system->positions = NULL;
+}
@@ -49,7 +49,9 @@ void get_fragment(const char *src, char *dest, const size_t start, const size_t
 
 /*! @brief Reads a target part of line and parses it into a gro integer (groint_t).
  * 
- * Uses get_fragment() function to slice the line.
+ * The segment is parsed directly from the line, no memory is allocated.
+ * Validation is identical to isdecimal() applied to the segment and
+ * the parsed value is identical to atoi() applied to the segment.
  * 
  * @param line      line to parse
  * @param start     index from which the line will be parsed
@@ -62,7 +64,8 @@ int parse_int(const char *line, const size_t start, const size_t len, groint_t *
 
 /*! @brief Reads a target part of line, trims it and copies it to the provided pointer.
  * 
- * Uses get_fragment() function to slice the line.
+ * The segment is parsed directly from the line, no memory is allocated.
+ * If the segment only contains whitespace, element is not changed.
  * 
  * @param line      line to parse
  * @param start     index from which the line will be parsed
@@ -75,7 +78,11 @@ int parse_string(const char *line, const size_t start, const size_t len, char *e
 
 /*! @brief Reads a target part of line and parses it into a float.
  * 
- * Uses get_fragment() function to slice the line.
+ * The segment is parsed directly from the line, no memory is allocated.
+ * Validation is identical to isdecimalf() applied to the segment and
+ * the parsed value is identical to atof() applied to the segment.
+ * Fixed-point values such as the '%8.3f' columns of gro files are converted
+ * without calling any library parsing function.
  * 
  * @param line      line to parse
  * @param start     index from which the line will be parsed
@@ -118,6 +125,12 @@ int parse_gro_line(const char *line, atom_t *atom);
  * In such cases, groan library will fail as it can't be equipped to handle cases
  * in which Gromacs developers do not follow their own standard.
  *
+ * @paragraph Parallel reading
+ * Atom lines of gro files have a fixed width, so the file is memory-mapped and ranges of atoms
+ * are parsed in parallel (see load_gro_parallel()). The number of threads is chosen automatically
+ * based on the number of atoms and the number of available processors.
+ * Files with atom lines of varying length are read line by line.
+ *
  * @param filename  path to the gro file
  * 
  * @return Pointer to a system_t structure, if successful.
@@ -125,6 +138,67 @@ int parse_gro_line(const char *line, atom_t *atom);
  */
 system_t *load_gro(const char *filename);
 
+
+/*! @brief Reads a gro file using the specified number of threads.
+ *
+ * @paragraph Details
+ * The gro file is memory-mapped and, after reading the header, the position of each atom line
+ * is computed from the length of the first atom line. Ranges of atoms are then parsed
+ * directly into system->atoms by n_threads threads.
+ *
+ * If the atom lines are not all of the same length (e.g. the file was edited by hand
+ * or is otherwise irregular), if the file can not be memory-mapped or if the file is invalid,
+ * the file is read line by line in a single thread. The result is always the same as for load_gro().
+ *
+ * @param filename  path to the gro file
+ * @param n_threads number of threads to use (0 = choose automatically)
+ *
+ * @return Pointer to a system_t structure, if successful.
+ * Else returns NULL and prints an error message to stderr.
+ */
+system_t *load_gro_parallel(const char *filename, size_t n_threads);
+
+/*! @brief Enables the contiguous block of positions for the system.
+ *
+ * @paragraph Details
+ * Allocates system->positions and fills it with the current positions of atoms.
+ * While the block is enabled, read_xtc_step(), read_trr_step() and other trajectory readers
+ * write positions only into the block and positions stored in system->atoms are NOT updated.
+ * The block can be directly used by the block analysis functions (e.g. center_of_geometry_block()).
+ * Use system_positions_sync() to copy the positions from the block into the atoms
+ * before using functions working with atom_t structures.
+ *
+ * If the block is already enabled, it is refilled with the positions of atoms.
+ *
+ * The block must be deallocated using system_positions_disable() before the system is freed.
+ *
+ * @param system        pointer to a structure containing information about the system
+ *
+ * @return Zero if successful, else non-zero.
+ */
+int system_positions_enable(system_t *system);
+
+
+/*! @brief Copies the positions from the contiguous block of positions into the atoms of the system.
+ *
+ * @paragraph Details
+ * Does nothing if the block is not enabled.
+ *
+ * @param system        pointer to a structure containing information about the system
+ */
+void system_positions_sync(system_t *system);
+
+
+/*! @brief Copies the positions from the contiguous block into the atoms and deallocates the block.
+ *
+ * @paragraph Details
+ * After calling this function, trajectory readers update the positions of atoms again.
+ * Does nothing if the block is not enabled.
+ *
+ * @param system        pointer to a structure containing information about the system
+ */
+void system_positions_disable(system_t *system);
+
 /*! @brief Prints information about the selected atoms in gro format into stream.
  * 
  * @param stream            output stream for printing (e.g. stdout)
@@ -133,6 +207,10 @@ system_t *load_gro(const char *filename);
  * @param write_mode        should the velocities be printed (velocities) or not (no_velocities)
  * @param comment           string that will be printed as the first line of gro file
  * 
+ * @paragraph Details
+ * Atom lines are formatted into large buffers without calling printf
+ * and the buffers are written using fwrite. See also write_gro_parallel().
+ * 
  * @return Zero if successful, else non-zero.
  */
 int write_gro(
@@ -141,5 +219,30 @@ int write_gro(
         const box_t boxsize,
         const write_mode_t write_mode,
         const char *comment);
+
+
+/*! @brief Prints information about the selected atoms in gro format into stream using multiple threads.
+ *
+ * @paragraph Details
+ * Atoms are split into chunks which are formatted into separate buffers by n_threads threads
+ * and the buffers are then written into the stream in order. The output is byte-identical
+ * to the output of write_gro().
+ *
+ * @param stream            output stream for printing (e.g. stdout)
+ * @param atoms             selection of atoms to be printed
+ * @param boxsize           size of the simulation cell
+ * @param write_mode        should the velocities be printed (velocities) or not (no_velocities)
+ * @param comment           string that will be printed as the first line of gro file
+ * @param n_threads         number of threads used for formatting (0 = number of available processors)
+ *
+ * @return Zero if successful, else non-zero.
+ */
+int write_gro_parallel(
+        FILE *stream, 
+        const atom_selection_t *atoms,
+        const box_t boxsize,
+        const write_mode_t write_mode,
+        const char *comment,
+        size_t n_threads);
         
 #endif /* GRO_IO_H */
\ No newline at end of file
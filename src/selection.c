@@ -3,6 +3,7 @@
 
 #include "selection.h"
 #include "analysis_tools.h"
+#include "topology_index.h"
 
 /*! @brief Maximal number of query segments for smart_select(). These are two query segments: >resname POPC< && >name PO4< */
 static const size_t MAX_QUERY_SEGMENTS = 50;
@@ -10,6 +11,112 @@ static const size_t MAX_QUERY_SEGMENTS = 50;
 /*! @brief Initial number of atom indices in selection array. See function select_atoms(). */
 static const size_t INITIAL_SELECTION_SIZE = 64;
 
+/*! @brief Type of a token of a compiled selection query. */
+typedef enum query_token_type {
+    QUERY_ALL,          /* all atoms of the input selection */
+    QUERY_RESNAME,      /* atoms with any of the residue names */
+    QUERY_RESID,        /* atoms with any of the residue numbers */
+    QUERY_NAME,         /* atoms with any of the atom names */
+    QUERY_SERIAL,       /* atoms with any of the gmx atom numbers */
+    QUERY_GROUP,        /* atoms of an ndx group */
+    QUERY_BLOCK         /* parenthesised sub-query */
+} query_token_type_t;
+
+/*! @brief Closed interval of residue or atom numbers. */
+typedef struct query_interval {
+    size_t low;
+    size_t high;
+} query_interval_t;
+
+/*! @brief Token of a compiled selection query, i.e. a single lexeme or a parenthesised block. */
+typedef struct query_token {
+    query_token_type_t type;
+    int negate;                     /* select atoms of the input selection NOT selected by the token */
+    size_t n_elements;              /* number of names or intervals of numbers to match */
+    char **names;                   /* residue or atom names to match (pointers into 'text') */
+    char *text;                     /* memory holding the names */
+    uint64_t *keys;                 /* names packed into integers (see pack_name()) */
+    query_interval_t *intervals;    /* sorted disjoint intervals of residue or atom numbers to match */
+    atom_selection_t *group;        /* copy of the ndx group */
+    selection_query_t *block;       /* compiled parenthesised block */
+} query_token_t;
+
+struct selection_query {
+    size_t n_tokens;                /* number of tokens */
+    query_token_t *tokens;          /* tokens in the order of the query */
+    int *is_and;                    /* for each operator: 1 for AND, 0 for OR */
+    atom_selection_t *cached;       /* result of a query that does not depend on the input selection */
+};
+
+static void query_token_elements(query_token_t *token, const char *arguments, int ranges);
+static atom_selection_t *query_token_select(const query_token_t *token, const atom_selection_t *selection, const topology_index_t *index);
+
+/*! @brief Returns a*b, or SIZE_MAX if the product does not fit into size_t. */
+static size_t saturating_mul(size_t a, size_t b)
+{
+    if (a != 0 && b > SIZE_MAX / a) return SIZE_MAX;
+    return a * b;
+}
+
+/*! @brief Packs residue or atom name stored in atom_t into an integer.
+ *
+ * @paragraph Details
+ * The characters of the name (at most 6, up to the 0-terminator) are stored in the lower bytes of the integer,
+ * so two names are the same if and only if their packed forms are equal. The name is packed every time it is
+ * compared, so atoms can be renamed freely. Packed names are always smaller than 2^48.
+ */
+static inline uint64_t pack_name(const char *name)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < 6 && name[i] != '\0'; ++i) key |= (uint64_t) (unsigned char) name[i] << (8 * i);
+
+    return key;
+}
+
+/*! @brief Creates an empty bitmap covering all atoms of the provided selections (selection2 may be NULL).
+ *
+ * @paragraph Details
+ * The bitmap spans the range of atoms between the first and the last selected atom in memory,
+ * so it is only useful if the atoms come from the same system. NULL is returned if they do not,
+ * if the span is so large that clearing the bitmap would cost more than 'work' pairwise comparisons
+ * of atoms, or if memory could not be allocated. Callers then fall back to comparing the atoms directly.
+ */
+static atom_bitmap_t *selection_bitmap(const atom_selection_t *selection1, const atom_selection_t *selection2, size_t work)
+{
+    const atom_selection_t *selections[2] = {selection1, selection2};
+    uintptr_t low = UINTPTR_MAX, high = 0;
+
+    for (int s = 0; s < 2; ++s) {
+        if (selections[s] == NULL) continue;
+        for (size_t i = 0; i < selections[s]->n_atoms; ++i) {
+            uintptr_t address = (uintptr_t) selections[s]->atoms[i];
+            if (address < low) low = address;
+            if (address > high) high = address;
+        }
+    }
+
+    if (low > high || (high - low) % sizeof(atom_t) != 0) return NULL;
+
+    size_t span = (high - low) / sizeof(atom_t) + 1;
+    if (span / 64 > work) return NULL;
+
+    atom_bitmap_t *bitmap = atom_bitmap_create((atom_t *) low, span);
+    if (bitmap == NULL) return NULL;
+
+    // atoms that are not aligned with the first atom are not part of the same array
+    for (int s = 0; s < 2; ++s) {
+        if (selections[s] == NULL) continue;
+        for (size_t i = 0; i < selections[s]->n_atoms; ++i) {
+            if (((uintptr_t) selections[s]->atoms[i] - low) % sizeof(atom_t) != 0) {
+                free(bitmap);
+                return NULL;
+            }
+        }
+    }
+
+    return bitmap;
+}
+
 /* Simple function for qsort comparison of atom numbers */
 static int compare_atomnum(const void *x, const void *y)
 {
@@ -188,6 +295,15 @@ atom_selection_t *select_atoms(
         const atom_selection_t *input_atoms,
         const char *match_string,
         int (*match_function)(const atom_t *, const char *))
+{
+    return select_atoms_system(input_atoms, match_string, match_function, NULL);
+}
+
+atom_selection_t *select_atoms_system(
+        const atom_selection_t *input_atoms,
+        const char *match_string,
+        int (*match_function)(const atom_t *, const char *),
+        const system_t *system)
 {
     // allocate memory for output_atoms
     size_t alloc_ids = INITIAL_SELECTION_SIZE;
@@ -195,6 +311,26 @@ atom_selection_t *select_atoms(
 
     if (input_atoms == NULL || input_atoms->n_atoms == 0) return output_atoms;
 
+    // the standard match functions are evaluated on parsed numbers and packed names
+    // (or using the topology index of the system, if it is enabled)
+    query_token_t token = { .type = QUERY_ALL };
+    if (match_function == &match_residue_name) token.type = QUERY_RESNAME;
+    else if (match_function == &match_residue_num) token.type = QUERY_RESID;
+    else if (match_function == &match_atom_name) token.type = QUERY_NAME;
+    else if (match_function == &match_atom_num) token.type = QUERY_SERIAL;
+
+    if (token.type != QUERY_ALL) {
+        query_token_elements(&token, match_string, 0);
+        free(output_atoms);
+        output_atoms = query_token_select(&token, input_atoms, system != NULL ? system->topology : NULL);
+        free(token.names);
+        free(token.text);
+        free(token.keys);
+        free(token.intervals);
+
+        return output_atoms;
+    }
+
     // split match_string into individual elements
     char *to_match = calloc(strlen(match_string) + 1, 1);
     strcpy(to_match, match_string);
@@ -252,6 +388,20 @@ atom_selection_t *select_system(system_t *system)
 }
 
 
+size_t *selection_get_indices(const atom_selection_t *selection, const system_t *system)
+{
+    // at least one item is allocated so that NULL is only returned on failure
+    size_t *indices = malloc((selection->n_atoms > 0 ? selection->n_atoms : 1) * sizeof(size_t));
+    if (indices == NULL) return NULL;
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        indices[i] = (size_t) (selection->atoms[i] - system->atoms);
+    }
+
+    return indices;
+}
+
+
 atom_selection_t *selection_cat(const atom_selection_t *selection1, const atom_selection_t *selection2)
 {
     // create output atoms
@@ -285,6 +435,21 @@ atom_selection_t *selection_cat_unique(const atom_selection_t *selection1, const
     // copy first selection into the output selection
     memcpy(output_atoms->atoms, selection1->atoms, selection1->n_atoms * sizeof(atom_t *));
 
+    // atoms of selection2 are only checked against selection1, so duplicates inside selection2 are kept
+    atom_bitmap_t *in_first = selection_bitmap(selection1, selection2, saturating_mul(selection1->n_atoms, selection2->n_atoms));
+    if (in_first != NULL) {
+        for (size_t i = 0; i < selection1->n_atoms; ++i) atom_bitmap_add(in_first, selection1->atoms[i]);
+
+        for (size_t i = 0; i < selection2->n_atoms; ++i) {
+            if (!atom_bitmap_contains(in_first, selection2->atoms[i])) {
+                output_atoms->atoms[output_atoms->n_atoms++] = selection2->atoms[i];
+            }
+        }
+
+        free(in_first);
+        return output_atoms;
+    }
+
     // then loop through atoms of the selection2
     for (size_t i = 0; i < selection2->n_atoms; ++i) {
         int duplicate = 0;
@@ -322,6 +487,30 @@ atom_selection_t *selection_intersect(const atom_selection_t *selection1, const
         return selection_copy(selection1);
     }
 
+    atom_bitmap_t *in_second = selection_bitmap(selection1, selection2, saturating_mul(selection1->n_atoms, selection2->n_atoms));
+    if (in_second != NULL) {
+        // an atom present multiple times in selection2 is added multiple times, which the bitmap cannot express
+        int duplicates = 0;
+        for (size_t j = 0; j < selection2->n_atoms && !duplicates; ++j) {
+            duplicates = atom_bitmap_contains(in_second, selection2->atoms[j]);
+            atom_bitmap_add(in_second, selection2->atoms[j]);
+        }
+
+        if (!duplicates) {
+            atom_selection_t *output_atoms = selection_create(selection1->n_atoms);
+            for (size_t i = 0; i < selection1->n_atoms; ++i) {
+                if (atom_bitmap_contains(in_second, selection1->atoms[i])) {
+                    output_atoms->atoms[output_atoms->n_atoms++] = selection1->atoms[i];
+                }
+            }
+
+            free(in_second);
+            return output_atoms;
+        }
+
+        free(in_second);
+    }
+
     size_t alloc_ids = INITIAL_SELECTION_SIZE;
     atom_selection_t *output_atoms = selection_create(alloc_ids);
 
@@ -347,24 +536,14 @@ atom_selection_t *selection_intersect_d(atom_selection_t *selection1, atom_selec
 
 size_t selection_remove_atom(atom_selection_t *selection, atom_t *remove)
 {
-    size_t deleted_atoms = 0;
-    // loop through atoms searching for the atom to remove
+    // kept atoms are moved forward over the removed ones in a single pass
+    size_t kept = 0;
     for (size_t i = 0; i < selection->n_atoms; ++i) {
-        if (remove == selection->atoms[i]) {
-            // if the atom is found, move all following atoms one position forward
-            for (size_t j = i + 1; j < selection->n_atoms; ++j) {
-                selection->atoms[j - 1] = selection->atoms[j];
-            }
-
-            // decrease the atom counter in the selection
-            selection->n_atoms--;
-            // increase the deleted atoms counter
-            deleted_atoms++;
-            // decrease the index, because we have to read this position again in the following search
-            i--;
-        }
+        if (remove != selection->atoms[i]) selection->atoms[kept++] = selection->atoms[i];
     }
 
+    size_t deleted_atoms = selection->n_atoms - kept;
+    selection->n_atoms = kept;
     return deleted_atoms;
 }
 
@@ -399,6 +578,23 @@ size_t selection_remove(atom_selection_t *selection_result, const atom_selection
         return original_length;
     }
 
+    atom_bitmap_t *to_remove = selection_bitmap(selection_result, selection_sub, saturating_mul(selection_result->n_atoms, selection_sub->n_atoms));
+    if (to_remove != NULL) {
+        for (size_t i = 0; i < selection_sub->n_atoms; ++i) atom_bitmap_add(to_remove, selection_sub->atoms[i]);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < selection_result->n_atoms; ++i) {
+            if (!atom_bitmap_contains(to_remove, selection_result->atoms[i])) {
+                selection_result->atoms[kept++] = selection_result->atoms[i];
+            }
+        }
+
+        free(to_remove);
+        size_t removed_atoms = selection_result->n_atoms - kept;
+        selection_result->n_atoms = kept;
+        return removed_atoms;
+    }
+
     size_t removed_atoms = 0;
     // loop through the selection_sub, removing matching atoms from selection_result
     for (size_t i = 0; i < selection_sub->n_atoms; ++i) {
@@ -417,6 +613,23 @@ size_t selection_remove_d(atom_selection_t *selection_result, atom_selection_t *
 
 size_t selection_unique(atom_selection_t *selection)
 {
+    // the first occurrence of each atom is kept
+    atom_bitmap_t *seen = selection_bitmap(selection, NULL, saturating_mul(selection->n_atoms, selection->n_atoms));
+    if (seen != NULL) {
+        size_t kept = 0;
+        for (size_t i = 0; i < selection->n_atoms; ++i) {
+            if (!atom_bitmap_contains(seen, selection->atoms[i])) {
+                atom_bitmap_add(seen, selection->atoms[i]);
+                selection->atoms[kept++] = selection->atoms[i];
+            }
+        }
+
+        free(seen);
+        size_t deleted_atoms = selection->n_atoms - kept;
+        selection->n_atoms = kept;
+        return deleted_atoms;
+    }
+
     size_t deleted_atoms = 0;
     for (size_t i = 0; i < selection->n_atoms; ++i) {
         for (size_t j = i + 1; j < selection->n_atoms; ++j) {
@@ -441,6 +654,19 @@ int selection_compare(
     if (selection1 == selection2) return 1;
     if (selection1->n_atoms != selection2->n_atoms) return 0;
 
+    atom_bitmap_t *in_second = selection_bitmap(selection1, selection2, saturating_mul(selection1->n_atoms, selection2->n_atoms));
+    if (in_second != NULL) {
+        for (size_t j = 0; j < selection2->n_atoms; ++j) atom_bitmap_add(in_second, selection2->atoms[j]);
+
+        int identical = 1;
+        for (size_t i = 0; i < selection1->n_atoms && identical; ++i) {
+            identical = atom_bitmap_contains(in_second, selection1->atoms[i]);
+        }
+
+        free(in_second);
+        return identical;
+    }
+
     for (size_t i = 0; i < selection1->n_atoms; ++i) {
         atom_t *atom = selection1->atoms[i];
         int found = 0;
@@ -670,14 +896,54 @@ list_t *selection_getresnames(const atom_selection_t *selection)
     list_t *resnames = list_create();
     if (resnames == NULL) return NULL;
 
+    // residue names are compared as packed integers; consecutive atoms usually have the same residue name
+    // names already in the list are kept sorted in 'keys' so that they can be found using binary search
+    size_t n_keys = 0, alloc_keys = 16;
+    uint64_t *keys = malloc(alloc_keys * sizeof(uint64_t));
+    if (keys == NULL) {
+        list_destroy(resnames);
+        return NULL;
+    }
+    uint64_t last_key = UINT64_MAX;
+
     for (size_t i = 0; i < selection->n_atoms; ++i) {
         char *resname = selection->atoms[i]->residue_name;
-        // if the residue name does not exist in the list
-        if (list_index(resnames, resname) < 0) {
-            list_append(&resnames, resname);
+        uint64_t key = pack_name(resname);
+        if (key == last_key) continue;
+        last_key = key;
+
+        // find the first key not smaller than the residue name
+        size_t low = 0, high = n_keys;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (keys[mid] < key) low = mid + 1;
+            else high = mid;
+        }
+        // if the residue name already exists in the list
+        if (low < n_keys && keys[low] == key) continue;
+
+        if (n_keys >= alloc_keys) {
+            uint64_t *new_keys = realloc(keys, 2 * alloc_keys * sizeof(uint64_t));
+            if (new_keys == NULL) {
+                free(keys);
+                list_destroy(resnames);
+                return NULL;
+            }
+            keys = new_keys;
+            alloc_keys *= 2;
+        }
+        memmove(&keys[low + 1], &keys[low], (n_keys - low) * sizeof(uint64_t));
+        keys[low] = key;
+        n_keys++;
+
+        if (list_append(&resnames, resname) != 0) {
+            free(keys);
+            list_destroy(resnames);
+            return NULL;
         }
     }
-    
+
+    free(keys);
     return resnames;
 }
 
@@ -925,55 +1191,30 @@ static atom_selection_t *selection_invert(const atom_selection_t *all, const ato
     return result;
 }
 
-/*! @brief Parses lexeme translating it to atom selection structure pointer to which is returned. */
-static atom_selection_t *parse_lexeme(const atom_selection_t *selection, char *lexeme, const dict_t *ndx_groups)
+/*! @brief Checks that each 'a to b' or 'a - b' macro in the query has integer bounds with a <= b. Returns 0 if it does, else 1. */
+static int check_to(const char *query)
 {
-    // check whether the lexeme contains 'not' or '!'
-    int not = 0;
-    size_t skip = 0;
-    if (strlen(lexeme) >= 1 && memcmp(lexeme, "!", 1) == 0) {
-        not = 1;
-        skip = 2;
-    } else if (strlen(lexeme) >= 3 && memcmp(lexeme, "not", 3) == 0) {
-        not = 1;
-        skip = 4;
-    }
-    
-    atom_selection_t *result = NULL;
-    // select all atoms from the selection
-    if (strlen(lexeme + skip) >= 3 && memcmp(lexeme + skip, "all", 3) == 0) {
-        result = selection_copy(selection);
-    // select atoms based on residue names
-    } else if (strlen(lexeme + skip) >= 8 && memcmp(lexeme + skip, "resname", 7) == 0) {
-        result = select_atoms(selection, lexeme + skip + 7, &match_residue_name);
-    // select atoms based on residue numbers
-    } else if (strlen(lexeme + skip) >= 6 && memcmp(lexeme + skip, "resid", 5) == 0) {
-        result = select_atoms(selection, lexeme + skip + 5, &match_residue_num);
-    // select atoms based on atom names
-    } else if (strlen(lexeme + skip) >= 5 && memcmp(lexeme + skip, "name", 4) == 0) {
-        result = select_atoms(selection, lexeme + skip + 4, &match_atom_name);
-    // select atoms based on atom numbers
-    } else if (strlen(lexeme + skip) >= 7 && memcmp(lexeme + skip, "serial", 6) == 0) {
-        result = select_atoms(selection, lexeme + skip + 6, &match_atom_num);
-    // select atoms based on ndx groups
-    } else if (ndx_groups != NULL) {
-        // we have to replace the trailing space that is added during lexeme formation
-        lexeme[strlen(lexeme) - 1] = 0;
-        atom_selection_t *original = (atom_selection_t *) dict_get(ndx_groups, lexeme + skip);
-        if (original == NULL) return NULL;
+    if (strchr(query, '-') == NULL && strstr(query, "to") == NULL) return 0;
 
-        // we have to copy the selection so we can then free it without disrupting the dictionary
-        result = selection_copy(original);
-    }
+    char **split = NULL;
+    char *string_to_split = malloc(strlen(query) + 1);
+    strcpy(string_to_split, query);
+    size_t n_words = strsplit(string_to_split, &split, " \n\t");
 
-    // invert the selection, if 'not' or '!' is in the lexeme
-    if (not && result != NULL) {
-        atom_selection_t *result_inverted = selection_invert(selection, result);
-        free(result);
-        return result_inverted;
+    int error = 0;
+    for (size_t i = 0; i < n_words && !error; ++i) {
+        if (strcmp(split[i], "-") != 0 && strcmp(split[i], "to") != 0) continue;
+
+        // -/to cannot be at the start or the end of the query and the loop must start at the lower value
+        int start = 0;
+        int end = 0;
+        error = i == 0 || i == n_words - 1 ||
+                sscanf(split[i - 1], "%d", &start) != 1 || sscanf(split[i + 1], "%d", &end) != 1 || start > end;
     }
-    
-    return result;
+
+    free(string_to_split);
+    free(split);
+    return error;
 }
 
 /*! @brief Expands 'a to b' or 'a - b' macro into a sequence that can be understood by the parser. 
@@ -1070,47 +1311,442 @@ static int expand_to(char **new_string, const char *original_string)
     return 0;
 }
 
-static atom_selection_t *parse_query(const atom_selection_t *selection, char *query, const dict_t *ndx_groups)
+void query_destroy(selection_query_t *query)
+{
+    if (query == NULL) return;
+
+    for (size_t i = 0; i < query->n_tokens; ++i) {
+        free(query->tokens[i].names);
+        free(query->tokens[i].text);
+        free(query->tokens[i].keys);
+        free(query->tokens[i].intervals);
+        free(query->tokens[i].group);
+        query_destroy(query->tokens[i].block);
+    }
+
+    free(query->tokens);
+    free(query->is_and);
+    free(query->cached);
+    free(query);
+}
+
+/*! @brief Simple function for qsort comparison of intervals by their lower bound. */
+static int compare_intervals(const void *x, const void *y)
+{
+    const query_interval_t *interval1 = (const query_interval_t *) x;
+    const query_interval_t *interval2 = (const query_interval_t *) y;
+
+    return (interval1->low > interval2->low) - (interval1->low < interval2->low);
+}
+
+/*! @brief Adds interval of numbers between 'start' and 'end' (inclusive) written as integers and read back as residue or atom numbers.
+ *
+ * @paragraph Details
+ * Negative integers are read as residue numbers (or atom numbers) the same way as sscanf reads them,
+ * i.e. they wrap around. Negative and non-negative integers therefore form two separate intervals.
+ */
+static void query_add_interval(query_token_t *token, long long start, long long end)
+{
+    if (start > end) return;
+
+    if (start < 0) {
+        long long negative_end = end < 0 ? end : -1;
+        if (token->type == QUERY_RESID) {
+            token->intervals[token->n_elements].low = (groint_t) start;
+            token->intervals[token->n_elements].high = (groint_t) negative_end;
+        } else {
+            token->intervals[token->n_elements].low = (size_t) start;
+            token->intervals[token->n_elements].high = (size_t) negative_end;
+        }
+        token->n_elements++;
+        start = 0;
+    }
+
+    if (start <= end) {
+        token->intervals[token->n_elements].low = (size_t) start;
+        token->intervals[token->n_elements].high = (size_t) end;
+        token->n_elements++;
+    }
+}
+
+/*! @brief Splits the arguments of a keyword into names or intervals of numbers to be matched by the token.
+ *
+ * @paragraph Details
+ * If 'ranges' is non-zero, 'a to b' and 'a - b' in the arguments of a residue or atom number token
+ * match all numbers from a to b. The range is kept as a single interval and is never expanded.
+ */
+static void query_token_elements(query_token_t *token, const char *arguments, int ranges)
+{
+    token->text = malloc(strlen(arguments) + 1);
+    strcpy(token->text, arguments);
+
+    int n_elements = strsplit(token->text, &token->names, " ");
+    if (n_elements <= 0) {
+        token->names = NULL;
+        token->n_elements = 0;
+        return;
+    }
+
+    // names are packed once; names longer than 5 characters can not be stored in atom_t and match no atom
+    if (token->type == QUERY_RESNAME || token->type == QUERY_NAME) {
+        token->n_elements = (size_t) n_elements;
+        token->keys = malloc(n_elements * sizeof(uint64_t));
+        for (int i = 0; i < n_elements; ++i) token->keys[i] = strlen(token->names[i]) <= 5 ? pack_name(token->names[i]) : UINT64_MAX;
+        return;
+    }
+
+    // numbers are parsed once; elements that are not numbers can never match an atom
+    token->intervals = malloc(2 * n_elements * sizeof(query_interval_t));
+    for (int i = 0; i < n_elements; ++i) {
+        if (ranges && (strcmp(token->names[i], "to") == 0 || strcmp(token->names[i], "-") == 0)) {
+            // the bounds of the range are matched as separate elements
+            int start = 0, end = 0;
+            if (i == 0 || i == n_elements - 1 ||
+                sscanf(token->names[i - 1], "%d", &start) != 1 || sscanf(token->names[i + 1], "%d", &end) != 1) continue;
+
+            query_add_interval(token, (long long) start + 1, (long long) end - 1);
+        } else if (token->type == QUERY_RESID) {
+            groint_t residue_number = 0;
+            if (sscanf(token->names[i], "%u", &residue_number) == 1) query_add_interval(token, residue_number, residue_number);
+        } else {
+            size_t atom_num = 0;
+            if (sscanf(token->names[i], "%zu", &atom_num) == 1) {
+                token->intervals[token->n_elements].low = atom_num;
+                token->intervals[token->n_elements].high = atom_num;
+                token->n_elements++;
+            }
+        }
+    }
+
+    // merge overlapping and adjacent intervals
+    qsort(token->intervals, token->n_elements, sizeof(query_interval_t), &compare_intervals);
+    size_t n_merged = 0;
+    for (size_t i = 0; i < token->n_elements; ++i) {
+        if (n_merged > 0 && (token->intervals[n_merged - 1].high == SIZE_MAX || token->intervals[i].low <= token->intervals[n_merged - 1].high + 1)) {
+            if (token->intervals[i].high > token->intervals[n_merged - 1].high) token->intervals[n_merged - 1].high = token->intervals[i].high;
+        } else {
+            token->intervals[n_merged++] = token->intervals[i];
+        }
+    }
+    token->n_elements = n_merged;
+
+    free(token->names);
+    free(token->text);
+    token->names = NULL;
+    token->text = NULL;
+}
+
+/*! @brief Checks whether the number lies in any of the intervals of the token. */
+static inline int query_token_contains(const query_token_t *token, size_t number)
+{
+    // find the last interval starting at or before the number
+    size_t low = 0, high = token->n_elements;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (token->intervals[mid].low <= number) low = mid + 1;
+        else high = mid;
+    }
+
+    return low > 0 && number <= token->intervals[low - 1].high;
+}
+
+/*! @brief Splits the arguments of a residue or atom name token. Ranges are expanded into the individual numbers. Returns 0 if successful, else 1. */
+static int query_token_names(query_token_t *token, const char *arguments)
+{
+    char *expanded = NULL;
+    if (expand_to(&expanded, arguments) != 0) {
+        free(expanded);
+        return 1;
+    }
+
+    query_token_elements(token, expanded, 0);
+    free(expanded);
+    return 0;
+}
+
+/*! @brief Translates lexeme into a query token. Returns 0 if successful, else 1. */
+static int query_compile_lexeme(query_token_t *token, char *lexeme, const dict_t *ndx_groups)
+{
+    // check whether the lexeme contains 'not' or '!'
+    size_t skip = 0;
+    if (strlen(lexeme) >= 1 && memcmp(lexeme, "!", 1) == 0) {
+        token->negate = 1;
+        skip = 2;
+    } else if (strlen(lexeme) >= 3 && memcmp(lexeme, "not", 3) == 0) {
+        token->negate = 1;
+        skip = 4;
+    }
+
+    // select all atoms from the selection
+    if (strlen(lexeme + skip) >= 3 && memcmp(lexeme + skip, "all", 3) == 0) {
+        token->type = QUERY_ALL;
+    // select atoms based on residue names
+    } else if (strlen(lexeme + skip) >= 8 && memcmp(lexeme + skip, "resname", 7) == 0) {
+        token->type = QUERY_RESNAME;
+        return query_token_names(token, lexeme + skip + 7);
+    // select atoms based on residue numbers
+    } else if (strlen(lexeme + skip) >= 6 && memcmp(lexeme + skip, "resid", 5) == 0) {
+        token->type = QUERY_RESID;
+        query_token_elements(token, lexeme + skip + 5, 1);
+    // select atoms based on atom names
+    } else if (strlen(lexeme + skip) >= 5 && memcmp(lexeme + skip, "name", 4) == 0) {
+        token->type = QUERY_NAME;
+        return query_token_names(token, lexeme + skip + 4);
+    // select atoms based on atom numbers
+    } else if (strlen(lexeme + skip) >= 7 && memcmp(lexeme + skip, "serial", 6) == 0) {
+        token->type = QUERY_SERIAL;
+        query_token_elements(token, lexeme + skip + 6, 1);
+    // select atoms based on ndx groups
+    } else if (ndx_groups != NULL) {
+        // ranges are expanded into the name of the group
+        char *expanded = NULL;
+        if (expand_to(&expanded, lexeme) != 0) {
+            free(expanded);
+            return 1;
+        }
+
+        // we have to replace the trailing space that is added during lexeme formation
+        if (strlen(expanded) > 0) expanded[strlen(expanded) - 1] = 0;
+        atom_selection_t *original = (atom_selection_t *) dict_get(ndx_groups, expanded + skip);
+        free(expanded);
+        if (original == NULL) return 1;
+
+        // the group is copied so that the compiled query does not depend on the dictionary
+        token->type = QUERY_GROUP;
+        token->group = selection_copy(original);
+    } else {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*! @brief Checks whether the atom matches any of the names or numbers of the token. */
+static inline int query_token_match(const query_token_t *token, const atom_t *atom)
+{
+    switch (token->type) {
+        // names are compared as packed integers
+        case QUERY_RESNAME:
+        case QUERY_NAME: {
+            uint64_t key = pack_name(token->type == QUERY_RESNAME ? atom->residue_name : atom->atom_name);
+            for (size_t i = 0; i < token->n_elements; ++i) {
+                if (key == token->keys[i]) return 1;
+            }
+            return 0;
+        }
+        case QUERY_RESID:
+            return query_token_contains(token, atom->residue_number);
+        case QUERY_SERIAL:
+            return query_token_contains(token, atom->gmx_atom_number);
+        default:
+            return 0;
+    }
+}
+
+/*! @brief Looks up atoms matching any of the names or numbers of the token in the topology index.
+ *
+ * @paragraph Details
+ * If 'bitmap' is not NULL, the matching atoms are added to it. Otherwise the atoms are only counted.
+ *
+ * @return Number of atoms matching the individual names or numbers (atoms matching several of them are counted repeatedly).
+ */
+static size_t query_token_mark(const query_token_t *token, const topology_index_t *index, atom_bitmap_t *bitmap)
+{
+    size_t n_matches = 0;
+    for (size_t i = 0; i < token->n_elements; ++i) {
+        switch (token->type) {
+            case QUERY_RESNAME:
+            case QUERY_NAME: {
+                const size_t *atoms = NULL;
+                size_t n_atoms = (token->type == QUERY_RESNAME) ?
+                        topology_index_resname(index, token->names[i], &atoms) :
+                        topology_index_name(index, token->names[i], &atoms);
+
+                if (bitmap != NULL) {
+                    for (size_t j = 0; j < n_atoms; ++j) atom_bitmap_add(bitmap, &(index->atoms[atoms[j]]));
+                }
+                n_matches += n_atoms;
+                break;
+            }
+            case QUERY_RESID: {
+                const topology_range_t *ranges = NULL;
+                size_t n_ranges = topology_index_resid_range(index, (groint_t) token->intervals[i].low, (groint_t) token->intervals[i].high, &ranges);
+
+                for (size_t r = 0; r < n_ranges; ++r) {
+                    if (bitmap != NULL) {
+                        for (size_t j = ranges[r].start; j < ranges[r].end; ++j) atom_bitmap_add(bitmap, &(index->atoms[j]));
+                    }
+                    n_matches += ranges[r].end - ranges[r].start;
+                }
+                break;
+            }
+            case QUERY_SERIAL: {
+                const topology_serial_t *serials = NULL;
+                size_t n_atoms = topology_index_serial_range(index, token->intervals[i].low, token->intervals[i].high, &serials);
+
+                if (bitmap != NULL) {
+                    for (size_t j = 0; j < n_atoms; ++j) atom_bitmap_add(bitmap, &(index->atoms[serials[j].atom]));
+                }
+                n_matches += n_atoms;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    return n_matches;
+}
+
+/*! @brief Selects atoms matching the token using the topology index.
+ *
+ * @paragraph Details
+ * The atoms are returned in the same order as if every atom of the selection was matched separately.
+ *
+ * @return Selection of matching atoms. NULL if index is NULL, if looking up the atoms would be slower
+ * than matching them or if any of the atoms does not belong to the indexed system.
+ */
+static atom_selection_t *query_token_lookup(const query_token_t *token, const atom_selection_t *selection, const topology_index_t *index)
+{
+    if (index == NULL || selection->n_atoms == 0) return NULL;
+
+    // small selections are matched faster than the index is traversed
+    size_t n_matches = query_token_mark(token, index, NULL);
+    if (n_matches + index->n_atoms / 64 > saturating_mul(selection->n_atoms, token->n_elements)) return NULL;
+
+    atom_bitmap_t *bitmap = atom_bitmap_create(index->atoms, index->n_atoms);
+    if (bitmap == NULL) return NULL;
+    query_token_mark(token, index, bitmap);
+
+    // if the selection contains all atoms of the system in their order, the atoms are already ordered in the bitmap
+    int whole_system = (selection->n_atoms == index->n_atoms);
+    for (size_t i = 0; whole_system && i < selection->n_atoms; ++i) {
+        whole_system = (selection->atoms[i] == &(index->atoms[i]));
+    }
+
+    if (whole_system) {
+        atom_selection_t *result = atom_bitmap_to_selection(bitmap);
+        free(bitmap);
+        return result;
+    }
+
+    size_t alloc_ids = INITIAL_SELECTION_SIZE;
+    atom_selection_t *result = selection_create(alloc_ids);
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        // atoms are compared as addresses so that pointers into other arrays are handled safely
+        uintptr_t offset = (uintptr_t) selection->atoms[i] - (uintptr_t) index->atoms;
+        if (offset % sizeof(atom_t) != 0 || offset / sizeof(atom_t) >= index->n_atoms) {
+            free(bitmap);
+            free(result);
+            return NULL;
+        }
+
+        if (atom_bitmap_contains(bitmap, selection->atoms[i])) selection_add_atom(&result, &alloc_ids, selection->atoms[i]);
+    }
+
+    free(bitmap);
+    return result;
+}
+
+/*! @brief Selects atoms of the selection matching any of the names or numbers of the token. */
+static atom_selection_t *query_token_select(const query_token_t *token, const atom_selection_t *selection, const topology_index_t *index)
+{
+    atom_selection_t *result = query_token_lookup(token, selection, index);
+    if (result != NULL) return result;
+
+    size_t alloc_ids = INITIAL_SELECTION_SIZE;
+    result = selection_create(alloc_ids);
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        if (query_token_match(token, selection->atoms[i])) {
+            selection_add_atom(&result, &alloc_ids, selection->atoms[i]);
+        }
+    }
+
+    return result;
+}
+
+static atom_selection_t *query_evaluate(const selection_query_t *query, const atom_selection_t *selection, const topology_index_t *index);
+
+/*! @brief Selects atoms from the selection using a single query token. The topology index may be NULL. */
+static atom_selection_t *query_token_evaluate(const query_token_t *token, const atom_selection_t *selection, const topology_index_t *index)
+{
+    atom_selection_t *result = NULL;
+    switch (token->type) {
+        case QUERY_ALL:
+            result = selection_copy(selection);
+            break;
+        case QUERY_GROUP:
+            result = selection_copy(token->group);
+            break;
+        case QUERY_BLOCK:
+            result = query_evaluate(token->block, selection, index);
+            break;
+        default:
+            result = query_token_select(token, selection, index);
+    }
+
+    // invert the selection, if 'not' or '!' is in front of the token
+    if (token->negate) {
+        atom_selection_t *result_inverted = selection_invert(selection, result);
+        free(result);
+        return result_inverted;
+    }
+
+    return result;
+}
+
+/*! @brief Evaluates compiled query combining the tokens from left to right. The topology index may be NULL. */
+static atom_selection_t *query_evaluate(const selection_query_t *query, const atom_selection_t *selection, const topology_index_t *index)
+{
+    if (query->cached != NULL) return selection_copy(query->cached);
+
+    atom_selection_t *final = query_token_evaluate(&query->tokens[0], selection, index);
+    for (size_t i = 1; i < query->n_tokens; ++i) {
+        atom_selection_t *token = query_token_evaluate(&query->tokens[i], selection, index);
+        // must be unique cat as we do not want duplicate atoms in the final selection!
+        if (query->is_and[i - 1]) final = selection_intersect_d(final, token);
+        else final = selection_cat_unique_d(final, token);
+    }
+
+    return final;
+}
+
+/*! @brief Translates (sub)query into a list of tokens and operators. Returns NULL in case of a syntax error. */
+static selection_query_t *query_compile_block(char *query, const dict_t *ndx_groups)
 {
     size_t query_len = strlen(query);
     // split the expanded query into individual lexemes
     char **split = NULL;
     size_t n_words = strsplit(query, &split, " \n\t");
-    //printf("Split query into %d words\n", n_words);
 
-    // prepare an array with token definitions
-    atom_selection_t *tokens[MAX_QUERY_SEGMENTS];
+    selection_query_t *compiled = calloc(1, sizeof(selection_query_t));
+    compiled->tokens = calloc(MAX_QUERY_SEGMENTS, sizeof(query_token_t));
+    compiled->is_and = calloc(MAX_QUERY_SEGMENTS, sizeof(int));
 
-    // loop through the lexemes, translating them to atom selections
+    // loop through the lexemes, translating them to tokens
     char *lexeme = calloc(2 * query_len + 1, 1);
-    char *operators[MAX_QUERY_SEGMENTS];
     size_t counter = 0;
-    size_t n_tokens = 0;
     size_t n_operators = 0;
     for (size_t i = 0; i < n_words; ++i) {
         // if parenthesis is detected
         if (strchr(split[i], '(')) {
-            //printf("Detected an opening parenthesis.\n");
             char *block = calloc(2 * query_len + 1, 1);
             size_t block_len = 0;
             size_t par = 0;
             size_t j = i;
             // loop through all the words until we find a matching ')'
             for (; j < n_words; ++j) {
-                //printf("Adding %s to block.\n", split[j]);
-
                 // count the number of parenthesis in the word
                 for (size_t k = 0; split[j][k] != 0; ++k) {
                     if (split[j][k] == '(') ++par;
                     else if (split[j][k] == ')') --par;
                 }
-                
+
                 // copy the words into a new query 'block'
                 size_t add_block_len = 0;
                 if (j == i) {
                     if (par == 0) {
                         // remove the opening and the closing parenthesis
-                        split[j][strlen(split[j])] = 0;
                         strcpy(block, split[j] + 1);
                         add_block_len = strlen(split[j]) - 2;
                     } else {
@@ -1129,166 +1765,113 @@ static atom_selection_t *parse_query(const atom_selection_t *selection, char *qu
                     strcpy(block + block_len, split[j]);
                     add_block_len = strlen(split[j]);
                 }
-                
+
                 block_len += add_block_len;
                 if (add_block_len > 0) {
                     block[block_len] = ' ';
                     block[block_len + 1] = 0;
                     ++block_len;
                 }
-                
-                //printf("Current block: %s\n", block);
 
                 if (par == 0) break;
             }
 
-            // parse the block as a new query and save the output into a list of tokens
-            atom_selection_t *parsed_block = parse_query(selection, block, ndx_groups);
-            if (parsed_block == NULL) {
-                //fprintf(stderr, "Could not parse block %s\n", block);
-                free(split);
+            if (compiled->n_tokens >= MAX_QUERY_SEGMENTS) {
                 free(block);
-                free(lexeme);
-                for (size_t i = 0; i < n_tokens; ++i) free(tokens[i]);
-                return NULL;
+                goto syntax_error;
             }
 
+            // compile the block as a new query and save it as a token
+            query_token_t *token = &compiled->tokens[compiled->n_tokens];
+            token->type = QUERY_BLOCK;
+            token->block = query_compile_block(block, ndx_groups);
+            free(block);
+            if (token->block == NULL) goto syntax_error;
+            ++compiled->n_tokens;
+
             // check whether there is 'not' operator in front of the block
             if (!strcmp(lexeme, "! ") || !strcmp(lexeme, "not ")) {
-                //printf("Detected NOT operator.\n");
-                tokens[n_tokens] = selection_invert(selection, parsed_block);
-                free(parsed_block);
+                token->negate = 1;
                 memset(lexeme, 0, strlen(lexeme));
                 counter = 0;
-            } else {
-                tokens[n_tokens] = parsed_block;
             }
 
             // if there are any characters in front of a parenthesis (other than '!' or 'not'), raise a syntax error
-            if (strlen(lexeme) != 0) {
-                ++n_tokens;
-                free(split);
-                free(block);
-                free(lexeme);
-                for (size_t i = 0; i < n_tokens; ++i) free(tokens[i]);
-                return NULL;
-            }
-            
-            ++n_tokens;
+            if (strlen(lexeme) != 0) goto syntax_error;
+
             // continue parsing the input at the end of the block
             i = j;
-
-            free(block);
-        } 
+        }
 
         else if ( ( strlen(split[i]) == 2 && (strcmp(split[i], "&&") == 0 || strcmp(split[i], "||") == 0 || strcmp(split[i], "or") == 0)) ||
              ( strlen(split[i]) == 3 && strcmp(split[i], "and") == 0) ) {
 
             // add the operator to the list of operators
-            //printf("Adding operator %s\n", split[i]);
-            operators[n_operators] = split[i];
+            if (n_operators >= MAX_QUERY_SEGMENTS) goto syntax_error;
+            compiled->is_and[n_operators] = (strcmp(split[i], "&&") == 0 || strcmp(split[i], "and") == 0);
             ++n_operators;
 
             if (strlen(lexeme) == 0) continue;
 
-            //printf("Parsing lexeme %s\n", lexeme);
-
-            // parse the lexeme
-            atom_selection_t *parsed = parse_lexeme(selection, lexeme, ndx_groups);
-            if (parsed == NULL) {
-                //fprintf(stderr, "Could not parse lexeme %s\n", lexeme);
-                free(split);
-                free(lexeme);
-                for (size_t i = 0; i < n_tokens; ++i) free(tokens[i]);
-                return NULL;
-            }
+            // translate the lexeme
+            if (compiled->n_tokens >= MAX_QUERY_SEGMENTS) goto syntax_error;
+            ++compiled->n_tokens;
+            if (query_compile_lexeme(&compiled->tokens[compiled->n_tokens - 1], lexeme, ndx_groups) != 0) goto syntax_error;
 
-            tokens[n_tokens] = parsed;
-            ++n_tokens;
             memset(lexeme, 0, strlen(lexeme));
             counter = 0;
         } else {
-            //printf("Adding %s to lexeme\n", split[i]);
             strcpy(lexeme + counter, split[i]);
             counter += strlen(split[i]);
             lexeme[counter] = ' ';
             lexeme[counter + 1] = 0;
             counter += 1;
-            //printf("Added %s to lexeme\n", split[i]);
 
-            // if this is the last word, parse the current lexeme
+            // if this is the last word, translate the current lexeme
             if (i == n_words - 1) {
-
-                //printf("Parsing lexeme %s\n", lexeme);
-                
-                atom_selection_t *parsed = parse_lexeme(selection, lexeme, ndx_groups);
-                if (parsed == NULL) {
-                    //fprintf(stderr, "Could not parse lexeme %s\n", lexeme);
-                    free(split);
-                    free(lexeme);
-                    for (size_t i = 0; i < n_tokens; ++i) free(tokens[i]);
-                    return NULL;
-                }
-
-                tokens[n_tokens] = parsed;
-                ++n_tokens;
+                if (compiled->n_tokens >= MAX_QUERY_SEGMENTS) goto syntax_error;
+                ++compiled->n_tokens;
+                if (query_compile_lexeme(&compiled->tokens[compiled->n_tokens - 1], lexeme, ndx_groups) != 0) goto syntax_error;
             }
         }
     }
 
-    //printf("Detected %lu query segments that were translated to tokens.\n", n_tokens);
-
     // check that the number of operators corresponds to the number of tokens
-    if (n_tokens == 0 || n_operators + 1 != n_tokens) {
-        free(lexeme);
-        free(split);
-        for (size_t i = 0; i < n_tokens; ++i) free(tokens[i]);
-        return NULL;
-    }
+    if (compiled->n_tokens == 0 || n_operators + 1 != compiled->n_tokens) goto syntax_error;
 
-    // if there is only one token and no operators, return the first token
-    if (n_tokens == 1) {
-        free(lexeme);
-        free(split);
-        return tokens[0];
-    }
-
-    // combine atom selections
-    atom_selection_t *final = tokens[0];
-    for (size_t i = 1; i < n_tokens; ++i) {
-        // AND operation
-        if (strcmp(operators[i - 1], "&&") == 0 || strcmp(operators[i - 1], "and") == 0) {
-            //printf("Performing AND operation\n");
-            final = selection_intersect_d(final, tokens[i]);
-        // OR operation
-        } else if (strcmp(operators[i - 1], "||") == 0 || strcmp(operators[i - 1], "or") == 0) {
-            //printf("Performing OR operation\n");
-            // must be unique cat as we do not want duplicate atoms in the final selection!
-            final = selection_cat_unique_d(final, tokens[i]);
+    free(lexeme);
+    free(split);
+
+    // if no token depends on the input selection, the result of the query is evaluated only once
+    int independent = 1;
+    for (size_t i = 0; i < compiled->n_tokens; ++i) {
+        const query_token_t *token = &compiled->tokens[i];
+        if (token->negate || !(token->type == QUERY_GROUP || (token->type == QUERY_BLOCK && token->block->cached != NULL))) {
+            independent = 0;
+            break;
         }
     }
+    if (independent) compiled->cached = query_evaluate(compiled, NULL, NULL);
 
+    return compiled;
+
+    syntax_error:
     free(lexeme);
     free(split);
-    
-
-    return final;
+    query_destroy(compiled);
+    return NULL;
 }
 
-atom_selection_t *smart_select(const atom_selection_t *selection, const char *query, const dict_t *ndx_groups)
+selection_query_t *query_compile(const char *query, const dict_t *ndx_groups)
 {
-    // check that the query is valid
+    // no query selects all atoms of the input selection
     if (query == NULL) {
-        atom_selection_t *copy = selection_copy(selection);
-        return copy;
-    };
-
-    // check that the query ends with '\0'
-    char *pos = strchr(query, 0);
-    if (pos == NULL) return NULL;
-
-    // check that the selection is valid
-    if (selection == NULL) return NULL;
+        selection_query_t *compiled = calloc(1, sizeof(selection_query_t));
+        compiled->tokens = calloc(1, sizeof(query_token_t));
+        compiled->tokens[0].type = QUERY_ALL;
+        compiled->n_tokens = 1;
+        return compiled;
+    }
 
     // check that the number of '(' and ')' match each other
     int par_open = 0;
@@ -1299,15 +1882,50 @@ atom_selection_t *smart_select(const atom_selection_t *selection, const char *qu
     }
     if (par_open != par_close) return NULL;
 
-    // expand the 'to' macro
-    char *query_expanded = NULL;
-    if (expand_to(&query_expanded, query) != 0) {
-        free(query_expanded);
-        return NULL;
-    }
+    // ranges of residue and atom numbers are not expanded, they are only checked here
+    if (check_to(query) != 0) return NULL;
+
+    char *query_copy = malloc(strlen(query) + 1);
+    strcpy(query_copy, query);
+    selection_query_t *compiled = query_compile_block(query_copy, ndx_groups);
+    free(query_copy);
+
+    return compiled;
+}
+
+atom_selection_t *query_eval(const selection_query_t *query, const atom_selection_t *selection)
+{
+    return query_eval_system(query, selection, NULL);
+}
+
+atom_selection_t *query_eval_system(const selection_query_t *query, const atom_selection_t *selection, const system_t *system)
+{
+    if (query == NULL || selection == NULL) return NULL;
+
+    return query_evaluate(query, selection, system != NULL ? system->topology : NULL);
+}
+
+atom_selection_t *smart_select(const atom_selection_t *selection, const char *query, const dict_t *ndx_groups)
+{
+    return smart_select_system(selection, query, ndx_groups, NULL);
+}
+
+atom_selection_t *smart_select_system(const atom_selection_t *selection, const char *query, const dict_t *ndx_groups, const system_t *system)
+{
+    // check that the query is valid
+    if (query == NULL) {
+        atom_selection_t *copy = selection_copy(selection);
+        return copy;
+    };
+
+    // check that the selection is valid
+    if (selection == NULL) return NULL;
+
+    selection_query_t *compiled = query_compile(query, ndx_groups);
+    if (compiled == NULL) return NULL;
 
-    atom_selection_t *final = parse_query(selection, query_expanded, ndx_groups);
-    free(query_expanded);
+    atom_selection_t *final = query_evaluate(compiled, selection, system != NULL ? system->topology : NULL);
+    query_destroy(compiled);
 
     return final;
 }
@@ -7,6 +7,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "gro.h"
+#include "atom_bitmap.h"
 
 /*! @brief Splits string by delimiter and saves the substrings into an array. 
  * 
@@ -185,6 +186,9 @@ void selection_add(
  * Only supports single match_function for all the match elements.
  * Use smart_select() for more advanced queries.
  * 
+ * Residue and atom names are packed into integers when they are compared, so they are matched
+ * without calling match_residue_name() or match_atom_name() for every atom.
+ * 
  * The function allocates memory for a new selection and returns a pointer to this selection.
  * 
  * @param input_atoms           selection of atoms to choose from
@@ -199,6 +203,28 @@ atom_selection_t *select_atoms(
         int (*match_function)(const atom_t *, const char *));
 
 
+/*! @brief Same as select_atoms() but uses the topology index of the system, if it is enabled.
+ *
+ * @paragraph Details
+ * If the topology index is enabled for the system (see system_topology_enable()), all atoms of input_atoms
+ * belong to the system and match_function is one of match_residue_name(), match_residue_num(), match_atom_name()
+ * or match_atom_num(), the matching atoms are looked up in the index instead. The returned selection is the same
+ * as the selection returned by select_atoms(). If 'system' is NULL, this function is identical to select_atoms().
+ *
+ * @param input_atoms           selection of atoms to choose from
+ * @param match_string          string of elements separated by spaces
+ * @param match_function        pointer to a function used for matching
+ * @param system                system the atoms belong to (can be NULL)
+ *
+ * @return Pointer to new atom selection.
+ */
+atom_selection_t *select_atoms_system(
+        const atom_selection_t *input_atoms,
+        const char *match_string,
+        int (*match_function)(const atom_t *, const char *),
+        const system_t *system);
+
+
 /*! @brief Same as select_atoms() but the input selection is deallocated. */
 atom_selection_t *select_atoms_d(
         atom_selection_t *input_atoms,
@@ -217,6 +243,23 @@ atom_selection_t *select_atoms_d(
 atom_selection_t *select_system(system_t *system);
 
 
+/*! @brief Gets indices of the selected atoms in the system.
+ *
+ * @paragraph Details
+ * The i-th element of the returned array is the index of the i-th atom of the selection
+ * in system->atoms. The indices can be used to access the block of positions of the system
+ * (see system_positions_enable() and center_of_geometry_block()).
+ * All atoms of the selection must belong to the system.
+ *
+ * @param selection             selection of atoms
+ * @param system                system_t structure containing the selected atoms
+ *
+ * @return Pointer to an array of selection->n_atoms indices. NULL if memory could not be allocated.
+ * The array must be deallocated using free().
+ */
+size_t *selection_get_indices(const atom_selection_t *selection, const system_t *system);
+
+
 /*! @brief Concatenates two atom selections.
  *
  * @paragraph Details
@@ -244,15 +287,13 @@ atom_selection_t *selection_cat_d(atom_selection_t *selection1, atom_selection_t
  * Does NOT destroy or deallocate any of the input selections.
  * Makes sure that there are no duplicate atoms in the concatenated selection.
  * 
- * @paragraph Note on speed
- * Note that selection_cat_unique() is slower than selection_cat(). If you are sure that your
- * input selections do not contain duplicates, use selection_cat().
+ * Only atoms of selection2 are checked for being present in selection1, i.e. duplicates already
+ * present in selection1 or in selection2 alone are not removed.
  * 
- * If you have to use selection_cat_unique(), it is a good idea (performance-wise) to use
- * the larger selection as the first argument and the smaller selection as the second argument.
- * 
- * You can achieve the same behavior as selection_cat_unique() with subsequent calls of
- * selection_cat() and selection_unique(). Selection_cat_unique() is however an order of magnitude faster.
+ * @paragraph Note on speed
+ * If the atoms of both selections belong to the same system, atoms of selection1 are marked
+ * in a bitmap (see atom_bitmap_t), so the function runs in linear time. Otherwise, every atom
+ * of selection2 is compared with every atom of selection1.
  * 
  * @param selection1            atom selection n1
  * @param selection2            atom selection n2
@@ -271,6 +312,7 @@ atom_selection_t *selection_cat_unique_d(atom_selection_t *selection1, atom_sele
  * @paragraph Details
  * Allocates enough memory for the output selection.
  * Does NOT destroy or deallocate any of the input selections.
+ * Atoms in the output selection keep the order of selection1.
  *
  * @param selection1            atom selection n1
  * @param selection2            atom selection n2
@@ -320,6 +362,8 @@ size_t selection_remove_legacy(atom_selection_t *selection_result, const atom_se
  *
  * @paragraph Details
  * The amount of memory allocated to any selection is not changed by this function.
+ * All occurrences of the subtracted atoms are removed; the remaining atoms keep their order.
+ * If the atoms of both selections belong to the same system, the function runs in linear time.
  * 
  * @param selection_result             atom selection to modify
  * @param selection_sub                atom selection to be subtracted
@@ -336,7 +380,7 @@ size_t selection_remove_d(atom_selection_t *selection_result, atom_selection_t *
 /*! @brief Removes all duplicit entries in the selection.
  *
  * @paragraph Details
- * Keeps the other atoms in the same order. Does not deallocate memory.
+ * Keeps the first occurrence of each atom and the other atoms in the same order. Does not deallocate memory.
  * 
  * @param selection                     atom selection to modify
  * 
@@ -529,7 +573,7 @@ size_t selection_getnres(const atom_selection_t *selection);
  *
  * @param selection             selection of atoms to search in
  * 
- * @return Pointer to a list_t structure.
+ * @return Pointer to a list_t structure. NULL if the memory could not be allocated.
  */ 
 list_t *selection_getresnames(const atom_selection_t *selection);
 
@@ -692,6 +736,76 @@ atom_selection_t *select_geometry_d(
 atom_selection_t *smart_select(const atom_selection_t *selection, const char *query, const dict_t *ndx_groups);
 
 
+/*! @brief Same as smart_select() but uses the topology index of the system, if it is enabled.
+ *
+ * @paragraph Details
+ * Atoms with the target residue names, residue numbers, atom names and atom numbers are looked up
+ * in the topology index of the system (see system_topology_enable()) instead of matching every atom
+ * of the input selection. If the input selection contains atoms not belonging to the system, the atoms are matched as usual.
+ * The returned selection is the same as the selection returned by smart_select().
+ * If 'system' is NULL, this function is identical to smart_select().
+ *
+ * @param selection             selection of atoms to choose from
+ * @param query                 query to be parsed
+ * @param ndx_groups            dictionary containing definitions of the ndx groups (use read_ndx() to obtain it)
+ * @param system                system the atoms belong to (can be NULL)
+ *
+ * @return Pointer to the atom selection. NULL in case the parsing fails. If query is NULL, returns copy of the input selection.
+ */
+atom_selection_t *smart_select_system(const atom_selection_t *selection, const char *query, const dict_t *ndx_groups, const system_t *system);
+
+
+/*! @brief Compiled selection query. Use query_compile() to create it and query_destroy() to deallocate it. */
+typedef struct selection_query selection_query_t;
+
+
+/*! @brief Compiles a query in groan selection language into a plan that can be evaluated repeatedly.
+ *
+ * @paragraph Details
+ * The query is expanded, split and parsed only once. Names and numbers to match are pre-split
+ * (and pre-parsed), ndx groups are looked up and copied into the plan. Parts of the query that do not
+ * depend on the input selection (ndx groups combined by 'and'/'or', also inside parentheses) are evaluated
+ * during compilation and their result is cached in the plan. Use query_eval() to apply the plan to a selection.
+ *
+ * smart_select(selection, query, ndx_groups) is equivalent to compiling the query and evaluating it once.
+ * When the same query is applied to many selections (e.g. in every frame of a trajectory),
+ * compile it once and use query_eval() instead.
+ *
+ * @paragraph Note on ndx groups
+ * Ndx groups are copied during compilation, so the 'ndx_groups' dictionary can be destroyed
+ * while the compiled query is still in use. Later changes to the dictionary do not affect the compiled query.
+ *
+ * @param query                 query to be compiled
+ * @param ndx_groups            dictionary containing definitions of the ndx groups (can be NULL, see smart_select())
+ *
+ * @return Pointer to the compiled query. NULL if the query contains a syntax error or refers to an unknown ndx group.
+ * If query is NULL, returns a compiled query selecting all atoms of the input selection.
+ */
+selection_query_t *query_compile(const char *query, const dict_t *ndx_groups);
+
+
+/*! @brief Selects atoms from the selection using a compiled query.
+ *
+ * @paragraph Details
+ * Returns the same atoms in the same order as smart_select() called with the query string
+ * the compiled query was created from. The returned selection must always be freed.
+ *
+ * @param query                 compiled query (see query_compile())
+ * @param selection             selection of atoms to choose from
+ *
+ * @return Pointer to the atom selection. NULL if query or selection is NULL.
+ */
+atom_selection_t *query_eval(const selection_query_t *query, const atom_selection_t *selection);
+
+
+/*! @brief Same as query_eval() but uses the topology index of the system, if it is enabled (see smart_select_system()). */
+atom_selection_t *query_eval_system(const selection_query_t *query, const atom_selection_t *selection, const system_t *system);
+
+
+/*! @brief Deallocates memory for the compiled query. Does nothing if query is NULL. */
+void query_destroy(selection_query_t *query);
+
+
 /*! @brief Select atoms based on the provided geometry query.
  *
  * @paragraph Groan selection language
@@ -0,0 +1,238 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <string.h>
+#include "topology_index.h"
+
+/* Slice of atom indices of atoms sharing the same name. */
+typedef struct topology_slice {
+    size_t start;
+    size_t count;
+    size_t filled;
+} topology_slice_t;
+
+/*! @brief Compares residue ranges by residue number and then by their first atom. */
+static int compare_ranges(const void *x, const void *y)
+{
+    const topology_range_t *range1 = (const topology_range_t *) x;
+    const topology_range_t *range2 = (const topology_range_t *) y;
+
+    if (range1->residue_number != range2->residue_number) return (range1->residue_number > range2->residue_number) ? 1 : -1;
+    return (range1->start > range2->start) - (range1->start < range2->start);
+}
+
+/*! @brief Compares atoms by gromacs atom number and then by their index. */
+static int compare_serials(const void *x, const void *y)
+{
+    const topology_serial_t *serial1 = (const topology_serial_t *) x;
+    const topology_serial_t *serial2 = (const topology_serial_t *) y;
+
+    if (serial1->gmx_atom_number != serial2->gmx_atom_number) return (serial1->gmx_atom_number > serial2->gmx_atom_number) ? 1 : -1;
+    return (serial1->atom > serial2->atom) - (serial1->atom < serial2->atom);
+}
+
+/*! @brief Returns residue name (if 'residue' is non-zero) or atom name of the atom. */
+static inline const char *topology_atom_name(const atom_t *atom, int residue)
+{
+    return residue ? atom->residue_name : atom->atom_name;
+}
+
+/*! @brief Groups atom indices by residue or atom name.
+ *
+ * @paragraph Details
+ * Indices of atoms with the same name are written into a contiguous slice of 'grouped' in ascending order.
+ *
+ * @return Dictionary mapping the names to the slices of 'grouped'. NULL if the memory could not be allocated.
+ */
+static dict_t *topology_group_names(const topology_index_t *index, int residue, size_t *grouped)
+{
+    dict_t *slices = dict_create();
+    if (slices == NULL) return NULL;
+
+    // count atoms with each name
+    for (size_t i = 0; i < index->n_atoms; ++i) {
+        const char *name = topology_atom_name(&index->atoms[i], residue);
+        topology_slice_t *slice = (topology_slice_t *) dict_get(slices, name);
+        if (slice != NULL) {
+            slice->count++;
+            continue;
+        }
+
+        topology_slice_t new_slice = { 0, 1, 0 };
+        if (dict_set(slices, name, &new_slice, sizeof(topology_slice_t)) != 0) {
+            dict_destroy(slices);
+            return NULL;
+        }
+    }
+
+    // assign a part of the array to each name
+    char **keys = NULL;
+    size_t n_keys = dict_keys(slices, &keys);
+    size_t start = 0;
+    for (size_t k = 0; k < n_keys; ++k) {
+        topology_slice_t *slice = (topology_slice_t *) dict_get(slices, keys[k]);
+        slice->start = start;
+        start += slice->count;
+    }
+    free(keys);
+
+    for (size_t i = 0; i < index->n_atoms; ++i) {
+        topology_slice_t *slice = (topology_slice_t *) dict_get(slices, topology_atom_name(&index->atoms[i], residue));
+        grouped[slice->start + slice->filled] = i;
+        slice->filled++;
+    }
+
+    return slices;
+}
+
+topology_index_t *topology_index_create(system_t *system)
+{
+    topology_index_t *index = calloc(1, sizeof(topology_index_t));
+    if (index == NULL) return NULL;
+
+    index->atoms = system->atoms;
+    index->n_atoms = system->n_atoms;
+
+    // at least one item is allocated so that the index can be created even for empty systems
+    size_t items = system->n_atoms > 0 ? system->n_atoms : 1;
+    index->by_resname = malloc(items * sizeof(size_t));
+    index->by_name = malloc(items * sizeof(size_t));
+    index->ranges = malloc(items * sizeof(topology_range_t));
+    index->serials = malloc(items * sizeof(topology_serial_t));
+    if (index->by_resname == NULL || index->by_name == NULL || index->ranges == NULL || index->serials == NULL) {
+        topology_index_destroy(index);
+        return NULL;
+    }
+
+    index->resnames = topology_group_names(index, 1, index->by_resname);
+    index->names = topology_group_names(index, 0, index->by_name);
+    if (index->resnames == NULL || index->names == NULL) {
+        topology_index_destroy(index);
+        return NULL;
+    }
+
+    // split atoms into ranges of consecutive atoms with the same residue number
+    for (size_t i = 0; i < index->n_atoms; ++i) {
+        if (i == 0 || index->atoms[i].residue_number != index->atoms[i - 1].residue_number) {
+            index->ranges[index->n_ranges].residue_number = index->atoms[i].residue_number;
+            index->ranges[index->n_ranges].start = i;
+            index->n_ranges++;
+        }
+        index->ranges[index->n_ranges - 1].end = i + 1;
+    }
+    qsort(index->ranges, index->n_ranges, sizeof(topology_range_t), &compare_ranges);
+
+    // atoms are usually already ordered by their gromacs atom numbers
+    int sorted = 1;
+    for (size_t i = 0; i < index->n_atoms; ++i) {
+        index->serials[i].gmx_atom_number = index->atoms[i].gmx_atom_number;
+        index->serials[i].atom = i;
+        if (i > 0 && index->serials[i].gmx_atom_number < index->serials[i - 1].gmx_atom_number) sorted = 0;
+    }
+    if (!sorted) qsort(index->serials, index->n_atoms, sizeof(topology_serial_t), &compare_serials);
+
+    return index;
+}
+
+void topology_index_destroy(topology_index_t *index)
+{
+    if (index == NULL) return;
+
+    dict_destroy(index->resnames);
+    dict_destroy(index->names);
+    free(index->by_resname);
+    free(index->by_name);
+    free(index->ranges);
+    free(index->serials);
+    free(index);
+}
+
+size_t topology_index_resname(const topology_index_t *index, const char *resname, const size_t **atoms)
+{
+    const topology_slice_t *slice = (const topology_slice_t *) dict_get(index->resnames, resname);
+    if (slice == NULL) {
+        *atoms = NULL;
+        return 0;
+    }
+
+    *atoms = &(index->by_resname[slice->start]);
+    return slice->count;
+}
+
+size_t topology_index_name(const topology_index_t *index, const char *name, const size_t **atoms)
+{
+    const topology_slice_t *slice = (const topology_slice_t *) dict_get(index->names, name);
+    if (slice == NULL) {
+        *atoms = NULL;
+        return 0;
+    }
+
+    *atoms = &(index->by_name[slice->start]);
+    return slice->count;
+}
+
+size_t topology_index_resid(const topology_index_t *index, groint_t resid, const topology_range_t **ranges)
+{
+    return topology_index_resid_range(index, resid, resid, ranges);
+}
+
+size_t topology_index_resid_range(const topology_index_t *index, groint_t low, groint_t high, const topology_range_t **ranges)
+{
+    // find the first range with residue number not lower than 'low'
+    size_t first = 0, last = index->n_ranges;
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        if (index->ranges[mid].residue_number < low) first = mid + 1;
+        else last = mid;
+    }
+
+    size_t count = 0;
+    while (first + count < index->n_ranges && index->ranges[first + count].residue_number <= high) ++count;
+
+    *ranges = count > 0 ? &(index->ranges[first]) : NULL;
+    return count;
+}
+
+size_t topology_index_serial(const topology_index_t *index, size_t serial, const topology_serial_t **atoms)
+{
+    return topology_index_serial_range(index, serial, serial, atoms);
+}
+
+size_t topology_index_serial_range(const topology_index_t *index, size_t low, size_t high, const topology_serial_t **atoms)
+{
+    // find the first atom with gromacs atom number not lower than 'low'
+    size_t first = 0, last = index->n_atoms;
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        if (index->serials[mid].gmx_atom_number < low) first = mid + 1;
+        else last = mid;
+    }
+
+    size_t count = 0;
+    while (first + count < index->n_atoms && index->serials[first + count].gmx_atom_number <= high) ++count;
+
+    *atoms = count > 0 ? &(index->serials[first]) : NULL;
+    return count;
+}
+
+int system_topology_enable(system_t *system)
+{
+    topology_index_t *index = topology_index_create(system);
+    if (index == NULL) return 1;
+
+    system_topology_disable(system);
+    system->topology = index;
+
+    return 0;
+}
+
+const topology_index_t *system_topology(const system_t *system)
+{
+    return system->topology;
+}
+
+void system_topology_disable(system_t *system)
+{
+    topology_index_destroy(system->topology);
+    system->topology = NULL;
+}
@@ -0,0 +1,145 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TOPOLOGY_INDEX_H
+#define TOPOLOGY_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "gro.h"
+#include "general_structs/dict.h"
+
+/* Range of atoms [start, end) with the same residue number. Atom indices refer to system->atoms. */
+typedef struct topology_range {
+    groint_t residue_number;
+    size_t start;
+    size_t end;
+} topology_range_t;
+
+/* Atom with its gromacs atom number. Atom index refers to system->atoms. */
+typedef struct topology_serial {
+    size_t gmx_atom_number;
+    size_t atom;
+} topology_serial_t;
+
+/*! @brief Lookup tables mapping residue names, residue numbers, atom names and atom numbers to the atoms of a system.
+ *
+ * @paragraph Details
+ * Residue and atom names are mapped through hash tables to ascending lists of atom indices stored in 'by_resname'
+ * and 'by_name'. Residue numbers are mapped to ranges of consecutive atoms sorted by residue number,
+ * gromacs atom numbers to atoms sorted by atom number. All atom indices refer to system->atoms.
+ *
+ * The index reflects the names and numbers of atoms at the time it was created. If they are changed
+ * (e.g. by selection_renumber() or selection_fixres()), the index must be created again.
+ */
+typedef struct topology_index {
+    atom_t *atoms;                  /* atoms of the indexed system */
+    size_t n_atoms;                 /* number of atoms of the indexed system */
+    dict_t *resnames;               /* residue name -> slice of 'by_resname' */
+    dict_t *names;                  /* atom name -> slice of 'by_name' */
+    size_t *by_resname;             /* atom indices grouped by residue name */
+    size_t *by_name;                /* atom indices grouped by atom name */
+    size_t n_ranges;                /* number of residue ranges */
+    topology_range_t *ranges;       /* residue ranges sorted by residue number and start */
+    topology_serial_t *serials;     /* atoms sorted by gromacs atom number (n_atoms items) */
+} topology_index_t;
+
+
+/*! @brief Creates topology index for the atoms of a system.
+ *
+ * @paragraph Details
+ * The index is independent of the system; use system_topology_enable() to store
+ * the index in the system so that the selection functions can use it.
+ *
+ * @param system        pointer to a structure containing information about the system
+ *
+ * @return Pointer to the created topology_index_t structure. NULL if the memory could not be allocated.
+ */
+topology_index_t *topology_index_create(system_t *system);
+
+
+/*! @brief Deallocates memory for the topology index. Does nothing if index is NULL. */
+void topology_index_destroy(topology_index_t *index);
+
+
+/*! @brief Gets atoms with the target residue name.
+ *
+ * @param index         topology index
+ * @param resname       residue name to look for
+ * @param atoms         pointer to which the ascending list of atom indices will be assigned (NULL if there are no such atoms)
+ *
+ * @return Number of atoms with the target residue name.
+ */
+size_t topology_index_resname(const topology_index_t *index, const char *resname, const size_t **atoms);
+
+
+/*! @brief Gets atoms with the target atom name. Works the same way as topology_index_resname(). */
+size_t topology_index_name(const topology_index_t *index, const char *name, const size_t **atoms);
+
+
+/*! @brief Gets ranges of atoms with the target residue number.
+ *
+ * @paragraph Details
+ * Residue numbers in gro files are not unique (they wrap around after 99999), so a single residue
+ * number may correspond to several ranges of atoms. The ranges are sorted by their first atom.
+ *
+ * @param index         topology index
+ * @param resid         residue number to look for
+ * @param ranges        pointer to which the first matching range will be assigned (NULL if there are no such atoms)
+ *
+ * @return Number of ranges of atoms with the target residue number.
+ */
+size_t topology_index_resid(const topology_index_t *index, groint_t resid, const topology_range_t **ranges);
+
+
+/*! @brief Gets ranges of atoms with residue numbers between 'low' and 'high' (inclusive).
+ *
+ * @paragraph Details
+ * The ranges are sorted by residue number and then by their first atom.
+ * Works the same way as topology_index_resid() otherwise.
+ */
+size_t topology_index_resid_range(const topology_index_t *index, groint_t low, groint_t high, const topology_range_t **ranges);
+
+
+/*! @brief Gets atoms with the target gromacs atom number.
+ *
+ * @param index         topology index
+ * @param serial        gromacs atom number to look for
+ * @param atoms         pointer to which the first matching atom will be assigned (NULL if there are no such atoms)
+ *
+ * @return Number of atoms with the target gromacs atom number (usually one).
+ */
+size_t topology_index_serial(const topology_index_t *index, size_t serial, const topology_serial_t **atoms);
+
+
+/*! @brief Gets atoms with gromacs atom numbers between 'low' and 'high' (inclusive), sorted by atom number. */
+size_t topology_index_serial_range(const topology_index_t *index, size_t low, size_t high, const topology_serial_t **atoms);
+
+
+/*! @brief Creates topology index for the system and stores it in system->topology.
+ *
+ * @paragraph Details
+ * While the index is enabled, select_atoms_system(), smart_select_system() and query_eval_system()
+ * look up atoms of the system with the target residue names, residue numbers, atom names and atom numbers
+ * in the index instead of matching every atom of the input selection. The results are not changed.
+ *
+ * If the index is already enabled for the system, it is created again (e.g. after renumbering the atoms).
+ *
+ * The index must be deallocated using system_topology_disable() before the system is freed.
+ * The index must not be enabled or disabled while other threads select atoms of the system.
+ *
+ * @param system        pointer to a structure containing information about the system
+ *
+ * @return Zero if successful, else non-zero.
+ */
+int system_topology_enable(system_t *system);
+
+
+/*! @brief Gets the topology index enabled for the system. Returns NULL if no index is enabled. */
+const topology_index_t *system_topology(const system_t *system);
+
+
+/*! @brief Deallocates the topology index of the system. Does nothing if no index is enabled. */
+void system_topology_disable(system_t *system);
+
+#endif /* TOPOLOGY_INDEX_H */
@@ -0,0 +1,352 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "traj_index.h"
+
+/* Number of frames for which memory is allocated when the index is first filled. */
+#define TRAJ_INDEX_INITIAL_CAPACITY 64
+
+/* Identifier of the sidecar file format. Also detects sidecar files written on machines with different endianness. */
+#define TRAJ_INDEX_MAGIC 0x58444947
+#define TRAJ_INDEX_VERSION 2
+
+/* Number of bytes at the beginning of the trajectory (and at the end of the indexed part) used to calculate the checksums. */
+#define TRAJ_INDEX_CHECKSUM_BYTES 1024
+
+/* Header of the sidecar file. All fields are 8-byte aligned, so the structure contains no padding. */
+typedef struct traj_index_header {
+    uint32_t magic;
+    uint32_t version;
+    int64_t file_size;          /* size of the trajectory when the index was written */
+    int64_t mtime;              /* modification time of the trajectory when the index was written */
+    uint64_t checksum_bytes;    /* number of bytes used to calculate the checksum */
+    uint64_t checksum;          /* checksum of the beginning of the trajectory */
+    uint64_t tail_checksum;     /* checksum of the header of the last indexed frame and of the bytes right before 'end' */
+    int64_t end;                /* position right after the last indexed frame */
+    uint64_t n_frames;          /* number of frames in the index */
+} traj_index_header_t;
+
+traj_index_t *traj_index_create(void)
+{
+    traj_index_t *index = calloc(1, sizeof(traj_index_t));
+    if (index == NULL) return NULL;
+
+    return index;
+}
+
+void traj_index_destroy(traj_index_t *index)
+{
+    if (index == NULL) return;
+
+    free(index->frames);
+    free(index);
+}
+
+int traj_index_append(traj_index_t *index, int64_t offset, int step, float time)
+{
+    // capacity is doubled every time the index is full
+    if (index->n_frames >= index->capacity) {
+        size_t new_capacity = index->capacity == 0 ? TRAJ_INDEX_INITIAL_CAPACITY : 2 * index->capacity;
+
+        traj_frame_t *new_frames = realloc(index->frames, new_capacity * sizeof(traj_frame_t));
+        if (new_frames == NULL) return 1;
+
+        index->frames = new_frames;
+        index->capacity = new_capacity;
+    }
+
+    traj_frame_t *frame = &(index->frames[index->n_frames]);
+    frame->offset = offset;
+    frame->step = step;
+    frame->time = time;
+    index->n_frames++;
+
+    return 0;
+}
+
+int traj_index_extend(traj_index_t *index, XDRFILE *file, traj_skip_t skip)
+{
+    int64_t original_position = xdr_tell(file);
+    if (original_position < 0) return 1;
+
+    // get the size of the file so that truncated frames can be recognized
+    if (xdr_seek(file, 0, SEEK_END) != exdrOK) return 1;
+    int64_t file_size = xdr_tell(file);
+    if (xdr_seek(file, index->end, SEEK_SET) != exdrOK) {
+        xdr_seek(file, original_position, SEEK_SET);
+        return 1;
+    }
+
+    int natoms = 0, step = 0;
+    float time = 0.0f;
+    while (skip(file, &natoms, &step, &time) == exdrOK) {
+        // frame ending beyond the end of the file is truncated
+        int64_t end = xdr_tell(file);
+        if (end > file_size) break;
+
+        if (traj_index_append(index, index->end, step, time) != 0) {
+            xdr_seek(file, original_position, SEEK_SET);
+            return 1;
+        }
+
+        index->end = end;
+    }
+
+    xdr_seek(file, original_position, SEEK_SET);
+    return 0;
+}
+
+size_t traj_index_find_time(const traj_index_t *index, float time)
+{
+    if (index->n_frames == 0) return 0;
+
+    // find the first frame with time not smaller than the target time
+    size_t low = 0, high = index->n_frames;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->frames[middle].time < time) low = middle + 1;
+        else high = middle;
+    }
+
+    if (low == index->n_frames) return low - 1;
+    if (low > 0 && time - index->frames[low - 1].time <= index->frames[low].time - time) return low - 1;
+    return low;
+}
+
+/*! @brief Returns the path to the sidecar file of the trajectory. The returned string must be deallocated. */
+static char *traj_index_path(const char *trajectory)
+{
+    char *path = malloc(strlen(trajectory) + strlen(TRAJ_INDEX_SUFFIX) + 1);
+    if (path == NULL) return NULL;
+
+    strcpy(path, trajectory);
+    strcat(path, TRAJ_INDEX_SUFFIX);
+    return path;
+}
+
+/*! @brief Gets the size and modification time of the trajectory file. Returns 0 if successful, else 1. */
+static int traj_file_stat(const char *trajectory, int64_t *size, int64_t *mtime)
+{
+    struct stat info;
+    if (stat(trajectory, &info) != 0) return 1;
+
+    *size = (int64_t) info.st_size;
+    *mtime = (int64_t) info.st_mtime;
+    return 0;
+}
+
+/* Initial value of the FNV-1a checksum. */
+#define TRAJ_INDEX_CHECKSUM_SEED 14695981039346656037ULL
+
+/*! @brief Updates FNV-1a checksum with n_bytes of the open file starting at offset. Returns 0 if successful, else 1. */
+static int traj_file_hash(FILE *file, int64_t offset, uint64_t n_bytes, uint64_t *checksum)
+{
+    unsigned char buffer[TRAJ_INDEX_CHECKSUM_BYTES];
+    if (n_bytes > TRAJ_INDEX_CHECKSUM_BYTES) return 1;
+
+    if (fseeko(file, (off_t) offset, SEEK_SET) != 0) return 1;
+    if (fread(buffer, 1, n_bytes, file) != n_bytes) return 1;
+
+    uint64_t hash = *checksum;
+    for (size_t i = 0; i < n_bytes; ++i) {
+        hash ^= buffer[i];
+        hash *= 1099511628211ULL;
+    }
+
+    *checksum = hash;
+    return 0;
+}
+
+/*! @brief Calculates FNV-1a checksum of the first n_bytes of the trajectory file. Returns 0 if successful, else 1. */
+static int traj_file_checksum(const char *trajectory, uint64_t n_bytes, uint64_t *checksum)
+{
+    FILE *file = fopen(trajectory, "rb");
+    if (file == NULL) return 1;
+
+    *checksum = TRAJ_INDEX_CHECKSUM_SEED;
+    int error = traj_file_hash(file, 0, n_bytes, checksum);
+    fclose(file);
+
+    return error;
+}
+
+/*! @brief Calculates checksum of the end of the indexed part of the trajectory file. Returns 0 if successful, else 1.
+ *
+ * @paragraph Details
+ * The checksum covers the beginning of the last indexed frame and the bytes right before 'end'.
+ * A trajectory rewritten with the same first frame (e.g. a rerun of a simulation) thus does not
+ * match the index even if it is longer than the indexed part.
+ */
+static int traj_file_tail_checksum(const char *trajectory, int64_t last_frame, int64_t end, uint64_t *checksum)
+{
+    FILE *file = fopen(trajectory, "rb");
+    if (file == NULL) return 1;
+
+    int64_t frame_bytes = end - last_frame < TRAJ_INDEX_CHECKSUM_BYTES ? end - last_frame : TRAJ_INDEX_CHECKSUM_BYTES;
+    int64_t tail_bytes = end < TRAJ_INDEX_CHECKSUM_BYTES ? end : TRAJ_INDEX_CHECKSUM_BYTES;
+
+    *checksum = TRAJ_INDEX_CHECKSUM_SEED;
+    int error = traj_file_hash(file, last_frame, (uint64_t) frame_bytes, checksum) ||
+                traj_file_hash(file, end - tail_bytes, (uint64_t) tail_bytes, checksum);
+    fclose(file);
+
+    return error;
+}
+
+/*! @brief Returns the position of the last frame of the index or 'end' if the index is empty. */
+static inline int64_t traj_index_last_frame(const traj_frame_t *frames, size_t n_frames, int64_t end)
+{
+    return n_frames > 0 ? frames[n_frames - 1].offset : end;
+}
+
+int traj_index_save(const traj_index_t *index, const char *trajectory)
+{
+    traj_index_header_t header = {0};
+    header.magic = TRAJ_INDEX_MAGIC;
+    header.version = TRAJ_INDEX_VERSION;
+    header.end = index->end;
+    header.n_frames = index->n_frames;
+
+    if (traj_file_stat(trajectory, &header.file_size, &header.mtime) != 0) return 1;
+
+    header.checksum_bytes = header.file_size < TRAJ_INDEX_CHECKSUM_BYTES ? (uint64_t) header.file_size : TRAJ_INDEX_CHECKSUM_BYTES;
+    if (traj_file_checksum(trajectory, header.checksum_bytes, &header.checksum) != 0) return 1;
+    int64_t last_frame = traj_index_last_frame(index->frames, index->n_frames, index->end);
+    if (traj_file_tail_checksum(trajectory, last_frame, index->end, &header.tail_checksum) != 0) return 1;
+
+    char *path = traj_index_path(trajectory);
+    if (path == NULL) return 1;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        free(path);
+        return 1;
+    }
+
+    int error = fwrite(&header, sizeof(traj_index_header_t), 1, file) != 1;
+    if (!error && index->n_frames > 0) {
+        error = fwrite(index->frames, sizeof(traj_frame_t), index->n_frames, file) != index->n_frames;
+    }
+    error |= fclose(file) != 0;
+
+    // do not leave incomplete sidecar files behind
+    if (error) remove(path);
+
+    free(path);
+    return error;
+}
+
+traj_index_t *traj_index_load(const char *trajectory, int *up_to_date)
+{
+    int64_t size = 0, mtime = 0;
+    if (traj_file_stat(trajectory, &size, &mtime) != 0) return NULL;
+
+    char *path = traj_index_path(trajectory);
+    if (path == NULL) return NULL;
+
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (file == NULL) return NULL;
+
+    traj_index_header_t header = {0};
+    if (fread(&header, sizeof(traj_index_header_t), 1, file) != 1 ||
+            header.magic != TRAJ_INDEX_MAGIC ||
+            header.version != TRAJ_INDEX_VERSION ||
+            header.end > header.file_size ||
+            header.n_frames > (uint64_t) header.end) {
+        fclose(file);
+        return NULL;
+    }
+
+    // the trajectory must not shrink and must not be rewritten in place
+    if (size < header.file_size || (size == header.file_size && mtime != header.mtime)) {
+        fclose(file);
+        return NULL;
+    }
+
+    // the beginning of the trajectory must be identical
+    uint64_t checksum = 0;
+    if (traj_file_checksum(trajectory, header.checksum_bytes, &checksum) != 0 || checksum != header.checksum) {
+        fclose(file);
+        return NULL;
+    }
+
+    traj_index_t *index = traj_index_create();
+    if (index == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    if (header.n_frames > 0) {
+        index->frames = malloc(header.n_frames * sizeof(traj_frame_t));
+        if (index->frames == NULL || fread(index->frames, sizeof(traj_frame_t), header.n_frames, file) != header.n_frames) {
+            fclose(file);
+            traj_index_destroy(index);
+            return NULL;
+        }
+    }
+    fclose(file);
+
+    index->n_frames = header.n_frames;
+    index->capacity = header.n_frames;
+    index->end = header.end;
+
+    // frames must be ordered and lie inside the indexed part of the trajectory
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        if (index->frames[i].offset >= index->end || (i > 0 && index->frames[i].offset <= index->frames[i - 1].offset)) {
+            traj_index_destroy(index);
+            return NULL;
+        }
+    }
+
+    // the end of the indexed part must be identical, otherwise the offsets may point into the middle of frames
+    uint64_t tail_checksum = 0;
+    int64_t last_frame = traj_index_last_frame(index->frames, index->n_frames, index->end);
+    if (traj_file_tail_checksum(trajectory, last_frame, index->end, &tail_checksum) != 0 || tail_checksum != header.tail_checksum) {
+        traj_index_destroy(index);
+        return NULL;
+    }
+
+    *up_to_date = (size == header.file_size);
+    return index;
+}
+
+traj_index_t *traj_index_obtain(const char *trajectory, traj_skip_t skip)
+{
+    int up_to_date = 0;
+    traj_index_t *index = traj_index_load(trajectory, &up_to_date);
+    if (index != NULL && up_to_date) return index;
+
+    XDRFILE *file = xdrfile_open(trajectory, "r");
+    if (file == NULL) {
+        traj_index_destroy(index);
+        return NULL;
+    }
+
+    // the trajectory has grown since the sidecar was written: only scan the new frames
+    if (index != NULL && traj_index_extend(index, file, skip) != 0) {
+        traj_index_destroy(index);
+        index = NULL;
+    }
+
+    if (index == NULL) {
+        index = traj_index_create();
+        if (index != NULL && traj_index_extend(index, file, skip) != 0) {
+            traj_index_destroy(index);
+            index = NULL;
+        }
+    }
+
+    xdrfile_close(file);
+    if (index == NULL) return NULL;
+
+    // failing to write the sidecar file (e.g. in a read-only directory) is not an error
+    traj_index_save(index, trajectory);
+
+    return index;
+}
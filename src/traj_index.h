@@ -0,0 +1,141 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TRAJ_INDEX_H
+#define TRAJ_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "xdrfile/xdrfile.h"
+
+/* Structure containing the position and identity of a single trajectory frame. */
+typedef struct traj_frame {
+    int64_t offset;         /* position of the start of the frame in the file (in bytes) */
+    int step;               /* simulation step of the frame */
+    float time;             /* simulation time of the frame in ps */
+} traj_frame_t;
+
+/*! @brief Table of frames of a trajectory file allowing random access to the frames.
+ *
+ * @paragraph Details
+ * Unlike list_t, the index allocates memory for frames in chunks, so appending frames is cheap.
+ * n_frames is the number of frames stored, capacity is the number of frames allocated.
+ * end is the position right after the last indexed frame; scanning of a grown trajectory resumes from there.
+ */
+typedef struct traj_index {
+    size_t n_frames;
+    size_t capacity;
+    int64_t end;
+    traj_frame_t *frames;
+} traj_index_t;
+
+/* Suffix of the sidecar file in which the index of a trajectory is stored. */
+#define TRAJ_INDEX_SUFFIX ".gidx"
+
+/* Function reading the header of the next frame of a trajectory and skipping the rest of the frame (e.g. skip_xtc, skip_trr). */
+typedef int (*traj_skip_t)(XDRFILE *file, int *natoms, int *step, float *time);
+
+
+/*! @brief Creates an empty trajectory index. The index must later be destroyed using traj_index_destroy().
+ *
+ * @return Pointer to traj_index_t structure. If the index cannot be created, returns NULL.
+ */
+traj_index_t *traj_index_create(void);
+
+
+/*! @brief Deallocates memory for the trajectory index.
+ *
+ * @param index     pointer to traj_index_t structure to destroy
+ */
+void traj_index_destroy(traj_index_t *index);
+
+
+/*! @brief Adds a frame to the end of the trajectory index.
+ *
+ * @param index     trajectory index to change
+ * @param offset    position of the frame in the file (in bytes)
+ * @param step      simulation step of the frame
+ * @param time      simulation time of the frame
+ *
+ * @return 0 if successful, else 1.
+ */
+int traj_index_append(traj_index_t *index, int64_t offset, int step, float time);
+
+
+/*! @brief Adds the frames of an open trajectory file located after index->end to the index.
+ *
+ * @paragraph Details
+ * The file is scanned frame by frame using the provided skip function, so no frame is decoded.
+ * Scanning stops at the end of the file or at the first frame that is corrupted or truncated;
+ * such a frame and all frames after it are not added to the index.
+ * The position in the file is restored after the scan.
+ *
+ * @param index     trajectory index to extend
+ * @param file      open XDRFILE structure corresponding to the indexed trajectory
+ * @param skip      function reading the header of a frame and skipping the rest of it
+ *
+ * @return 0 if successful, else 1.
+ */
+int traj_index_extend(traj_index_t *index, XDRFILE *file, traj_skip_t skip);
+
+
+/*! @brief Gets the index of frames of a trajectory file, using the sidecar index file if possible.
+ *
+ * @paragraph Details
+ * Implements load_xtc_index() and load_trr_index(); see their description.
+ *
+ * @param trajectory    path to the trajectory file
+ * @param skip          function reading the header of a frame and skipping the rest of it
+ *
+ * @return Pointer to the traj_index_t structure. NULL if the index could not be obtained.
+ */
+traj_index_t *traj_index_obtain(const char *trajectory, traj_skip_t skip);
+
+
+/*! @brief Finds the frame with simulation time closest to the specified time.
+ *
+ * @paragraph Details
+ * Frames in the index must be ordered by time, which is the case for trajectories written by gromacs.
+ * Uses binary search. If two frames are equally close to the target time, the earlier frame is returned.
+ *
+ * @param index     trajectory index to search
+ * @param time      target simulation time in ps
+ *
+ * @return Zero-based number of the frame. If the index is empty, returns 0.
+ */
+size_t traj_index_find_time(const traj_index_t *index, float time);
+
+
+/*! @brief Writes the trajectory index into a sidecar file stored next to the trajectory.
+ *
+ * @paragraph Details
+ * The index is written into a file named like the trajectory with the suffix TRAJ_INDEX_SUFFIX
+ * (e.g. 'md.xtc.gidx' for 'md.xtc'). The sidecar file is in the native binary format of the machine
+ * and contains the size and modification time of the trajectory, a checksum of the beginning of the trajectory
+ * and a checksum of the end of the indexed part (the header of the last indexed frame and the bytes right before index->end),
+ * so that traj_index_load() can recognize whether the index still describes the trajectory.
+ *
+ * @param index         trajectory index to write
+ * @param trajectory    path to the indexed trajectory file
+ *
+ * @return 0 if successful, else 1.
+ */
+int traj_index_save(const traj_index_t *index, const char *trajectory);
+
+
+/*! @brief Reads the trajectory index from a sidecar file stored next to the trajectory.
+ *
+ * @paragraph Details
+ * The index is only loaded if it belongs to the trajectory, i.e. the checksums of the beginning of the
+ * trajectory and of the end of the indexed part match and the trajectory has not shrunk. If the trajectory is unchanged, up_to_date is set to 1.
+ * If the trajectory has grown since the index was written, the loaded index is still valid for the
+ * frames it contains but the new frames are missing. In such case, up_to_date is set to 0.
+ *
+ * @param trajectory    path to the trajectory file
+ * @param up_to_date    pointer to a variable in which the state of the index will be stored
+ *
+ * @return Pointer to the loaded traj_index_t structure. NULL if the sidecar file does not exist or is not valid.
+ */
+traj_index_t *traj_index_load(const char *trajectory, int *up_to_date);
+
+#endif /* TRAJ_INDEX_H */
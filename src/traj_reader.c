@@ -0,0 +1,161 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stddef.h>
+#include <math.h>
+#include "traj_reader.h"
+#include "xtc_io.h"
+
+traj_reader_t *traj_reader_create(XDRFILE *file, system_t *system, traj_type_t type)
+{
+    traj_reader_t *reader = calloc(1, sizeof(traj_reader_t));
+    if (reader == NULL) return NULL;
+
+    reader->file = file;
+    reader->system = system;
+    reader->type = type;
+    reader->fields = TRR_X | TRR_V | TRR_F;
+    reader->begin = -INFINITY;
+    reader->end = INFINITY;
+    reader->stride = 1;
+
+    // at least one item is allocated so that the reader can be created even for empty systems
+    size_t n_items = system->n_atoms > 0 ? system->n_atoms : 1;
+
+    reader->coordinates = malloc(n_items * sizeof(vec_t));
+    if (reader->coordinates == NULL) {
+        traj_reader_destroy(reader);
+        return NULL;
+    }
+
+    if (type == traj_trr) {
+        reader->velocities = malloc(n_items * sizeof(vec_t));
+        reader->forces     = malloc(n_items * sizeof(vec_t));
+
+        if (reader->velocities == NULL || reader->forces == NULL) {
+            traj_reader_destroy(reader);
+            return NULL;
+        }
+    }
+
+    return reader;
+}
+
+/*! @brief Reads an xtc frame into the reader buffers and updates the system. */
+static int traj_reader_read_xtc(traj_reader_t *reader)
+{
+    system_t *system = reader->system;
+    float box[3][3] = {{0}};
+
+    // coordinates are decoded directly into the block of positions, if it is enabled
+    vec_t *coordinates = system->positions != NULL ? system->positions : reader->coordinates;
+
+    if (read_xtc(reader->file, system->n_atoms, &(system->step), &(system->time), box, coordinates, &(system->precision)) != 0) {
+        return 1;
+    }
+
+    box_xtc2gro(box, system->box);
+    if (system->positions != NULL) return 0;
+
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        memcpy(system->atoms[i].position, reader->coordinates[i], 3 * sizeof(float));
+    }
+
+    return 0;
+}
+
+/*! @brief Copies a block of vectors into the atoms of the system or sets the property to zero, if the block is missing. */
+static void traj_reader_scatter(system_t *system, vec_t *block, size_t offset, int present)
+{
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        float *target = (float *) ((char *) &(system->atoms[i]) + offset);
+        if (present) memcpy(target, block[i], 3 * sizeof(float));
+        else memset(target, 0, 3 * sizeof(float));
+    }
+}
+
+/*! @brief Reads a trr frame into the reader buffers and updates the system. */
+static int traj_reader_read_trr(traj_reader_t *reader)
+{
+    system_t *system = reader->system;
+    float box[3][3] = {{0}};
+    int wanted = reader->fields;
+    int fields = 0;
+
+    // coordinates are read directly into the block of positions, if it is enabled
+    vec_t *coordinates = system->positions != NULL ? system->positions : reader->coordinates;
+
+    // blocks that are not wanted are skipped and the corresponding properties are not touched
+    if (read_trr_select(reader->file, system->n_atoms, &(system->step), &(system->time), &(system->lambda), box,
+            (wanted & TRR_X) ? coordinates : NULL,
+            (wanted & TRR_V) ? reader->velocities : NULL,
+            (wanted & TRR_F) ? reader->forces : NULL,
+            wanted, &fields) != 0) {
+        return 1;
+    }
+
+    // despite its name, this function also converts box dimensions from trr format to native groan format
+    box_xtc2gro(box, system->box);
+
+    // the buffers are reused, so blocks missing from the frame must be explicitly set to zero
+    if (wanted & TRR_X) {
+        if (system->positions == NULL) {
+            traj_reader_scatter(system, reader->coordinates, offsetof(atom_t, position), fields & TRR_X);
+        } else if (!(fields & TRR_X)) {
+            memset(system->positions, 0, system->n_atoms * sizeof(vec_t));
+        }
+    }
+    if (wanted & TRR_V) traj_reader_scatter(system, reader->velocities, offsetof(atom_t, velocity), fields & TRR_V);
+    if (wanted & TRR_F) traj_reader_scatter(system, reader->forces,     offsetof(atom_t, force),    fields & TRR_F);
+
+    return 0;
+}
+
+/*! @brief Skips frames until the next frame requested by the time window and stride is found.
+ * Returns 0 if such a frame exists (the file is then positioned at its start), else 1. */
+static int traj_reader_find_next(traj_reader_t *reader)
+{
+    traj_skip_t skip = reader->type == traj_trr ? skip_trr : skip_xtc;
+
+    int natoms = 0, step = 0;
+    float time = 0.0f;
+    while (1) {
+        int64_t start = xdr_tell(reader->file);
+        if (start < 0 || skip(reader->file, &natoms, &step, &time) != exdrOK) return 1;
+        if (time > reader->end) return 1;
+        if (time < reader->begin) continue;
+
+        if (reader->n_window++ % reader->stride == 0) {
+            return xdr_seek(reader->file, start, SEEK_SET) != exdrOK;
+        }
+    }
+}
+
+int traj_reader_read(traj_reader_t *reader)
+{
+    if (reader->windowed && traj_reader_find_next(reader) != 0) return 1;
+
+    if (reader->type == traj_trr) return traj_reader_read_trr(reader);
+    else return traj_reader_read_xtc(reader);
+}
+
+void traj_reader_set_window(traj_reader_t *reader, float begin, float end, size_t stride)
+{
+    reader->begin = begin;
+    reader->end = end;
+    reader->stride = stride > 0 ? stride : 1;
+    reader->n_window = 0;
+
+    // reading every frame does not require peeking at the headers
+    reader->windowed = !(isinf(begin) && begin < 0) || !(isinf(end) && end > 0) || reader->stride > 1;
+}
+
+void traj_reader_destroy(traj_reader_t *reader)
+{
+    if (reader == NULL) return;
+
+    free(reader->coordinates);
+    free(reader->velocities);
+    free(reader->forces);
+    free(reader);
+}
@@ -0,0 +1,119 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TRAJ_READER_H
+#define TRAJ_READER_H
+
+#include <string.h>
+#include "gro.h"
+#include "xdrfile/xdrfile_xtc.h"
+#include "xdrfile/xdrfile_trr.h"
+
+/*
+ * Used to specify the type of a trajectory file.
+ */
+typedef enum traj_type {
+    traj_xtc,
+    traj_trr
+} traj_type_t;
+
+/*! @brief Structure for reading frames from an xtc or trr file into a system.
+ *
+ * @paragraph Details
+ * The reader owns the frame buffers used by the xdrfile library. These buffers are allocated
+ * once, when the reader is created, and are then reused for every frame that is read.
+ * Reading a trajectory using traj_reader_read() therefore does not allocate any memory per frame.
+ *
+ * The reader does not own the XDRFILE nor the system. The caller must close the XDRFILE and
+ * free the system after the reader has been destroyed.
+ *
+ * For trr files, only the blocks flagged in 'fields' are read; the other blocks are skipped without
+ * being decoded and the corresponding properties of the atoms are not touched. 'fields' may be changed
+ * at any time between reading two frames.
+ *
+ * Reading may be limited to a time window and to every n-th frame using traj_reader_set_window().
+ * Frames that are not requested are skipped by reading only their headers.
+ */
+typedef struct traj_reader {
+    XDRFILE *file;          /* open xtc or trr file */
+    system_t *system;       /* system that is updated with every frame */
+    traj_type_t type;       /* type of the trajectory file */
+    vec_t *coordinates;     /* buffer for coordinates of atoms */
+    vec_t *velocities;      /* buffer for velocities of atoms; only allocated for trr files */
+    vec_t *forces;          /* buffer for forces acting on atoms; only allocated for trr files */
+    int fields;             /* blocks of trr frames that are read (TRR_X | TRR_V | TRR_F by default) */
+    int windowed;           /* set if reading is limited by traj_reader_set_window() */
+    float begin;            /* time of the first frame to read (in ps) */
+    float end;              /* time of the last frame to read (in ps) */
+    size_t stride;          /* only every stride-th frame inside the time window is read */
+    size_t n_window;        /* number of frames inside the time window encountered so far */
+} traj_reader_t;
+
+
+/*! @brief Creates a reader for an open xtc or trr file.
+ *
+ * @paragraph Details
+ * Allocates buffers for system->n_atoms atoms. The number of atoms in the system
+ * must not change while the reader exists.
+ *
+ * @param file          open XDRFILE structure corresponding to target xtc or trr file
+ * @param system        pointer to a structure containing information about the system
+ * @param type          type of the trajectory file (traj_xtc or traj_trr)
+ *
+ * @return Pointer to the created traj_reader_t structure. NULL if the memory could not be allocated.
+ */
+traj_reader_t *traj_reader_create(XDRFILE *file, system_t *system, traj_type_t type);
+
+
+/*! @brief Reads the next frame of the trajectory and updates the system.
+ *
+ * @paragraph Details
+ * For xtc files, positions of atoms, box, step, time and precision of the system are updated.
+ * For trr files, positions, velocities and forces of atoms (as selected by reader->fields) as well as box,
+ * step, time and lambda of the system are updated. Selected information missing from the trr frame is set
+ * to zero (see read_trr_step()).
+ * If the block of positions of the system is enabled (see system_positions_enable()),
+ * positions are written into the block instead of the atoms.
+ *
+ * @param reader        pointer to traj_reader_t structure
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int traj_reader_read(traj_reader_t *reader);
+
+
+/*! @brief Limits reading of the trajectory to a time window and to every n-th frame.
+ *
+ * @paragraph Details
+ * Subsequent calls of traj_reader_read() only read frames with time between 'begin' and 'end' (inclusive),
+ * and out of these frames only the first one and then every stride-th frame. Other frames are skipped
+ * using the information in their headers (the compressed size for xtc files, the block sizes for trr files),
+ * so they are never decompressed nor decoded. Once a frame with time larger than 'end' is encountered,
+ * traj_reader_read() reports the end of the trajectory; frames in the trajectory are therefore expected
+ * to be ordered by time.
+ *
+ * Use -INFINITY for 'begin' or INFINITY for 'end' to not limit the window from that side.
+ * Stride of 0 or 1 means that every frame inside the window is read.
+ *
+ * The window applies to the frames following the current position in the file. Setting a new window
+ * restarts counting of the frames for the stride.
+ *
+ * @param reader        pointer to traj_reader_t structure
+ * @param begin         time of the first frame to read (in ps)
+ * @param end           time of the last frame to read (in ps)
+ * @param stride        read only every stride-th frame inside the window
+ */
+void traj_reader_set_window(traj_reader_t *reader, float begin, float end, size_t stride);
+
+
+/*! @brief Deallocates memory for the traj_reader_t structure and all its buffers.
+ *
+ * @paragraph Details
+ * Does NOT close the XDRFILE and does NOT deallocate the system.
+ *
+ * @param reader        pointer to traj_reader_t structure to destroy
+ */
+void traj_reader_destroy(traj_reader_t *reader);
+
+#endif /* TRAJ_READER_H */
@@ -0,0 +1,89 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "traj_scan.h"
+
+/* Relative difference from dt above which a time difference between two frames is considered irregular. */
+#define TRAJ_SCAN_DT_TOLERANCE 1e-3f
+
+/*! @brief Checks whether the time difference between two frames differs from the regular time step. */
+static int traj_scan_irregular(float delta, float dt, float time)
+{
+    // times are stored as floats, so the spacing of floats around the time must be tolerated
+    float tolerance = TRAJ_SCAN_DT_TOLERANCE * fabsf(dt) + 4 * FLT_EPSILON * fabsf(time);
+    return fabsf(delta - dt) > tolerance;
+}
+
+int traj_scan(const char *trajectory, traj_skip_t skip, int repair, traj_scan_t *report)
+{
+    memset(report, 0, sizeof(traj_scan_t));
+    report->first_dt_irregular = -1;
+    report->first_natoms_change = -1;
+    report->corrupt_offset = -1;
+
+    XDRFILE *file = xdrfile_open(trajectory, "r");
+    if (file == NULL) return 1;
+
+    if (xdr_seek(file, 0, SEEK_END) != exdrOK) {
+        xdrfile_close(file);
+        return 1;
+    }
+    report->file_size = xdr_tell(file);
+    if (report->file_size < 0 || xdr_seek(file, 0, SEEK_SET) != exdrOK) {
+        xdrfile_close(file);
+        return 1;
+    }
+
+    int64_t start = 0;
+    int natoms = 0, step = 0, previous_natoms = 0;
+    float time = 0.0f;
+    while (start < report->file_size) {
+        if (skip(file, &natoms, &step, &time) != exdrOK) break;
+
+        // frame ending beyond the end of the file is truncated
+        int64_t end = xdr_tell(file);
+        if (end > report->file_size || end <= start || natoms < 0) break;
+
+        if (report->n_frames == 0) {
+            report->n_atoms = natoms;
+            report->first_time = time;
+        } else {
+            if (natoms != previous_natoms) {
+                if (report->first_natoms_change < 0) report->first_natoms_change = (int64_t) report->n_frames;
+                report->n_natoms_changes++;
+            }
+
+            float delta = time - report->last_time;
+            if (report->n_frames == 1) {
+                report->dt = delta;
+            } else if (traj_scan_irregular(delta, report->dt, time)) {
+                if (report->first_dt_irregular < 0) report->first_dt_irregular = (int64_t) report->n_frames;
+                report->n_dt_irregular++;
+            }
+        }
+
+        report->last_time = time;
+        previous_natoms = natoms;
+        report->n_frames++;
+        start = end;
+    }
+
+    xdrfile_close(file);
+
+    report->valid_size = start;
+    if (start < report->file_size) report->corrupt_offset = start;
+
+    if (repair && report->corrupt_offset >= 0) {
+        if (truncate(trajectory, (off_t) report->valid_size) != 0) return 1;
+        report->truncated = 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TRAJ_SCAN_H
+#define TRAJ_SCAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "traj_index.h"
+
+/*! @brief Report about the frames of a trajectory file obtained by reading only the headers of the frames.
+ *
+ * @paragraph Details
+ * Frame numbers are zero-based. Members holding a frame number or a byte offset are set to -1
+ * if the corresponding event did not occur. Time members are only meaningful if n_frames is non-zero,
+ * 'dt' only if n_frames is larger than one.
+ */
+typedef struct traj_scan {
+    size_t n_frames;            /* number of valid frames */
+    int n_atoms;                /* number of atoms in the first frame */
+    float first_time;           /* time of the first frame in ps */
+    float last_time;            /* time of the last valid frame in ps */
+    float dt;                   /* time difference between the first two frames in ps */
+    size_t n_dt_irregular;      /* number of frames whose time difference to the previous frame is not dt */
+    int64_t first_dt_irregular; /* first frame whose time difference to the previous frame is not dt */
+    size_t n_natoms_changes;    /* number of frames with a different number of atoms than the previous frame */
+    int64_t first_natoms_change;/* first frame with a different number of atoms than the previous frame */
+    int64_t file_size;          /* size of the scanned file in bytes */
+    int64_t valid_size;         /* position right after the last valid frame */
+    int64_t corrupt_offset;     /* position of the first corrupted or truncated frame */
+    int truncated;              /* set if the file has been truncated to valid_size */
+} traj_scan_t;
+
+
+/*! @brief Scans a trajectory file by reading only the headers of its frames.
+ *
+ * @paragraph Details
+ * Frames are skipped using the provided skip function, so no coordinates are decompressed or decoded.
+ * Scanning stops at the end of the file or at the first frame whose header cannot be read or which
+ * extends beyond the end of the file. The position of such a frame is stored in report->corrupt_offset.
+ * Note that damage inside the compressed coordinates of an xtc frame cannot be detected without
+ * decompressing the frame; only damage that breaks the chain of frame headers is reported.
+ *
+ * Time difference between two frames is considered irregular if it differs from the time difference
+ * between the first two frames by more than 0.1 % (plus the resolution of the float time values).
+ *
+ * If 'repair' is non-zero and a corrupted or truncated frame is found, the file is truncated
+ * to report->valid_size, i.e. all data starting at the corrupted frame are removed.
+ *
+ * @param trajectory    path to the trajectory file
+ * @param skip          function reading the header of a frame and skipping the rest of it
+ * @param repair        truncate the file to the last valid frame
+ * @param report        pointer to a structure in which the report will be stored
+ *
+ * @return Zero if the file has been scanned (and truncated, if requested), else non-zero.
+ * Note that zero is also returned if the file contains corrupted frames.
+ */
+int traj_scan(const char *trajectory, traj_skip_t skip, int repair, traj_scan_t *report);
+
+#endif /* TRAJ_SCAN_H */
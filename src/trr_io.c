@@ -2,40 +2,30 @@
 // Copyright (c) 2022 Ladislav Bartos
 
 #include "trr_io.h"
+#include "traj_reader.h"
 
 int read_trr_step(XDRFILE *trr, system_t *system)
 {
-    float box[3][3] = {0};
+    // this allocates the frame buffers for every call; use traj_reader_t directly to avoid that
+    traj_reader_t *reader = traj_reader_create(trr, system, traj_trr);
+    if (reader == NULL) return 1;
 
-    // allocate memory for a arrays of coordinates, velocities and forces
-    // these are 2D arrays of [n_atoms][3] floats
-    vec_t *coordinates = calloc(system->n_atoms, sizeof(vec_t));
-    vec_t *velocities  = calloc(system->n_atoms, sizeof(vec_t));
-    vec_t *forces      = calloc(system->n_atoms, sizeof(vec_t));
+    int return_code = traj_reader_read(reader);
 
-    // read trr step using the xdrfile library
-    if (read_trr(trr, system->n_atoms, &(system->step), &(system->time), &(system->lambda), box, coordinates, velocities, forces) != 0) {
-        free(coordinates);
-        free(velocities);
-        free(forces);
-        return 1;
-    }
-
-    // despite its name, this function also converts box dimensions from trr format to native groan format
-    box_xtc2gro(box, system->box);
+    traj_reader_destroy(reader);
+    return return_code;
+}
 
-    // update the system
-    for (size_t i = 0; i < system->n_atoms; ++i) {
-        memcpy(system->atoms[i].position, coordinates[i], 3 * sizeof(float));
-        memcpy(system->atoms[i].velocity, velocities[i],  3 * sizeof(float));
-        memcpy(system->atoms[i].force,    forces[i],      3 * sizeof(float));
-    }
+int read_trr_step_fields(XDRFILE *trr, system_t *system, int fields)
+{
+    traj_reader_t *reader = traj_reader_create(trr, system, traj_trr);
+    if (reader == NULL) return 1;
 
-    free(coordinates);
-    free(velocities);
-    free(forces);
+    reader->fields = fields;
+    int return_code = traj_reader_read(reader);
 
-    return 0;
+    traj_reader_destroy(reader);
+    return return_code;
 }
 
 int write_trr_step(XDRFILE *trr, const atom_selection_t *selection, int step, float time, box_t box, float lambda)
@@ -70,6 +60,35 @@ int write_trr_step(XDRFILE *trr, const atom_selection_t *selection, int step, fl
     return 0;
 }
 
+traj_index_t *build_trr_index(XDRFILE *trr)
+{
+    traj_index_t *index = traj_index_create();
+    if (index == NULL) return NULL;
+
+    if (traj_index_extend(index, trr, skip_trr) != 0) {
+        traj_index_destroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+traj_index_t *load_trr_index(const char *filename)
+{
+    return traj_index_obtain(filename, skip_trr);
+}
+
+int seek_trr_frame(XDRFILE *trr, const traj_index_t *index, size_t frame)
+{
+    if (frame >= index->n_frames) return 1;
+
+    return xdr_seek(trr, index->frames[frame].offset, SEEK_SET) != exdrOK;
+}
+
+int scan_trr(const char *filename, int repair, traj_scan_t *report)
+{
+    return traj_scan(filename, skip_trr, repair, report);
+}
 
 int validate_trr(const char *filename, const int n_atoms)
 {
@@ -36,6 +36,27 @@
 int read_trr_step(XDRFILE *trr, system_t *system);
 
 
+/*! @brief Reads a single step from an open trr file and updates only the selected properties of the atoms.
+ *
+ * @paragraph Details
+ * Works like read_trr_step(), but only the blocks of the trr frame flagged in 'fields'
+ * (any combination of TRR_X, TRR_V and TRR_F) are read. The other blocks are skipped without being
+ * decoded and the corresponding properties of the atoms are not changed. Box, step, time and lambda
+ * of the system are always updated. Selected properties missing from the trr frame are set to zero.
+ *
+ * For instance, use TRR_V to only read the velocities of atoms.
+ * When reading many frames, use traj_reader_t and set its 'fields' member instead.
+ *
+ * @param trr           open XDRFILE structure corresponding to target trr file
+ * @param system        pointer to a structure containing information about the system
+ * @param fields        blocks of the trr frame to read
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int read_trr_step_fields(XDRFILE *trr, system_t *system, int fields);
+
+
 /*! @brief Writes the current positions, velocities, and forces of the selected atoms to trr file.
  * 
  * @param trr           open XDRFILE structure corresponding to target trr file
@@ -50,6 +71,66 @@ int read_trr_step(XDRFILE *trr, system_t *system);
 int write_trr_step(XDRFILE *trr, const atom_selection_t *selection, int step, float time, box_t box, float lambda);
 
 
+/*! @brief Creates an index of frames of an open trr file.
+ *
+ * @paragraph Details
+ * The file is scanned by reading only the headers of the frames. All blocks of the frames are skipped
+ * using the block sizes stored in the headers, so no coordinates, velocities or forces are read.
+ * Scanning stops at the end of the file or at the first frame that is corrupted or truncated;
+ * such a frame and all frames after it are not part of the index.
+ *
+ * The position in the trr file is restored after the index is created.
+ *
+ * @param trr           open XDRFILE structure corresponding to target trr file
+ *
+ * @return Pointer to the created traj_index_t structure. NULL if the file could not be scanned.
+ */
+traj_index_t *build_trr_index(XDRFILE *trr);
+
+
+/*! @brief Gets the index of frames of a trr file, using the sidecar index file if possible.
+ *
+ * @paragraph Details
+ * Works like load_xtc_index(). The sidecar file is named like the trr file with the suffix TRAJ_INDEX_SUFFIX.
+ *
+ * @param filename      path to the trr file
+ *
+ * @return Pointer to the traj_index_t structure. NULL if the index could not be obtained.
+ */
+traj_index_t *load_trr_index(const char *filename);
+
+
+/*! @brief Moves to the specified frame of an open trr file.
+ *
+ * @paragraph Details
+ * The next call of read_trr_step() (or traj_reader_read()) will read the target frame.
+ * To move to the frame closest to a specific simulation time, use traj_index_find_time() to get the frame.
+ *
+ * @param trr           open XDRFILE structure corresponding to target trr file
+ * @param index         index of frames of the trr file (see build_trr_index())
+ * @param frame         zero-based number of the frame to move to
+ *
+ * @return Zero if successful, else non-zero.
+ * Non-zero is also returned if the frame is not part of the index.
+ */
+int seek_trr_frame(XDRFILE *trr, const traj_index_t *index, size_t frame);
+
+
+/*! @brief Checks the integrity of a trr file by reading only the headers of its frames.
+ *
+ * @paragraph Details
+ * Works like scan_xtc(). Coordinates, velocities and forces are skipped using the block sizes
+ * stored in the frame headers. See traj_scan() for more details.
+ *
+ * @param filename      path to the trr file
+ * @param repair        if non-zero, truncate the file to the last valid frame
+ * @param report        pointer to a structure in which the report will be stored
+ *
+ * @return Zero if the file has been scanned (and truncated, if requested), else non-zero.
+ */
+int scan_trr(const char *filename, int repair, traj_scan_t *report);
+
+
 /*! @brief Checks that the number of atoms in trr file matches the provided number.
  * 
  * @param filename      path to the trr file
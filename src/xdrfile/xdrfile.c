@@ -27,6 +27,12 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* 64-bit file offsets and fseeko/ftello must be requested before any system header */
+#define _FILE_OFFSET_BITS  64
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 /* Get HAVE_RPC_XDR_H, F77_FUNC from config.h if available */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -38,7 +44,14 @@
 #include <math.h>
 #include <limits.h>
 
-#define _FILE_OFFSET_BITS  64
+/* Files opened for reading are memory-mapped on systems which support it */
+#if (defined __unix__ || defined __APPLE__) && !defined HAVE_RPC_XDR_H
+#  define XDRFILE_MMAP
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
 
 /* get fixed-width types if we are using ANSI C99 */
 #ifdef HAVE_STDINT_H
@@ -145,6 +158,7 @@ static int  xdr_double      (XDR *xdrs, double *ip);
 static int  xdr_string      (XDR *xdrs, char **ip, unsigned int maxsize);
 static int  xdr_opaque      (XDR *xdrs, char *cp, unsigned int cnt);
 static void xdrstdio_create (XDR *xdrs, FILE *fp, enum xdr_op xop);
+static void xdrmem_create   (XDR *xdrs, XDRFILE *xfp, enum xdr_op xop);
 
 #define xdr_getpos(xdrs)                                \
         (*(xdrs)->x_ops->x_getpostn)(xdrs)
@@ -177,6 +191,12 @@ struct XDRFILE
     int      buf1size; /**< Current allocated length of buf1          */    
     int *    buf2;     /**< Buffer for internal use                   */
     int      buf2size; /**< Current allocated length of buf2          */ 
+    char *   mem;      /**< Data of in-memory files, NULL for stdio   */
+    int64_t  memsize;  /**< Size of the in-memory data in bytes       */
+    int64_t  mempos;   /**< Current position in the in-memory data    */
+    int      mapped;   /**< Non-zero if mem is a mapping of the file  */
+    int64_t  advstart; /**< Start of the mapped range advised for readahead */
+    int64_t  advend;   /**< End of the mapped range advised for readahead   */
 };
 
 
@@ -188,6 +208,95 @@ struct XDRFILE
  * called from C - see further down for Fortran77 wrappers.  *
  *************************************************************/
 
+#ifdef XDRFILE_MMAP
+/* Size of the part of a mapped file ahead of the read position for which
+ * readahead is requested. Only this window is advised, so that opening a
+ * huge trajectory (e.g. just to read a frame header) does not read it all.
+ */
+#define XDRFILE_MMAP_READAHEAD ((int64_t) 8 << 20)
+
+/* Request readahead of the window following the current position of a
+ * mapped file before len bytes of frame data are read. The window is
+ * advanced once the reads get within half a window of its end. Reading of
+ * headers does not call this, so scanning the headers of the frames does
+ * not read the coordinates.
+ */
+static void
+xdrfile_mmap_readahead(XDRFILE *xfp, int64_t len)
+{
+	int64_t start, end;
+	long pagesize;
+
+	if (!xfp->mapped || xfp->mempos < 0 || xfp->mempos >= xfp->memsize)
+		return;
+	if (xfp->mempos >= xfp->advstart && 
+		xfp->mempos + len + XDRFILE_MMAP_READAHEAD / 2 <= xfp->advend)
+		return;
+
+	/* continue the advised range if the reads are sequential, else start a new one */
+	if (xfp->mempos >= xfp->advstart && xfp->mempos <= xfp->advend)
+		start = xfp->advend;
+	else
+		start = xfp->advstart = xfp->mempos;
+	end = xfp->mempos + len + XDRFILE_MMAP_READAHEAD;
+	if (end > xfp->memsize)
+		end = xfp->memsize;
+	xfp->advend = end;
+	if (start >= end)
+		return;
+
+	/* the advised range must start at a page boundary */
+	pagesize = sysconf(_SC_PAGESIZE);
+	if (pagesize > 0)
+		start -= start % pagesize;
+	posix_madvise(xfp->mem + start, (size_t) (end - start), POSIX_MADV_WILLNEED);
+}
+
+/* Map the whole file into memory and read it through the in-memory XDR
+ * stream. This avoids copying all the data through the stdio buffers.
+ * Returns NULL if the file cannot be mapped (e.g. it is empty or it is not
+ * a regular file); the caller then falls back to stdio.
+ *
+ * The size of the mapping is fixed when the file is opened, so data
+ * appended to the file afterwards (e.g. by a running simulation) are not
+ * visible through the handle; the file must be opened again to read them.
+ */
+static XDRFILE *
+xdrfile_open_mmap(const char *path)
+{
+	struct stat info;
+	void *map;
+	XDRFILE *xfp;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 ||
+		(uint64_t) info.st_size > (uint64_t) SIZE_MAX) 
+	{
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* the mapping stays valid after the descriptor is closed */
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	/* trajectories are mostly read front to back; hints are not essential 
+	 * and readahead is only requested for a window ahead of the reads */
+	posix_madvise(map, (size_t) info.st_size, POSIX_MADV_SEQUENTIAL);
+
+	if ((xfp = xdrfile_open_buffer((char *) map, (int64_t) info.st_size)) == NULL) 
+	{
+		munmap(map, (size_t) info.st_size);
+		return NULL;
+	}
+	xfp->mapped = 1;
+	return xfp;
+}
+#endif
+
 XDRFILE *
 xdrfile_open(const char *path, const char *mode)
 {
@@ -208,6 +317,10 @@ xdrfile_open(const char *path, const char *mode)
     {
 		sprintf(newmode,"rb");
 		xdrmode = XDR_DECODE;
+#ifdef XDRFILE_MMAP
+		if ((xfp = xdrfile_open_mmap(path)) != NULL)
+			return xfp;
+#endif
 	} else /* cannot determine mode */
 		return NULL;
   
@@ -228,7 +341,78 @@ xdrfile_open(const char *path, const char *mode)
 	xdrstdio_create((XDR *)(xfp->xdr),xfp->fp,xdrmode);
 	xfp->buf1 = xfp->buf2 = NULL;
 	xfp->buf1size = xfp->buf2size = 0;
+	xfp->mem = NULL;
+	xfp->memsize = xfp->mempos = 0;
+	xfp->mapped = 0;
+	xfp->advstart = xfp->advend = 0;
+	return xfp;
+}
+
+XDRFILE *
+xdrfile_open_buffer(char *data, int64_t size)
+{
+#ifdef HAVE_RPC_XDR_H
+	/* the system XDR library is only used with stdio streams */
+	return NULL;
+#else
+	XDRFILE *xfp;
+
+	if((xfp=(XDRFILE *)malloc(sizeof(XDRFILE)))==NULL)
+		return NULL;
+	if((xfp->xdr=(XDR *)malloc(sizeof(XDR)))==NULL) 
+    {
+		free(xfp);
+		return NULL;
+	}
+	xfp->fp=NULL;
+	xfp->mode='r';
+	xfp->buf1 = xfp->buf2 = NULL;
+	xfp->buf1size = xfp->buf2size = 0;
+	xfp->mem = data;
+	xfp->memsize = size;
+	xfp->mempos = 0;
+	xfp->mapped = 0;
+	xfp->advstart = xfp->advend = 0;
+	xdrmem_create((XDR *)(xfp->xdr),xfp,XDR_DECODE);
 	return xfp;
+#endif
+}
+
+XDRFILE *
+xdrfile_open_output_buffer(void)
+{
+#ifdef HAVE_RPC_XDR_H
+	return NULL;
+#else
+	XDRFILE *xfp;
+
+	if((xfp=xdrfile_open_buffer(NULL,0))==NULL)
+		return NULL;
+	/* the data are owned by the handle and grow as they are written */
+	xfp->mode='w';
+	xfp->xdr->x_op=XDR_ENCODE;
+	return xfp;
+#endif
+}
+
+char *
+xdrfile_output_data(XDRFILE *xfp, int64_t *size)
+{
+	if(xfp==NULL || xfp->fp!=NULL || xfp->mode!='w')
+		return NULL;
+	*size = xfp->mempos;
+	return xfp->mem;
+}
+
+int
+xdrfile_reset_buffer(XDRFILE *xfp, char *data, int64_t size)
+{
+	if(xfp==NULL || xfp->fp!=NULL || xfp->mapped || xfp->mode=='w')
+		return exdrNR;
+	xfp->mem = data;
+	xfp->memsize = size;
+	xfp->mempos = 0;
+	return exdrOK;
 }
 
 int 
@@ -241,8 +425,14 @@ xdrfile_close(XDRFILE *xfp)
 		if(xfp->xdr)
 			xdr_destroy((XDR *)(xfp->xdr));
 		free(xfp->xdr);
-		/* close the file */
-		ret=fclose(xfp->fp);
+		/* close the file; in-memory data is owned by the caller unless written by the handle */
+		ret=(xfp->fp!=NULL) ? fclose(xfp->fp) : 0;
+#ifdef XDRFILE_MMAP
+		if(xfp->mapped)
+			ret=munmap(xfp->mem,(size_t) xfp->memsize);
+#endif
+		if(xfp->fp==NULL && xfp->mode=='w')
+			free(xfp->mem);
 		if(xfp->buf1size)
 			free(xfp->buf1);
 		if(xfp->buf2size)
@@ -254,6 +444,43 @@ xdrfile_close(XDRFILE *xfp)
 
 
 
+int64_t
+xdr_tell(XDRFILE *xfp)
+{
+	if (xfp == NULL)
+		return -1;
+	if (xfp->fp == NULL)
+		return xfp->mempos;
+	return (int64_t) ftello(xfp->fp);
+}
+
+int
+xdr_seek(XDRFILE *xfp, int64_t pos, int whence)
+{
+	if (xfp == NULL)
+		return exdrNR;
+	if (xfp->fp == NULL) 
+	{
+		if (whence == SEEK_CUR)
+			pos += xfp->mempos;
+		else if (whence == SEEK_END)
+			pos += xfp->memsize;
+		if (pos < 0)
+			return exdrNR;
+		/* like for stdio, seeking past the end only makes the next read fail */
+		xfp->mempos = pos;
+		return exdrOK;
+	}
+	/* flush pending output before moving around in a file open for writing */
+	if (xfp->mode != 'r' && xfp->mode != 'R')
+		fflush(xfp->fp);
+	if (fseeko(xfp->fp, (off_t) pos, whence) != 0)
+		return exdrNR;
+	return exdrOK;
+}
+
+
+
 int 
 xdrfile_read_int(int *ptr, int ndata, XDRFILE* xfp) 
 {
@@ -396,10 +623,102 @@ xdrfile_write_ushort(unsigned short *ptr, int ndata, XDRFILE* xfp)
 	return i;
 }
 
+/*
+ * Arrays of floats and doubles are read in bulk when the in-memory layout
+ * of the values is IEEE with a known byte order: the raw bytes are copied
+ * from the file (or from the mapped data) directly into the output array
+ * and byte-swapped in place, instead of decoding one value per call.
+ */
+#if !defined(HAVE_RPC_XDR_H) && defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+	(!defined(__FLOAT_WORD_ORDER__) || __FLOAT_WORD_ORDER__ == __BYTE_ORDER__)
+#  if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#    define XDR_BULK_ARRAYS 1
+#    define XDR_BULK_SWAP 1
+#  elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#    define XDR_BULK_ARRAYS 1
+#    define XDR_BULK_SWAP 0
+#  endif
+#endif
+
+#ifdef XDR_BULK_ARRAYS
+/* Copies up to ndata values of the given size from the stream into ptr.
+ * Returns the number of complete values copied. */
+static int
+xdrfile_get_array(XDRFILE *xfp, void *ptr, size_t size, int ndata)
+{
+	int64_t available;
+
+	if (ndata <= 0)
+		return 0;
+	if (xfp->fp != NULL)
+		return (int) fread(ptr, size, (size_t) ndata, xfp->fp);
+
+#ifdef XDRFILE_MMAP
+	xdrfile_mmap_readahead(xfp, (int64_t) ndata * (int64_t) size);
+#endif
+	available = xfp->mempos < 0 || xfp->mempos > xfp->memsize ? 0 :
+		(xfp->memsize - xfp->mempos) / (int64_t) size;
+	if (available < ndata)
+		ndata = (int) available;
+	memcpy(ptr, xfp->mem + xfp->mempos, (size_t) ndata * size);
+	xfp->mempos += (int64_t) ndata * (int64_t) size;
+	return ndata;
+}
+
+/* Byte-swap loops written so that the compiler can vectorize them. */
+static void
+xdr_bswap32_array(void *data, int ndata)
+{
+#if XDR_BULK_SWAP
+	unsigned char *p = (unsigned char *) data;
+	uint32_t word;
+	int i;
+
+	for (i = 0; i < ndata; i++) 
+	{
+		memcpy(&word, p + 4 * (size_t) i, 4);
+		word = __builtin_bswap32(word);
+		memcpy(p + 4 * (size_t) i, &word, 4);
+	}
+#else
+	(void) data;
+	(void) ndata;
+#endif
+}
+
+static void
+xdr_bswap64_array(void *data, int ndata)
+{
+#if XDR_BULK_SWAP
+	unsigned char *p = (unsigned char *) data;
+	uint64_t word;
+	int i;
+
+	for (i = 0; i < ndata; i++) 
+	{
+		memcpy(&word, p + 8 * (size_t) i, 8);
+		word = __builtin_bswap64(word);
+		memcpy(p + 8 * (size_t) i, &word, 8);
+	}
+#else
+	(void) data;
+	(void) ndata;
+#endif
+}
+#endif
+
 int 
 xdrfile_read_float(float *ptr, int ndata, XDRFILE* xfp) 
 {
 	int i=0;
+#ifdef XDR_BULK_ARRAYS
+	if (((XDR *)(xfp->xdr))->x_op == XDR_DECODE && sizeof(float) == 4) 
+	{
+		i = xdrfile_get_array(xfp, ptr, sizeof(float), ndata);
+		xdr_bswap32_array(ptr, i);
+		return i;
+	}
+#endif
 	/* read write is encoded in the XDR struct */
 	while(i<ndata && xdr_float((XDR *)(xfp->xdr),ptr+i))
 		i++;
@@ -420,6 +739,14 @@ int
 xdrfile_read_double(double *ptr, int ndata, XDRFILE* xfp) 
 {
 	int i=0;
+#ifdef XDR_BULK_ARRAYS
+	if (((XDR *)(xfp->xdr))->x_op == XDR_DECODE && sizeof(double) == 8) 
+	{
+		i = xdrfile_get_array(xfp, ptr, sizeof(double), ndata);
+		xdr_bswap64_array(ptr, i);
+		return i;
+	}
+#endif
 	/* read write is encoded in the XDR struct */
 	while(i<ndata && xdr_double((XDR *)(xfp->xdr),ptr+i))
 		i++;
@@ -667,65 +994,292 @@ encodeints(int buf[], int num_of_ints, int num_of_bits,
 }
 
 
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 xdr_uint128;
+#endif
+
 /*
- * decodebits - decode number from buf using specified number of bits
- * 
- * extract the number of bits from the array buf and construct an integer
- * from it. Return that value.
+ * Writer of the compressed bit stream of xtc coordinates.
  *
+ * Produces exactly the same bytes as encodebits(), but keeps the pending
+ * bits in a 64-bit cache and stores them four bytes at a time instead of
+ * one byte per call. At most 32 bits are written at once.
  */
+typedef struct
+{
+	unsigned char *data;  /* start of the compressed data */
+	unsigned int count;   /* number of complete bytes stored */
+	uint64_t cache;       /* pending bits in the lowest nbits bits */
+	int nbits;            /* number of pending bits (less than 32) */
+} xdr_bitwriter;
+
+static inline uint32_t
+xdr_bswap32(uint32_t value)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap32(value);
+#else
+	return (value >> 24) | ((value >> 8) & 0xff00) |
+		((value << 8) & 0xff0000) | (value << 24);
+#endif
+}
 
-static int 
-decodebits(int buf[], int num_of_bits) 
+/*
+ * writebits - append the lowest num_of_bits bits of num to the bit stream
+ *
+ * num must fit into num_of_bits bits and num_of_bits must be at most 32.
+ */
+static inline void
+writebits(xdr_bitwriter *bw, int num_of_bits, unsigned int num)
 {
+	uint32_t word;
 
-    int cnt, num; 
-    unsigned int lastbits, lastbyte;
-    unsigned char * cbuf;
-    int mask = (1 << num_of_bits) -1;
+	if (num_of_bits <= 0)
+		return;
+	bw->cache = (bw->cache << num_of_bits) | num;
+	bw->nbits += num_of_bits;
+	if (bw->nbits >= 32)
+	{
+		bw->nbits -= 32;
+		word = (uint32_t)(bw->cache >> bw->nbits);
+		bw->data[bw->count++] = (unsigned char)(word >> 24);
+		bw->data[bw->count++] = (unsigned char)(word >> 16);
+		bw->data[bw->count++] = (unsigned char)(word >> 8);
+		bw->data[bw->count++] = (unsigned char)word;
+	}
+}
 
-    cbuf = ((unsigned char *)buf) + 3 * sizeof(*buf);
-    cnt = buf[0];
-    lastbits = (unsigned int) buf[1];
-    lastbyte = (unsigned int) buf[2];
-    
-    num = 0;
-    while (num_of_bits >= 8)
-    {
-		lastbyte = ( lastbyte << 8 ) | cbuf[cnt++];
-		num |=  (lastbyte >> lastbits) << (num_of_bits - 8);
-		num_of_bits -=8;
-    }
-    if (num_of_bits > 0) 
-    {
-		if (lastbits < num_of_bits) 
-        {
-			lastbits += 8;
-			lastbyte = (lastbyte << 8) | cbuf[cnt++];
+/*
+ * writebits_finish - store the pending bits of the bit stream
+ *
+ * The last incomplete byte is padded with zero bits.
+ * Returns the total number of bytes of the bit stream.
+ */
+static unsigned int
+writebits_finish(xdr_bitwriter *bw)
+{
+	while (bw->nbits >= 8)
+	{
+		bw->nbits -= 8;
+		bw->data[bw->count++] = (unsigned char)(bw->cache >> bw->nbits);
+	}
+	if (bw->nbits > 0)
+	{
+		bw->data[bw->count++] = (unsigned char)(bw->cache << (8 - bw->nbits));
+		bw->nbits = 0;
+	}
+	return bw->count;
+}
+
+/*
+ * writebytes - write a packed integer in the byte order used by encodeints()
+ *
+ * The packed integer (lo + 2^64 * hi) is written least significant byte
+ * first; all bytes except the last one use 8 bits, the last one uses the
+ * remaining bits. Up to four bytes are written by a single writebits().
+ */
+static inline void
+writebytes(xdr_bitwriter *bw, uint64_t lo, uint64_t hi, int num_of_bits)
+{
+	int full = (num_of_bits - 1) / 8;
+
+	while (full >= 4)
+	{
+		writebits(bw, 32, xdr_bswap32((uint32_t)lo));
+		lo = (lo >> 32) | (hi << 32);
+		hi >>= 32;
+		full -= 4;
+		num_of_bits -= 32;
+	}
+	if (full > 0)
+	{
+		writebits(bw, 8 * full, xdr_bswap32((uint32_t)lo) >> (32 - 8 * full));
+		lo = (lo >> (8 * full)) | (hi << (64 - 8 * full));
+		num_of_bits -= 8 * full;
+	}
+	writebits(bw, num_of_bits, (unsigned int)lo);
+}
+
+/*
+ * writeints_generic - write 'small' integers of any total bit size
+ *
+ * Byte-wise multiplication as in encodeints(). Used only for packed integers
+ * which do not fit into the native integer types.
+ */
+static void
+writeints_generic(xdr_bitwriter *bw, int num_of_bits,
+				  unsigned int sizes[], unsigned int nums[])
+{
+	unsigned int bytes[32], num_of_bytes, bytecnt, tmp;
+	int i;
+
+	tmp = nums[0];
+	num_of_bytes = 0;
+	do
+	{
+		bytes[num_of_bytes++] = tmp & 0xff;
+		tmp >>= 8;
+	} while (tmp != 0);
+
+	for (i = 1; i < 3; i++)
+	{
+		tmp = nums[i];
+		for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++)
+		{
+			tmp = bytes[bytecnt] * sizes[i] + tmp;
+			bytes[bytecnt] = tmp & 0xff;
+			tmp >>= 8;
 		}
-		lastbits -= num_of_bits;
-		num |= (lastbyte >> lastbits) & ((1 << num_of_bits) -1);
-    }
-    num &= mask;
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    return num; 
+		while (tmp != 0)
+		{
+			bytes[bytecnt++] = tmp & 0xff;
+			tmp >>= 8;
+		}
+		num_of_bytes = bytecnt;
+	}
+	for (i = 0; num_of_bits > 8; i++)
+	{
+		writebits(bw, 8, i < (int)num_of_bytes ? bytes[i] : 0);
+		num_of_bits -= 8;
+	}
+	writebits(bw, num_of_bits, i < (int)num_of_bytes ? bytes[i] : 0);
 }
 
 /*
- * decodeints - decode 'small' integers from the buf array
+ * writeints - write three 'small' integers to the bit stream
  *
- * this routine is the inverse from encodeints() and decodes the small integers
- * written to buf by calculating the remainder and doing divisions with
- * the given sizes[]. You need to specify the total number of bits to be
- * used from buf in num_of_bits.
+ * Produces exactly the same bits as encodeints() with num_of_ints = 3.
+ * The integers are packed using native multiplication when the packed
+ * integer has at most 64 bits (or 128 bits if the compiler supports
+ * 128-bit integers).
+ */
+static inline void
+writeints(xdr_bitwriter *bw, int num_of_bits,
+		  unsigned int sizes[], unsigned int nums[])
+{
+	if (nums[1] >= sizes[1] || nums[2] >= sizes[2])
+	{
+		fprintf(stderr,"major breakdown in encodeints - num %u doesn't "
+				"match size %u\n", nums[1] >= sizes[1] ? nums[1] : nums[2],
+				nums[1] >= sizes[1] ? sizes[1] : sizes[2]);
+		abort();
+	}
+	if (num_of_bits <= 64)
+	{
+		uint64_t value = ((uint64_t)nums[0] * sizes[1] + nums[1]) * sizes[2] + nums[2];
+		writebytes(bw, value, 0, num_of_bits);
+		return;
+	}
+#if defined(__SIZEOF_INT128__)
+	if (num_of_bits <= 128)
+	{
+		xdr_uint128 value = ((xdr_uint128)nums[0] * sizes[1] + nums[1]) * sizes[2] + nums[2];
+		writebytes(bw, (uint64_t)value, (uint64_t)(value >> 64), num_of_bits);
+		return;
+	}
+#endif
+	writeints_generic(bw, num_of_bits, sizes, nums);
+}
+
+
+/*
+ * Reader of the compressed bit stream of xtc coordinates.
+ *
+ * Bits are stored most significant first. Instead of pulling the bits
+ * out of the stream one byte at a time, every read does one unaligned
+ * big-endian 64-bit load at the current byte position and extracts the
+ * requested bits using shifts. At most 32 bits are read at once, so the
+ * loaded word always contains all of them. The stream must be followed
+ * by XDR_BITREADER_SLACK readable bytes.
+ */
+typedef struct
+{
+	const unsigned char *data; /* start of the compressed data */
+	uint64_t bitpos;           /* number of bits already read */
+} xdr_bitreader;
+
+/* Number of zeroed bytes after the compressed data. This covers the 64-bit
+ * loads near the end of the data and everything a single coordinate triplet
+ * with the longest possible run can read past a corrupted stream before
+ * the bounds check in the decompression loop catches it. */
+#define XDR_BITREADER_SLACK 128
+
+static inline uint64_t
+xdr_load_be64(const unsigned char *p)
+{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return __builtin_bswap64(word);
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+#else
+	return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+		((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+		((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+		((uint64_t)p[6] << 8) | (uint64_t)p[7];
+#endif
+}
+
+/*
+ * decodebits - decode number from the bit stream using specified number of bits
+ * 
+ * extract the number of bits (at most 32) from the stream and construct
+ * an integer from it. Return that value.
  *
  */
 
+static inline int 
+decodebits(xdr_bitreader *br, int num_of_bits) 
+{
+	uint64_t word;
+
+	if (num_of_bits <= 0)
+		return 0;
+	/* bitpos & 7 <= 7, so at least 57 valid bits remain after the shift */
+	word = xdr_load_be64(br->data + (br->bitpos >> 3)) << (br->bitpos & 7);
+	br->bitpos += num_of_bits;
+	return (int)(unsigned int)(word >> (64 - num_of_bits));
+}
+
+/*
+ * decodebytes - read a packed integer of at most 64 bits from the bit stream
+ *
+ * encodeints() writes the packed integer as a sequence of bytes, least
+ * significant byte first, with the last (most significant) byte using
+ * only the remaining bits. This routine reads the bytes in the same way
+ * and assembles them into a native integer.
+ */
+static inline uint64_t
+decodebytes(xdr_bitreader *br, int num_of_bits)
+{
+	uint64_t value = 0;
+	int shift = 0;
+
+	while (num_of_bits > 8)
+	{
+		value |= (uint64_t)(unsigned int)decodebits(br, 8) << shift;
+		shift += 8;
+		num_of_bits -= 8;
+	}
+	if (num_of_bits > 0)
+	{
+		value |= (uint64_t)(unsigned int)decodebits(br, num_of_bits) << shift;
+	}
+	return value;
+}
+
+/*
+ * decodeints_generic - decode 'small' integers of any total bit size
+ *
+ * Byte-wise long division over the packed integer. Used only for packed
+ * integers which do not fit into the native integer types.
+ */
 static void 
-decodeints(int buf[], int num_of_ints, int num_of_bits,
-		   unsigned int sizes[], int nums[])
+decodeints_generic(xdr_bitreader *br, int num_of_ints, int num_of_bits,
+				   unsigned int sizes[], int nums[])
 {
 
 	int bytes[32];
@@ -735,12 +1289,12 @@ decodeints(int buf[], int num_of_ints, int num_of_bits,
 	num_of_bytes = 0;
 	while (num_of_bits > 8)
     {
-		bytes[num_of_bytes++] = decodebits(buf, 8);
+		bytes[num_of_bytes++] = decodebits(br, 8);
 		num_of_bits -= 8;
 	}
 	if (num_of_bits > 0)
     {
-		bytes[num_of_bytes++] = decodebits(buf, num_of_bits);
+		bytes[num_of_bytes++] = decodebits(br, num_of_bits);
 	}
 	for (i = num_of_ints-1; i > 0; i--) 
     {
@@ -754,10 +1308,166 @@ decodeints(int buf[], int num_of_ints, int num_of_bits,
 		}
 		nums[i] = num;
 	}
-	nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+	/* assembled as unsigned so that quotients above INT_MAX do not overflow */
+	nums[0] = (int)((unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+		((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24));
+}
+
+/*
+ * decodeints - decode 'small' integers from the bit stream
+ *
+ * this routine is the inverse from encodeints() and decodes the small integers
+ * written to buf by calculating the remainder and doing divisions with
+ * the given sizes[]. You need to specify the total number of bits to be
+ * used from buf in num_of_bits.
+ *
+ * The packed integer is at most 72 bits long for all valid xtc frames.
+ * Packed integers of up to 64 bits (and up to 128 bits if the compiler
+ * supports 128-bit integers) are divided using native division instead
+ * of the byte-wise long division. The results are identical.
+ */
+
+static void 
+decodeints(xdr_bitreader *br, int num_of_ints, int num_of_bits,
+		   unsigned int sizes[], int nums[])
+{
+	int i;
+
+	if (num_of_bits <= 64)
+	{
+		uint64_t value = decodebytes(br, num_of_bits);
+		for (i = num_of_ints-1; i > 0; i--)
+		{
+			nums[i] = (int)(value % sizes[i]);
+			value /= sizes[i];
+		}
+		nums[0] = (int)(unsigned int)value;
+		return;
+	}
+#if defined(__SIZEOF_INT128__)
+	if (num_of_bits <= 128)
+	{
+		xdr_uint128 value = decodebytes(br, 64);
+		value |= (xdr_uint128)decodebytes(br, num_of_bits - 64) << 64;
+		for (i = num_of_ints-1; i > 0; i--)
+		{
+			/* the quotient fits into 64 bits once the value does */
+			if ((value >> 64) == 0)
+			{
+				uint64_t low = (uint64_t)value;
+				nums[i] = (int)(low % sizes[i]);
+				value = low / sizes[i];
+			}
+			else
+			{
+				nums[i] = (int)(value % sizes[i]);
+				value /= sizes[i];
+			}
+		}
+		nums[0] = (int)(unsigned int)value;
+		return;
+	}
+#endif
+	decodeints_generic(br, num_of_ints, num_of_bits, sizes, nums);
+}
+
+#ifdef XDRFILE_TESTING
+/* Decodes a packed integer using both decodeints() and decodeints_generic().
+ * Only compiled for the unit tests (see tests/xdrfile_testing.h); it is not
+ * part of the library. */
+int
+xdrfile_decodeints_check(const unsigned char *data, int num_of_bytes, int num_of_ints,
+						 int num_of_bits, unsigned int sizes[], int nums[], int nums_generic[])
+{
+	xdr_bitreader br;
+	unsigned char *padded;
+	int i;
+
+	if (data == NULL || num_of_ints < 1 || num_of_ints > 32 || num_of_bits < 1 ||
+		num_of_bits > 256 || num_of_bytes < (num_of_bits + 7) / 8)
+		return exdrNR;
+	for (i = 0; i < num_of_ints; i++)
+	{
+		if (sizes[i] == 0 || sizes[i] > (1u << 23))
+			return exdrNR;
+	}
+
+	/* the bit reader needs zeroed slack after the data */
+	if ((padded = (unsigned char *)calloc((size_t)num_of_bytes + XDR_BITREADER_SLACK, 1)) == NULL)
+		return exdrNOMEM;
+	memcpy(padded, data, (size_t)num_of_bytes);
+
+	br.data = padded;
+	br.bitpos = 0;
+	decodeints(&br, num_of_ints, num_of_bits, sizes, nums);
+	br.bitpos = 0;
+	decodeints_generic(&br, num_of_ints, num_of_bits, sizes, nums_generic);
+
+	free(padded);
+	return exdrOK;
 }
+#endif
     
 
+/*
+ * Makes sure that the internal buffers of xfp can hold size3 integers
+ * (buf1) and the compressed data of size3 integers (buf2). Old buffers
+ * are released (they used to be leaked when a larger frame was read). Returns 0 on success, -1 if memory can not be allocated.
+ */
+static int
+xdrfile_reserve_buffers(XDRFILE *xfp, unsigned int size3)
+{
+	if (size3 <= (unsigned int)xfp->buf1size)
+		return 0;
+
+	free(xfp->buf1);
+	free(xfp->buf2);
+	xfp->buf1 = (int *)malloc(sizeof(int)*size3);
+	xfp->buf2size = size3*1.2;
+	xfp->buf2 = (int *)malloc(sizeof(int)*xfp->buf2size);
+	if (xfp->buf1 == NULL || xfp->buf2 == NULL)
+	{
+		free(xfp->buf1);
+		free(xfp->buf2);
+		xfp->buf1 = xfp->buf2 = NULL;
+		xfp->buf1size = xfp->buf2size = 0;
+		fprintf(stderr,"Cannot allocate memory for compressed coordinates.\n");
+		return -1;
+	}
+	xfp->buf1size = size3;
+	return 0;
+}
+
+/*
+ * Reads nbytes of compressed data into buf2 (after the three special
+ * integers) followed by XDR_BITREADER_SLACK zeroed bytes. buf2 is enlarged
+ * if the data does not fit. Returns 0 on success, -1 on failure.
+ */
+static int
+xdrfile_read_compressed(XDRFILE *xfp, int64_t nbytes)
+{
+	int64_t needed = 3 + (nbytes + XDR_BITREADER_SLACK + 3) / 4;
+
+	if (nbytes < 0 || needed > INT_MAX)
+		return -1;
+	if (needed > xfp->buf2size)
+	{
+		int *buf2 = (int *)malloc(sizeof(int)*needed);
+		if (buf2 == NULL)
+		{
+			fprintf(stderr,"Cannot allocate memory for decompressing coordinates.\n");
+			return -1;
+		}
+		free(xfp->buf2);
+		xfp->buf2 = buf2;
+		xfp->buf2size = (int)needed;
+	}
+	if (nbytes > 0 && xdrfile_read_opaque((char *)&(xfp->buf2[3]),(int)nbytes,xfp) == 0)
+		return -1;
+	memset((char *)&(xfp->buf2[3]) + nbytes, 0, XDR_BITREADER_SLACK);
+	return 0;
+}
+
 static const int magicints[] = 
 {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
@@ -773,24 +1483,38 @@ static const int magicints[] =
 /* note that magicints[FIRSTIDX-1] == 0 */
 #define LASTIDX (sizeof(magicints) / sizeof(*magicints))
 
+/* Upper limit on the number of bytes of compressed data needed to decode
+ * the first n coordinate triplets. Every triplet takes at most 3*32 bits plus
+ * 6 bits of run information, and a run of small triplets may have to be
+ * decoded one triplet beyond n. Some slack is added for reading ahead.
+ */
+#define PARTIAL_BYTES(n) (13 * ((int64_t)(n) + 1) + 8)
+
 /* Compressed coordinate routines - modified from the original
  * implementation by Frans v. Hoesel to make them threadsafe.
+ *
+ * If nwanted is negative, all coordinates are decompressed into ptr, which
+ * must have room for *size triplets. Otherwise only the first nwanted
+ * triplets are decompressed and the rest of the compressed data is skipped.
  */
-int
-xdrfile_decompress_coord_float(float     *ptr,
-							   int       *size,
-							   float     *precision,
-							   XDRFILE*   xfp)
+static int
+decompress_coord_float(float     *ptr,
+					   int       *size,
+					   int        nwanted,
+					   float     *precision,
+					   XDRFILE*   xfp)
 {
 	int minint[3], maxint[3], *lip;
 	int smallidx = 0;
 	unsigned sizeint[3], sizesmall[3], bitsizeint[3], size3;
-	int k, *buf1, *buf2, flag;
-	int lsize = 0;
+	int k, *buf1, flag;
+	int lsize = 0, nout, bytecnt = 0;
 	int smallnum, smaller, i, is_smaller, run;
-	float *lfp, inv_precision;
+	float *lfp, *lfp_end, inv_precision;
 	int tmp, *thiscoord,  prevcoord[3];
 	unsigned int bitsize;
+	int64_t nbytes;
+	xdr_bitreader br;
   
     bitsizeint[0] = 0;
     bitsizeint[1] = 0;
@@ -801,43 +1525,32 @@ xdrfile_decompress_coord_float(float     *ptr,
 	tmp=xdrfile_read_int(&lsize,1,xfp);
 	if(tmp==0)
 		return -1; /* return if we could not read size */
-	if (*size < lsize) 
+	if (nwanted < 0 && *size < lsize) 
     {
 		fprintf(stderr, "Requested to decompress %d coords, file contains %d\n",
 				*size, lsize);
 		return -1;
 	}
+	if (lsize < 0)
+		return -1;
 	*size = lsize;
+	nout = (nwanted < 0 || nwanted > lsize) ? lsize : nwanted;
 	size3 = *size * 3;
-	if(size3>xfp->buf1size) 
-    {
-		if((xfp->buf1=(int *)malloc(sizeof(int)*size3))==NULL) 
-        {
-			fprintf(stderr,"Cannot allocate memory for decompressing coordinates.\n");
-			return -1; 
-		}
-		xfp->buf1size=size3;
-		xfp->buf2size=size3*1.2;
-		if((xfp->buf2=(int *)malloc(sizeof(int)*xfp->buf2size))==NULL)
-        {
-			fprintf(stderr,"Cannot allocate memory for decompressing coordinates.\n");
-			return -1;
-		}
-	}
+	if (xdrfile_reserve_buffers(xfp, size3) != 0)
+		return -1;
 	/* Dont bother with compression for three atoms or less */
 	if(*size<=9) 
     {
-		return xdrfile_read_float(ptr,size3,xfp)/3;
+		tmp = xdrfile_read_float(ptr,nout*3,xfp)/3;
+		if (tmp == nout && nout < lsize &&
+			xdr_seek(xfp,(int64_t)(lsize-nout)*3*sizeof(float),SEEK_CUR) != exdrOK)
+			return -1;
+		return tmp;
 		/* return number of coords, not floats */
 	}
 	/* Compression-time if we got here. Read precision first */
 	xdrfile_read_float(precision,1,xfp);
   
-	/* avoid repeated pointer dereferencing. */
-	buf1=xfp->buf1; 
-	buf2=xfp->buf2;
-	/* buf2[0-2] are special and do not contain actual data */
-	buf2[0] = buf2[1] = buf2[2] = 0;
 	xdrfile_read_int(minint,3,xfp);
 	xdrfile_read_int(maxint,3,xfp);
   
@@ -870,32 +1583,58 @@ xdrfile_decompress_coord_float(float     *ptr,
 	sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx] ;
 	//larger = magicints[maxidx];
 
-	/* buf2[0] holds the length in bytes */
-  
-	if (xdrfile_read_int(buf2,1,xfp) == 0)
-		return 0;
-	if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
+	/* the length of the compressed data in bytes */
+	if (xdrfile_read_int(&bytecnt,1,xfp) == 0)
 		return 0;
-	buf2[0] = buf2[1] = buf2[2] = 0;
+	if (bytecnt < 0)
+		return -1;
+	nbytes = PARTIAL_BYTES(nout);
+	if (nwanted >= 0 && nbytes < bytecnt) 
+	{
+		/* only read the part of the data needed for the first nout
+		   coordinates (rounded to full xdr units) and skip the rest */
+		nbytes = (nbytes + 3) & ~(int64_t)3;
+		if (xdrfile_read_compressed(xfp,nbytes) != 0)
+			return 0;
+		if (xdr_seek(xfp,(((int64_t)bytecnt + 3) & ~(int64_t)3) - nbytes,SEEK_CUR) != exdrOK)
+			return 0;
+	}
+	else
+	{
+		nbytes = bytecnt;
+		if (xdrfile_read_compressed(xfp,nbytes) != 0)
+			return 0;
+	}
+	/* avoid repeated pointer dereferencing. */
+	buf1 = xfp->buf1;
+	br.data = (const unsigned char *)&(xfp->buf2[3]);
+	br.bitpos = 0;
   
 	lfp = ptr;
+	lfp_end = ptr + 3 * nout;
 	inv_precision = 1.0 / * precision;
 	run = 0;
 	i = 0;
 	lip = buf1;
 	while ( i < lsize ) 
     {
+		/* all requested coordinates have been decompressed */
+		if (lfp == lfp_end)
+			return nout;
+		/* corrupted data; do not read past the compressed data and its slack */
+		if ((int64_t)(br.bitpos >> 3) > nbytes)
+			return -1;
 		thiscoord = (int *)(lip) + i * 3;
     
 		if (bitsize == 0) 
         {
-			thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-			thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-			thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+			thiscoord[0] = decodebits(&br, bitsizeint[0]);
+			thiscoord[1] = decodebits(&br, bitsizeint[1]);
+			thiscoord[2] = decodebits(&br, bitsizeint[2]);
 		}
         else
         {
-			decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+			decodeints(&br, 3, bitsize, sizeint, thiscoord);
 		}
     
 		i++;
@@ -907,11 +1646,11 @@ xdrfile_decompress_coord_float(float     *ptr,
 		prevcoord[1] = thiscoord[1];
 		prevcoord[2] = thiscoord[2];
     
-		flag = decodebits(buf2, 1);
+		flag = decodebits(&br, 1);
 		is_smaller = 0;
 		if (flag == 1) 
         {
-			run = decodebits(buf2, 5);
+			run = decodebits(&br, 5);
 			is_smaller = run % 3;
 			run -= is_smaller;
 			is_smaller--;
@@ -921,7 +1660,7 @@ xdrfile_decompress_coord_float(float     *ptr,
 			thiscoord += 3;
 			for (k = 0; k < run; k+=3) 
             {
-				decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+				decodeints(&br, 3, smallidx, sizesmall, thiscoord);
 				i++;
 				thiscoord[0] += prevcoord[0] - smallnum;
 				thiscoord[1] += prevcoord[1] - smallnum;
@@ -936,6 +1675,8 @@ xdrfile_decompress_coord_float(float     *ptr,
 					prevcoord[1] = tmp;
 					tmp = thiscoord[2]; thiscoord[2] = prevcoord[2];
 					prevcoord[2] = tmp;
+					if (lfp == lfp_end)
+						return nout;
 					*lfp++ = prevcoord[0] * inv_precision;
 					*lfp++ = prevcoord[1] * inv_precision;
 					*lfp++ = prevcoord[2] * inv_precision;
@@ -944,6 +1685,8 @@ xdrfile_decompress_coord_float(float     *ptr,
 					prevcoord[1] = thiscoord[1];
 					prevcoord[2] = thiscoord[2];
 				}
+				if (lfp == lfp_end)
+					return nout;
 				*lfp++ = thiscoord[0] * inv_precision;
 				*lfp++ = thiscoord[1] * inv_precision;
 				*lfp++ = thiscoord[2] * inv_precision;
@@ -951,6 +1694,8 @@ xdrfile_decompress_coord_float(float     *ptr,
 		} 
         else
         {
+			if (lfp == lfp_end)
+				return nout;
 			*lfp++ = thiscoord[0] * inv_precision;
 			*lfp++ = thiscoord[1] * inv_precision;
 			*lfp++ = thiscoord[2] * inv_precision;		
@@ -976,7 +1721,28 @@ xdrfile_decompress_coord_float(float     *ptr,
 		}
 		sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx] ;
 	}
-	return *size;
+	return nout;
+}
+
+int
+xdrfile_decompress_coord_float(float     *ptr,
+							   int       *size,
+							   float     *precision,
+							   XDRFILE*   xfp)
+{
+	return decompress_coord_float(ptr,size,-1,precision,xfp);
+}
+
+int
+xdrfile_decompress_coord_float_partial(float     *ptr,
+									   int       *size,
+									   int        nwanted,
+									   float     *precision,
+									   XDRFILE*   xfp)
+{
+	if (nwanted < 0)
+		return -1;
+	return decompress_coord_float(ptr,size,nwanted,precision,xfp);
 }
 
 int
@@ -997,6 +1763,7 @@ xdrfile_compress_coord_float(float   *ptr,
 	unsigned int tmpcoord[30];
 	//int errval=1;
 	unsigned int bitsize;
+	xdr_bitwriter bw;
   
 	if(xfp==NULL)
 		return -1;
@@ -1006,21 +1773,8 @@ xdrfile_compress_coord_float(float   *ptr,
     bitsizeint[1] = 0;
     bitsizeint[2] = 0;
 
-	if(size3>xfp->buf1size)
-    {
-		if((xfp->buf1=(int *)malloc(sizeof(int)*size3))==NULL) 
-        {
-			fprintf(stderr,"Cannot allocate memory for compressing coordinates.\n");
-			return -1;
-		}
-		xfp->buf1size=size3;
-		xfp->buf2size=size3*1.2;
-		if((xfp->buf2=(int *)malloc(sizeof(int)*xfp->buf2size))==NULL)
-        {
-			fprintf(stderr,"Cannot allocate memory for compressing coordinates.\n");
-			return -1;
-		}
-	}
+	if (xdrfile_reserve_buffers(xfp, size3) != 0)
+		return -1;
 	if(xdrfile_write_int(&size,1,xfp)==0)
 		return -1; /* return if we could not write size */
 	/* Dont bother with compression for three atoms or less */
@@ -1038,6 +1792,10 @@ xdrfile_compress_coord_float(float   *ptr,
 	buf2=xfp->buf2;
 	/* buf2[0-2] are special and do not contain actual data */
 	buf2[0] = buf2[1] = buf2[2] = 0;
+	bw.data = (unsigned char *)&(buf2[3]);
+	bw.count = 0;
+	bw.cache = 0;
+	bw.nbits = 0;
 	minint[0] = minint[1] = minint[2] = INT_MAX;
 	maxint[0] = maxint[1] = maxint[2] = INT_MIN;
 	prevrun = -1;
@@ -1185,13 +1943,13 @@ xdrfile_compress_coord_float(float   *ptr,
 		tmpcoord[2] = thiscoord[2] - minint[2];
 		if (bitsize == 0) 
         {
-			encodebits(buf2, bitsizeint[0], tmpcoord[0]);
-			encodebits(buf2, bitsizeint[1], tmpcoord[1]);
-			encodebits(buf2, bitsizeint[2], tmpcoord[2]);
+			writebits(&bw, bitsizeint[0], tmpcoord[0]);
+			writebits(&bw, bitsizeint[1], tmpcoord[1]);
+			writebits(&bw, bitsizeint[2], tmpcoord[2]);
 		} 
         else
         {
-			encodeints(buf2, 3, bitsize, sizeint, tmpcoord);
+			writeints(&bw, bitsize, sizeint, tmpcoord);
 		}
 		prevcoord[0] = thiscoord[0];
 		prevcoord[1] = thiscoord[1];
@@ -1237,16 +1995,16 @@ xdrfile_compress_coord_float(float   *ptr,
 		if (run != prevrun || is_smaller != 0) 
         {
 			prevrun = run;
-			encodebits(buf2, 1, 1); /* flag the change in run-length */
-			encodebits(buf2, 5, run+is_smaller+1);
+			writebits(&bw, 1, 1); /* flag the change in run-length */
+			writebits(&bw, 5, run+is_smaller+1);
 		} 
         else 
         {
-			encodebits(buf2, 1, 0); /* flag the fact that runlength did not change */
+			writebits(&bw, 1, 0); /* flag the fact that runlength did not change */
 		}
 		for (k=0; k < run; k+=3) 
         {
-			encodeints(buf2, 3, smallidx, sizesmall, &tmpcoord[k]);	
+			writeints(&bw, smallidx, sizesmall, &tmpcoord[k]);	
 		}
 		if (is_smaller != 0) 
         {
@@ -1264,7 +2022,7 @@ xdrfile_compress_coord_float(float   *ptr,
 			sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
 		}   
 	}
-	if (buf2[1] != 0) buf2[0]++;
+	buf2[0] = writebits_finish(&bw);
 	xdrfile_write_int(buf2,1,xfp); /* buf2[0] holds the length in bytes */
 	tmp=xdrfile_write_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp);
 	if(tmp==(unsigned int)buf2[0])
@@ -1283,13 +2041,14 @@ xdrfile_decompress_coord_double(double     *ptr,
 	int minint[3], maxint[3], *lip;
 	int smallidx = 0;
 	unsigned sizeint[3], sizesmall[3], bitsizeint[3], size3;
-	int k, *buf1, *buf2, flag;
-	int lsize = 0;
+	int k, *buf1, flag;
+	int lsize = 0, bytecnt = 0;
 	int smallnum, smaller, i, is_smaller, run;
 	double *lfp, inv_precision;
 	float float_prec, tmpdata[30];
 	int tmp, *thiscoord,  prevcoord[3];
 	unsigned int bitsize;
+	xdr_bitreader br;
   
     bitsizeint[0] = 0;
     bitsizeint[1] = 0;
@@ -1308,26 +2067,13 @@ xdrfile_decompress_coord_double(double     *ptr,
 	}
 	*size = lsize;
 	size3 = *size * 3;
-	if(size3>xfp->buf1size) 
-    {
-		if((xfp->buf1=(int *)malloc(sizeof(int)*size3))==NULL) 
-        {
-			fprintf(stderr,"Cannot allocate memory for decompression coordinates.\n");
-			return -1; 
-		}
-		xfp->buf1size=size3;
-		xfp->buf2size=size3*1.2;
-		if((xfp->buf2=(int *)malloc(sizeof(int)*xfp->buf2size))==NULL)
-        {
-			fprintf(stderr,"Cannot allocate memory for decompressing coordinates.\n");
-			return -1;
-		}
-	}
+	if (xdrfile_reserve_buffers(xfp, size3) != 0)
+		return -1;
 	/* Dont bother with compression for three atoms or less */
 	if(*size<=9)
     {
 		tmp=xdrfile_read_float(tmpdata,size3,xfp);
-		for(i=0;i<9*3;i++)
+		for(i=0;i<(int)size3;i++)
 			ptr[i]=tmpdata[i];
 		return tmp/3;
 		/* return number of coords, not floats */
@@ -1335,11 +2081,6 @@ xdrfile_decompress_coord_double(double     *ptr,
 	/* Compression-time if we got here. Read precision first */
 	xdrfile_read_float(&float_prec,1,xfp);
 	*precision=float_prec;
-	/* avoid repeated pointer dereferencing. */
-	buf1=xfp->buf1; 
-	buf2=xfp->buf2;
-	/* buf2[0-2] are special and do not contain actual data */
-	buf2[0] = buf2[1] = buf2[2] = 0;
 	xdrfile_read_int(minint,3,xfp);
 	xdrfile_read_int(maxint,3,xfp);
   
@@ -1372,13 +2113,15 @@ xdrfile_decompress_coord_double(double     *ptr,
 	sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx] ;
 	//larger = magicints[maxidx];
 
-	/* buf2[0] holds the length in bytes */
-  
-	if (xdrfile_read_int(buf2,1,xfp) == 0)
+	/* the length of the compressed data in bytes */
+	if (xdrfile_read_int(&bytecnt,1,xfp) == 0)
 		return 0;
-	if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
+	if (bytecnt < 0 || xdrfile_read_compressed(xfp,bytecnt) != 0)
 		return 0;
-	buf2[0] = buf2[1] = buf2[2] = 0;
+	/* avoid repeated pointer dereferencing. */
+	buf1 = xfp->buf1;
+	br.data = (const unsigned char *)&(xfp->buf2[3]);
+	br.bitpos = 0;
   
 	lfp = ptr;
 	inv_precision = 1.0 / * precision;
@@ -1387,15 +2130,18 @@ xdrfile_decompress_coord_double(double     *ptr,
 	lip = buf1;
 	while ( i < lsize ) 
     {
+		/* corrupted data; do not read past the compressed data and its slack */
+		if ((br.bitpos >> 3) > (uint64_t)bytecnt)
+			return -1;
 		thiscoord = (int *)(lip) + i * 3;
     
 		if (bitsize == 0) 
         {
-			thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-			thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-			thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+			thiscoord[0] = decodebits(&br, bitsizeint[0]);
+			thiscoord[1] = decodebits(&br, bitsizeint[1]);
+			thiscoord[2] = decodebits(&br, bitsizeint[2]);
 		} else {
-			decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+			decodeints(&br, 3, bitsize, sizeint, thiscoord);
 		}
     
 		i++;
@@ -1407,11 +2153,11 @@ xdrfile_decompress_coord_double(double     *ptr,
 		prevcoord[1] = thiscoord[1];
 		prevcoord[2] = thiscoord[2];
     
-		flag = decodebits(buf2, 1);
+		flag = decodebits(&br, 1);
 		is_smaller = 0;
 		if (flag == 1) 
         {
-			run = decodebits(buf2, 5);
+			run = decodebits(&br, 5);
 			is_smaller = run % 3;
 			run -= is_smaller;
 			is_smaller--;
@@ -1421,7 +2167,7 @@ xdrfile_decompress_coord_double(double     *ptr,
 			thiscoord += 3;
 			for (k = 0; k < run; k+=3) 
             {
-				decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+				decodeints(&br, 3, smallidx, sizesmall, thiscoord);
 				i++;
 				thiscoord[0] += prevcoord[0] - smallnum;
 				thiscoord[1] += prevcoord[1] - smallnum;
@@ -1500,18 +2246,8 @@ xdrfile_compress_coord_double(double   *ptr,
 	if(xfp==NULL)
 		return -1;
 	size3=3*size;
-	if(size3>xfp->buf1size) {
-		if((xfp->buf1=(int *)malloc(sizeof(int)*size3))==NULL) {
-			fprintf(stderr,"Cannot allocate memory for compressing coordinates.\n");
-			return -1;
-		}
-		xfp->buf1size=size3;
-		xfp->buf2size=size3*1.2;
-		if((xfp->buf2=(int *)malloc(sizeof(int)*xfp->buf2size))==NULL) {
-			fprintf(stderr,"Cannot allocate memory for compressing coordinates.\n");
-			return -1;
-		}
-	}
+	if (xdrfile_reserve_buffers(xfp, size3) != 0)
+		return -1;
 	if(xdrfile_write_int(&size,1,xfp)==0)
 		return -1; /* return if we could not write size */
 	/* Dont bother with compression for three atoms or less */
@@ -2281,7 +3017,7 @@ static int
 xdr_opaque (XDR *xdrs, char *cp, unsigned int cnt)
 {
 	unsigned int rndup;
-	static char crud[BYTES_PER_XDR_UNIT];
+	char crud[BYTES_PER_XDR_UNIT]; /* not static, the routine must be thread-safe */
 
 	/*
 	 * if no data we are done
@@ -2614,5 +3350,127 @@ xdrstdio_setpos (XDR *xdrs, unsigned int pos)
 }
 
 
+static int xdrmem_getlong (XDR *, int32_t *);
+static int xdrmem_putlong (XDR *, int32_t *);
+static int xdrmem_getbytes (XDR *, char *, unsigned int);
+static int xdrmem_putbytes (XDR *, char *, unsigned int);
+static unsigned int xdrmem_getpos (XDR *);
+static int xdrmem_setpos (XDR *, unsigned int);
+
+/*
+ * Ops vector for XDR streams reading directly from memory.
+ * The data and the current position are stored in the XDRFILE.
+ */
+static const struct xdr_ops xdrmem_ops =
+	{
+		xdrmem_getlong,		/* deserialize a long int */
+		xdrmem_putlong,		/* serialize a long int */
+		xdrmem_getbytes,       	/* deserialize counted bytes */
+		xdrmem_putbytes,     	/* serialize counted bytes */
+		xdrmem_getpos,		/* get offset in the stream */
+		xdrmem_setpos,		/* set offset in the stream */
+		NULL,			/* nothing to destroy */
+	};
+
+static void
+xdrmem_create (XDR *xdrs, XDRFILE *xfp, enum xdr_op op)
+{
+	xdrs->x_op = op;
+
+	xdrs->x_ops = (struct xdr_ops *) &xdrmem_ops;
+	xdrs->x_private = (char *) xfp;
+}
+
+static int
+xdrmem_getlong (XDR *xdrs, int32_t *lp)
+{
+	XDRFILE *xfp = (XDRFILE *) xdrs->x_private;
+	int32_t mycopy;
+
+	if (xfp->mempos < 0 || xfp->memsize - xfp->mempos < 4)
+		return 0;
+	memcpy (&mycopy, xfp->mem + xfp->mempos, 4);
+	xfp->mempos += 4;
+	*lp = (int32_t) xdr_ntohl (mycopy);
+	return 1;
+}
+
+/* Makes room for len more bytes in an in-memory file open for writing. */
+static int
+xdrmem_reserve (XDRFILE *xfp, unsigned int len)
+{
+	int64_t capacity;
+	char *mem;
+
+	if (xfp->mode != 'w' || xfp->mempos < 0)
+		return 0;
+	if (xfp->memsize - xfp->mempos >= (int64_t) len)
+		return 1;
+	capacity = xfp->memsize > 0 ? 2 * xfp->memsize : 4096;
+	while (capacity - xfp->mempos < (int64_t) len)
+		capacity *= 2;
+	if ((uint64_t) capacity > (uint64_t) SIZE_MAX ||
+		(mem = (char *) realloc (xfp->mem, (size_t) capacity)) == NULL)
+		return 0;
+	xfp->mem = mem;
+	xfp->memsize = capacity;
+	return 1;
+}
+
+static int
+xdrmem_putlong (XDR *xdrs, int32_t *lp)
+{
+	XDRFILE *xfp = (XDRFILE *) xdrs->x_private;
+	int32_t mycopy = (int32_t) xdr_htonl (*lp);
+
+	/* in-memory files opened by xdrfile_open_buffer() are read-only */
+	if (!xdrmem_reserve (xfp, 4))
+		return 0;
+	memcpy (xfp->mem + xfp->mempos, &mycopy, 4);
+	xfp->mempos += 4;
+	return 1;
+}
+
+static int
+xdrmem_getbytes (XDR *xdrs, char *addr, unsigned int len)
+{
+	XDRFILE *xfp = (XDRFILE *) xdrs->x_private;
+
+#ifdef XDRFILE_MMAP
+	xdrfile_mmap_readahead (xfp, (int64_t) len);
+#endif
+	if (xfp->mempos < 0 || xfp->memsize - xfp->mempos < (int64_t) len)
+		return 0;
+	memcpy (addr, xfp->mem + xfp->mempos, len);
+	xfp->mempos += len;
+	return 1;
+}
+
+static int
+xdrmem_putbytes (XDR *xdrs, char *addr, unsigned int len)
+{
+	XDRFILE *xfp = (XDRFILE *) xdrs->x_private;
+
+	if (!xdrmem_reserve (xfp, len))
+		return 0;
+	memcpy (xfp->mem + xfp->mempos, addr, len);
+	xfp->mempos += len;
+	return 1;
+}
+
+static unsigned int
+xdrmem_getpos (XDR *xdrs)
+{
+	return (unsigned int) ((XDRFILE *) xdrs->x_private)->mempos;
+}
+
+static int
+xdrmem_setpos (XDR *xdrs, unsigned int pos)
+{
+	((XDRFILE *) xdrs->x_private)->mempos = pos;
+	return 1;
+}
+
+
 
 #endif /* HAVE_RPC_XDR_H not defined */
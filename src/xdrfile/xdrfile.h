@@ -60,10 +60,10 @@
  *    three decimals guaranteed accuracy, and reduces the filesize to 1/10th
  *    of normal binary data.
  *
- * We do not support getting or setting positions in XDR files, since it can
- * break in horrible ways for large (64-bit) files, resulting in silent data
- * corruption. Note that it works great to open/read/write 64-bit files if
- * your system supports it; it is just the random access we cannot trust!
+ * Positions in XDR files can only be queried and set using xdr_tell() and
+ * xdr_seek() which use 64-bit offsets. The 32-bit getpos/setpos routines of
+ * the XDR layer itself are not exposed, since they break in horrible ways
+ * for large (64-bit) files, resulting in silent data corruption.
  *
  * We also provide wrapper routines so this module can be used from FORTRAN -
  * see the file xdrfile_fortran.txt in the Gromacs distribution for 
@@ -74,6 +74,8 @@
 #ifndef _XDRFILE_H_
 #define _XDRFILE_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" 
 {
@@ -117,12 +119,87 @@ extern "C"
 	 *
 	 *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs.
 	 *
+	 *  On POSIX systems, files opened for reading are memory-mapped and
+	 *  decoded directly from the mapped pages. If the file cannot be mapped,
+	 *  it is read using the standard C library instead. Readahead is only
+	 *  requested for a bounded window ahead of the frame data being read.
+	 *
+	 *  The mapping covers the file as it was when it was opened. Data
+	 *  appended later (e.g. to a trajectory of a running simulation) can
+	 *  not be read through the returned handle; open the file again.
 	 */
 	XDRFILE *
 	xdrfile_open    (const char *    path, 
 					 const char *    mode);
 
 
+	/*! \brief Open a block of memory containing XDR data for reading
+	 *
+	 *  The returned handle can be used with all reading routines defined in
+	 *  this header, just like a handle created by xdrfile_open() in "r" mode.
+	 *  The memory is not copied and is still owned by the caller; it must stay
+	 *  valid until the handle is closed or reset to other data.
+	 *
+	 *  \param data  Pointer to the XDR data
+	 *  \param size  Size of the data in bytes
+	 *
+	 *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs.
+	 */
+	XDRFILE *
+	xdrfile_open_buffer(char *       data,
+						int64_t      size);
+
+
+	/*! \brief Open a growing block of memory for writing XDR data
+	 *
+	 *  The returned handle can be used with all writing routines defined in
+	 *  this header, just like a handle created by xdrfile_open() in "w" mode.
+	 *  The memory is allocated and owned by the handle and is released by
+	 *  xdrfile_close(). Use xdrfile_output_data() to get the written data and
+	 *  xdr_seek(xfp, 0, SEEK_SET) to start writing from the beginning again
+	 *  without releasing the memory.
+	 *
+	 *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs.
+	 */
+	XDRFILE *
+	xdrfile_open_output_buffer(void);
+
+
+	/*! \brief Get the data written into a handle created by xdrfile_open_output_buffer()
+	 *
+	 *  The data end at the current position of the handle. The returned pointer
+	 *  is only valid until the next write or until the handle is closed.
+	 *
+	 *  \param xfp   Handle created by xdrfile_open_output_buffer()
+	 *  \param size  Pointer to a variable in which the size of the data in bytes is stored
+	 *
+	 *  \return Pointer to the written data, or NULL if the handle is not an in-memory output handle
+	 *  (NULL is also returned if nothing has been written yet).
+	 */
+	char *
+	xdrfile_output_data(XDRFILE *    xfp,
+						int64_t *    size);
+
+
+	/*! \brief Point a handle created by xdrfile_open_buffer() to other data
+	 *
+	 *  The internal buffers of the handle (used for decompression of 
+	 *  coordinates) are kept, so decoding many blocks of data using a single
+	 *  handle does not allocate any memory once the buffers are large enough.
+	 *
+	 *  \param xfp   Handle created by xdrfile_open_buffer()
+	 *  \param data  Pointer to the XDR data
+	 *  \param size  Size of the data in bytes
+	 *
+	 *  \return exdrOK on success, exdrNR if the handle is not an in-memory handle
+	 *  created by xdrfile_open_buffer().
+	 */
+	int
+	xdrfile_reset_buffer(XDRFILE *   xfp,
+						 char *      data,
+						 int64_t     size);
+
+
 	/*! \brief Close a previously opened portable binary file, just like fclose()
 	 *
 	 *  Use this routine much like calls to the standard library function
@@ -137,6 +214,34 @@ extern "C"
 	xdrfile_close   (XDRFILE *       xfp);
 
 
+	/*! \brief Get the current position in a portable binary file, like ftello()
+	 *
+	 *  \param xfp  Pointer to an abstract XDRFILE datatype
+	 *
+	 *  \return     Offset from the start of the file in bytes, negative on error.
+	 */
+	int64_t
+	xdr_tell        (XDRFILE *       xfp);
+
+
+	/*! \brief Set the position in a portable binary file, like fseeko()
+	 *
+	 *  Offsets are 64-bit, so this also works for files larger than 2 GB.
+	 *  Note that seeking past the end of a file opened for reading succeeds,
+	 *  but the subsequent read will fail.
+	 *
+	 *  \param xfp     Pointer to an abstract XDRFILE datatype
+	 *  \param pos     Offset in bytes
+	 *  \param whence  SEEK_SET, SEEK_CUR or SEEK_END, like for fseeko()
+	 *
+	 *  \return        exdrOK on success, exdrNR on error.
+	 */
+	int
+	xdr_seek        (XDRFILE *       xfp,
+					 int64_t         pos,
+					 int             whence);
+
+
 
 
 	/*! \brief Read one or more \a char type variable(s) 
@@ -546,6 +651,36 @@ extern "C"
 
 
 
+	/*! \brief Decompress the first coordinates from XDR file to array of floats
+	 *
+	 *  Same as xdrfile_decompress_coord_float(), but only the first \a nwanted
+	 *  coordinate triplets are decompressed. Coordinates are stored sequentially,
+	 *  so decompression stops once the last wanted triplet is decoded and only
+	 *  the part of the compressed data needed for it is read. The rest of the
+	 *  compressed data is skipped using the byte count stored in the file.
+	 *
+	 *  \param ptr        Pointer to coordinates (length >= 3*nwanted)
+	 *  \param ncoord     The total number of coordinate triplets in the frame
+	 *                    is written to this variable on return.
+	 *  \param nwanted    Number of coordinate triplets to decompress.
+	 *  \param precision  The precision used in the previous compression will be
+	 *                    written to this variable on return.
+	 *  \param xfp        Handle to portably binary file
+	 *
+	 *  \return           Number of coordinate triplets decompressed, i.e. the
+	 *                    smaller of nwanted and *ncoord. If this is negative,
+	 *                    an error occured.
+	 */
+	int
+	xdrfile_decompress_coord_float_partial(float *     ptr,
+										   int *       ncoord,
+										   int         nwanted,
+										   float *     precision,
+										   XDRFILE *   xfp);
+
+
+
+
 	/*! \brief Compress coordiates in a double array to XDR file
 	 *
 	 *  This routine will perform \a lossy compression on the three-dimensional
@@ -44,6 +44,8 @@
 
 #define BUFSIZE		128
 #define GROMACS_MAGIC   1993
+/* Number of values converted at once when reading double precision vectors */
+#define CONVERT_CHUNK	1024
 
 typedef struct		/* This struct describes the order and the	*/
 /* sizes of the structs in a trjfile, sizes are given in bytes.	*/
@@ -73,6 +75,8 @@ static int nFloatSize(t_trnheader *sh,int *nflsz)
 {
     int nflsize=0;
   
+    if (sh->natoms <= 0 && !sh->box_size)
+        return exdrHEADER;
     if (sh->box_size)
         nflsize = sh->box_size/(DIM*DIM);
     else if (sh->x_size)
@@ -101,6 +105,8 @@ static int do_trnheader(XDRFILE *xd,mybool bRead,t_trnheader *sh)
   
 	if (xdrfile_read_int(&magic,1,xd) != 1)
 		return exdrINT;
+	if (bRead && magic != GROMACS_MAGIC)
+		return exdrMAGIC;
   
 	if (bRead) 
     {
@@ -172,14 +178,81 @@ static int do_trnheader(XDRFILE *xd,mybool bRead,t_trnheader *sh)
     return exdrOK;
 }
 
+/* Read or write a block of natoms single precision vectors. rvec arrays
+ * are contiguous arrays of floats, so they are read in bulk without any
+ * intermediate buffer. If x is NULL, the block is read and discarded.
+ */
+static int do_rvec_float(XDRFILE *xd,int natoms,rvec *x)
+{
+	float buf[CONVERT_CHUNK];
+	int   n,left;
+
+	if (NULL != x)
+		return (xdrfile_read_float(x[0],natoms*DIM,xd) == natoms*DIM) ? exdrOK : exdrFLOAT;
+
+	for(left=natoms*DIM; (left>0); left-=n)
+	{
+		n = (left < CONVERT_CHUNK) ? left : CONVERT_CHUNK;
+		if (xdrfile_read_float(buf,n,xd) != n)
+			return exdrFLOAT;
+	}
+	return exdrOK;
+}
+
+/* Read or write a block of natoms double precision vectors. The values are
+ * converted from/to single precision in chunks using a buffer on the stack,
+ * so no memory is allocated. If x is NULL, the block is read and discarded
+ * (or zeros are written).
+ */
+static int do_rvec_double(XDRFILE *xd,mybool bRead,int natoms,rvec *x)
+{
+	double buf[CONVERT_CHUNK];
+	float  *fx = (NULL != x) ? x[0] : NULL;
+	int    i,k,n,total=natoms*DIM;
+
+	for(k=0; (k<total); k+=n)
+	{
+		n = (total-k < CONVERT_CHUNK) ? total-k : CONVERT_CHUNK;
+		if (!bRead)
+		{
+			for(i=0; (i<n); i++)
+				buf[i] = (NULL != fx) ? fx[k+i] : 0;
+		}
+		if (xdrfile_read_double(buf,n,xd) != n)
+			return exdrDOUBLE;
+		if (bRead && NULL != fx)
+		{
+			for(i=0; (i<n); i++)
+				fx[k+i] = buf[i];
+		}
+	}
+	return exdrOK;
+}
+
+/* Skip a block of size bytes without decoding it. The last four bytes of
+ * the block are read, so that truncated frames are still detected.
+ */
+static int skip_block(XDRFILE *xd,int size)
+{
+	int last;
+
+	if (size <= 0)
+		return exdrOK;
+	if (xdr_seek(xd,(int64_t)size-4,SEEK_CUR) != exdrOK)
+		return exdrENDOFFILE;
+	if (xdrfile_read_int(&last,1,xd) != 1)
+		return exdrENDOFFILE;
+	return exdrOK;
+}
+
+/* Blocks flagged in skip (TRR_X, TRR_V, TRR_F) are skipped using a seek
+ * instead of being read. */
 static int do_htrn(XDRFILE *xd,mybool bRead,t_trnheader *sh,
-				   matrix box,rvec *x,rvec *v,rvec *f)
+				   matrix box,rvec *x,rvec *v,rvec *f,int skip)
 {
 	double pvd[DIM*DIM];
-	double *dx=NULL;
 	float  pvf[DIM*DIM];
-	float  *fx=NULL;
-	int    i,j;
+	int    i,j,result;
 	
 	if (sh->bDouble) 
 	{
@@ -219,90 +292,15 @@ static int do_htrn(XDRFILE *xd,mybool bRead,t_trnheader *sh,
                 return exdrDOUBLE;
         }
 		
-		if ((sh->x_size != 0) || (sh->v_size != 0) || (sh->f_size != 0)) {
-			dx = (double *)calloc(sh->natoms*DIM,sizeof(dx[0]));
-			if (NULL == dx)
-				return exdrNOMEM;
-		}
-		if (sh->x_size   != 0) 
-        {
-            if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            dx[i*DIM+j] = x[i][j];
-                        }
-            }
-            if (xdrfile_read_double(dx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                if (bRead) 
-                {
-                    for(i=0; (i<sh->natoms); i++)
-                        for(j=0; (j<DIM); j++)
-                            if (NULL != x)
-                            {
-                                x[i][j] = dx[i*DIM+j];
-                            }
-                }
-            }
-            else
-                return exdrDOUBLE;
-        }
-		if (sh->v_size   != 0) 
-        {
-            if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            dx[i*DIM+j] = v[i][j];
-                        }
-            }
-            if (xdrfile_read_double(dx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != v)
-                        {
-                            v[i][j] = dx[i*DIM+j];
-                        }
-            }
-            else
-                return exdrDOUBLE;
-        }
-		if (sh->f_size   != 0) 
-        {
-            if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            dx[i*DIM+j] = f[i][j];
-                        }
-            }
-            if (xdrfile_read_double(dx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                for(i=0; (i<sh->natoms); i++)
-                {
-                    for(j=0; (j<DIM); j++)
-                    {
-                        if (NULL != f)
-                        {
-                            f[i][j] = dx[i*DIM+j];
-                        }
-                    }
-                }
-            }
-            else
-                return exdrDOUBLE;
-        }
-		if ((sh->x_size != 0) || (sh->v_size != 0) || (sh->f_size != 0)) {
-			free(dx);
-		}
+		if (sh->x_size != 0 && (result = (skip & TRR_X) ? skip_block(xd,sh->x_size) :
+									 do_rvec_double(xd,bRead,sh->natoms,x)) != exdrOK)
+			return result;
+		if (sh->v_size != 0 && (result = (skip & TRR_V) ? skip_block(xd,sh->v_size) :
+									 do_rvec_double(xd,bRead,sh->natoms,v)) != exdrOK)
+			return result;
+		if (sh->f_size != 0 && (result = (skip & TRR_F) ? skip_block(xd,sh->f_size) :
+									 do_rvec_double(xd,bRead,sh->natoms,f)) != exdrOK)
+			return result;
 	}
 	else
 		/* Float */
@@ -347,86 +345,21 @@ static int do_htrn(XDRFILE *xd,mybool bRead,t_trnheader *sh,
                 return exdrFLOAT;
         }
 		
-		if ((sh->x_size != 0) || (sh->v_size != 0) || (sh->f_size != 0)) {
-			fx = (float *)calloc(sh->natoms*DIM,sizeof(fx[0]));
-			if (NULL == fx)
-				return exdrNOMEM;
-		}
-		if (sh->x_size   != 0) 
-        {
-            if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            fx[i*DIM+j] = x[i][j];
-                        }
-            }
-            if (xdrfile_read_float(fx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                if (bRead) 
-                {
-                    for(i=0; (i<sh->natoms); i++)
-                        for(j=0; (j<DIM); j++)
-                            if (NULL != x)
-                                x[i][j] = fx[i*DIM+j];
-                }
-            }
-            else
-                return exdrFLOAT;
-        }
-		if (sh->v_size   != 0) 
-        {
-            if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            fx[i*DIM+j] = v[i][j];
-                        }
-            }
-            if (xdrfile_read_float(fx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != v)
-                            v[i][j] = fx[i*DIM+j];
-            }
-            else
-                return exdrFLOAT;
-        }
-		if (sh->f_size   != 0) 
-        {
-           if (!bRead) 
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != x)
-                        {
-                            fx[i*DIM+j] = f[i][j];
-                        }
-            }
-             if (xdrfile_read_float(fx,sh->natoms*DIM,xd) == sh->natoms*DIM)
-            {
-                for(i=0; (i<sh->natoms); i++)
-                    for(j=0; (j<DIM); j++)
-                        if (NULL != f)
-                            f[i][j] = fx[i*DIM+j];
-            }
-            else
-                return exdrFLOAT;
-        }
-		if ((sh->x_size != 0) || (sh->v_size != 0) || (sh->f_size != 0)) {
-			free(fx);
-		}
+		if (sh->x_size != 0 && (result = (skip & TRR_X) ? skip_block(xd,sh->x_size) :
+									 do_rvec_float(xd,sh->natoms,x)) != exdrOK)
+			return result;
+		if (sh->v_size != 0 && (result = (skip & TRR_V) ? skip_block(xd,sh->v_size) :
+									 do_rvec_float(xd,sh->natoms,v)) != exdrOK)
+			return result;
+		if (sh->f_size != 0 && (result = (skip & TRR_F) ? skip_block(xd,sh->f_size) :
+									 do_rvec_float(xd,sh->natoms,f)) != exdrOK)
+			return result;
 	}
 	return exdrOK;
 }
 
 static int do_trn(XDRFILE *xd,mybool bRead,int *step,float *t,float *lambda,
-				  matrix box,int *natoms,rvec *x,rvec *v,rvec *f)
+				  matrix box,int *natoms,rvec *x,rvec *v,rvec *f,int *fields,int skip)
 {
     t_trnheader *sh;
     int result;
@@ -456,8 +389,12 @@ static int do_trn(XDRFILE *xd,mybool bRead,int *step,float *t,float *lambda,
         *step   = sh->step;
         *t      = sh->td;
         *lambda = sh->lambdad;
+        if (NULL != fields)
+            *fields = ((sh->x_size != 0) ? TRR_X : 0) |
+                      ((sh->v_size != 0) ? TRR_V : 0) |
+                      ((sh->f_size != 0) ? TRR_F : 0);
     }
-    if ((result = do_htrn(xd,bRead,sh,box,x,v,f)) != exdrOK) {
+    if ((result = do_htrn(xd,bRead,sh,box,x,v,f,skip)) != exdrOK) {
         free(sh);
         return result;
     }
@@ -490,15 +427,54 @@ int read_trr_natoms(const char *fn,int *natoms)
 	return exdrOK;
 }
 
+int skip_trr(XDRFILE *xd,int *natoms,int *step,float *t)
+/* Read the header of a frame and skip all its blocks using the sizes in the header */
+{
+	t_trnheader sh;
+	int64_t size;
+	int result;
+
+	if ((result = do_trnheader(xd,1,&sh)) != exdrOK)
+		return result;
+
+	if (sh.box_size < 0 || sh.vir_size < 0 || sh.pres_size < 0 ||
+		sh.x_size < 0 || sh.v_size < 0 || sh.f_size < 0)
+		return exdrHEADER;
+
+	size = (int64_t)sh.box_size + sh.vir_size + sh.pres_size +
+		sh.x_size + sh.v_size + sh.f_size;
+	if (size > 0 && xdr_seek(xd,size,SEEK_CUR) != exdrOK)
+		return exdrENDOFFILE;
+
+	*natoms = sh.natoms;
+	*step   = sh.step;
+	*t      = sh.tf;
+
+	return exdrOK;
+}
+
 int write_trr(XDRFILE *xd,int natoms,int step,float t,float lambda,
 			  matrix box,rvec *x,rvec *v,rvec *f)
 {
-	return do_trn(xd,0,&step,&t,&lambda,box,&natoms,x,v,f);
+	return do_trn(xd,0,&step,&t,&lambda,box,&natoms,x,v,f,NULL,0);
 }
 
 int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 			 matrix box,rvec *x,rvec *v,rvec *f)
 {
-	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f);
+	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f,NULL,0);
+}
+
+int read_trr_fields(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
+					matrix box,rvec *x,rvec *v,rvec *f,int *fields)
+{
+	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f,fields,0);
+}
+
+int read_trr_select(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
+					matrix box,rvec *x,rvec *v,rvec *f,int wanted,int *fields)
+{
+	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f,fields,
+				  ~wanted & (TRR_X | TRR_V | TRR_F));
 }
 
@@ -42,6 +42,11 @@ extern "C" {
   /* All functions return exdrOK if succesfull. 
    * (error codes defined in xdrfile.h).
    */  
+
+  /* Flags identifying the coordinate, velocity and force blocks of a trr frame */
+#define TRR_X 1
+#define TRR_V 2
+#define TRR_F 4
    
   /* This function returns the number of atoms in the xtc file in *natoms */
   extern int read_trr_natoms(const char *fn,int *natoms);
@@ -51,6 +56,26 @@ extern "C" {
   extern int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 		      matrix box,rvec *x,rvec *v,rvec *f);
 
+  /* Same as read_trr, but also stores in *fields which of the blocks
+     (TRR_X, TRR_V, TRR_F) are present in the frame. Arrays of blocks
+     that are missing from the frame are left untouched. */
+  extern int read_trr_fields(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
+			     matrix box,rvec *x,rvec *v,rvec *f,int *fields);
+
+  /* Same as read_trr_fields, but only the blocks flagged in wanted
+     (TRR_X, TRR_V, TRR_F) are read. The other blocks are skipped using
+     a seek, without being decoded; the corresponding arrays are not
+     touched and may be NULL. *fields still reports all blocks present
+     in the frame. */
+  extern int read_trr_select(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
+			     matrix box,rvec *x,rvec *v,rvec *f,int wanted,int *fields);
+
+  /* Read the header of the next frame of an open trr file and skip
+     all its blocks using the block sizes stored in the header, without
+     reading them. Note that a truncated frame is not detected here;
+     compare xdr_tell with the file size. */
+  extern int skip_trr(XDRFILE *xd,int *natoms,int *step,float *t);
+
   /* Write a frame to xtc file */
   extern int write_trr(XDRFILE *xd,int natoms,int step,float t,float lambda,
 		       matrix box,rvec *x,rvec *v,rvec *f);
@@ -27,6 +27,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
  
+#include <stdio.h>
 #include <stdlib.h>
 #include "xdrfile.h"
 #include "xdrfile_xtc.h"
@@ -87,6 +88,39 @@ static int xtc_coord(XDRFILE *xd,int *natoms,matrix box,rvec *x,float *prec,
 	return exdrOK;
 }
 
+static int xtc_skip_coord(XDRFILE *xd)
+/* Skip over the box and the compressed coordinates without decompressing them */
+{
+	int lsize,bytes;
+	int ints[7];
+	float fbuf[DIM*DIM];
+
+	if (xdrfile_read_float(fbuf,DIM*DIM,xd) != DIM*DIM)
+		return exdrFLOAT;
+	if (xdrfile_read_int(&lsize,1,xd) != 1)
+		return exdrINT;
+	if (lsize < 0)
+		return exdr3DX;
+	/* small frames are stored as plain floats */
+	if (lsize <= 9)
+		return (xdr_seek(xd,(int64_t)lsize*DIM*sizeof(float),SEEK_CUR) == exdrOK) ? exdrOK : exdr3DX;
+	/* precision */
+	if (xdrfile_read_float(fbuf,1,xd) != 1)
+		return exdrFLOAT;
+	/* minint, maxint, smallidx */
+	if (xdrfile_read_int(ints,7,xd) != 7)
+		return exdrINT;
+	/* length of the compressed data in bytes, padded to a multiple of four */
+	if (xdrfile_read_int(&bytes,1,xd) != 1)
+		return exdrINT;
+	if (bytes < 0)
+		return exdr3DX;
+	if (xdr_seek(xd,((int64_t)bytes + 3) & ~(int64_t)3,SEEK_CUR) != exdrOK)
+		return exdr3DX;
+	
+	return exdrOK;
+}
+
 int read_xtc_natoms(const char *fn,int *natoms)
 {
 	XDRFILE *xd;
@@ -118,6 +152,26 @@ int read_xtc(XDRFILE *xd,
 	return exdrOK;
 }
 
+int read_xtc_partial(XDRFILE *xd,
+					 int natoms,int *step,float *time,
+					 matrix box,rvec *x,float *prec,int nwanted)
+/* Read the first nwanted coordinates of subsequent frames */
+{
+	int result;
+  
+	if ((result = xtc_header(xd,&natoms,step,time,TRUE)) != exdrOK)
+		return result;
+	
+	if (xdrfile_read_float(box[0],DIM*DIM,xd) != DIM*DIM)
+		return exdrFLOAT;
+	
+	result = xdrfile_decompress_coord_float_partial(x[0],&natoms,nwanted,prec,xd);
+	if (result < 0 || result != ((nwanted < natoms) ? nwanted : natoms))
+		return exdr3DX;
+  
+	return exdrOK;
+}
+
 int write_xtc(XDRFILE *xd,
 			  int natoms,int step,float time,
 			  matrix box,rvec *x,float prec)
@@ -133,3 +187,17 @@ int write_xtc(XDRFILE *xd,
   
 	return exdrOK;
 }
+
+int skip_xtc(XDRFILE *xd,int *natoms,int *step,float *time)
+/* Read the header of a frame and skip the rest of it */
+{
+	int result;
+
+	if ((result = xtc_header(xd,natoms,step,time,TRUE)) != exdrOK)
+		return result;
+
+	if ((result = xtc_skip_coord(xd)) != exdrOK)
+		return result;
+
+	return exdrOK;
+}
@@ -47,6 +47,18 @@ extern "C" {
   extern int read_xtc(XDRFILE *xd,int natoms,int *step,float *time,
 		      matrix box,rvec *x,float *prec);
   
+  /* Read one frame of an open xtc file, but only decompress the first
+     nwanted coordinates (x must have room for nwanted coordinates).
+     The rest of the frame is skipped. */
+  extern int read_xtc_partial(XDRFILE *xd,int natoms,int *step,float *time,
+			      matrix box,rvec *x,float *prec,int nwanted);
+  
+  /* Read the header of the next frame of an open xtc file and skip
+     its coordinates without decompressing them. Box and coordinates
+     are not returned. Note that a frame truncated inside its coordinate
+     block is not detected here; compare xdr_tell with the file size. */
+  extern int skip_xtc(XDRFILE *xd,int *natoms,int *step,float *time);
+  
   /* Write a frame to xtc file */
   extern int write_xtc(XDRFILE *xd,
 		       int natoms,int step,float time,
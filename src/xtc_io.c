@@ -2,6 +2,7 @@
 // Copyright (c) 2022 Ladislav Bartos
 
 #include "xtc_io.h"
+#include "traj_reader.h"
 
 void box_xtc2gro(float box[3][3], box_t gro_box)
 {
@@ -26,35 +27,69 @@ void reset_velocities(system_t *system)
 
 int read_xtc_step(XDRFILE *xtc, system_t *system)
 {
-    float box[3][3] = {0};
+    // this allocates the frame buffer for every call; use traj_reader_t directly to avoid that
+    traj_reader_t *reader = traj_reader_create(xtc, system, traj_xtc);
+    if (reader == NULL) return 1;
 
-    // allocate memory for an array of coordinates
-    // this is a 2D array of [n_atoms][3] floats
-    vec_t *coordinates = malloc(system->n_atoms * sizeof(vec_t));
+    int return_code = traj_reader_read(reader);
 
-    if (read_xtc(xtc, system->n_atoms, &(system->step), &(system->time), box, coordinates, &(system->precision)) != 0) {
+    traj_reader_destroy(reader);
+    return return_code;
+}
+
+/*! @brief Reads an xtc frame updating the first n_wanted atoms of the system. */
+static int xtc_read_prefix(XDRFILE *xtc, system_t *system, size_t n_wanted)
+{
+    float box[3][3] = {{0}};
+
+    if (n_wanted > system->n_atoms) n_wanted = system->n_atoms;
+
+    // coordinates are decoded directly into the block of positions, if it is enabled
+    if (system->positions != NULL) {
+        if (read_xtc_partial(xtc, system->n_atoms, &(system->step), &(system->time), box, system->positions, &(system->precision), (int) n_wanted) != 0) {
+            return 1;
+        }
+
+        box_xtc2gro(box, system->box);
+        return 0;
+    }
+
+    // at least one item is allocated so that frames can be read even if no atom is requested
+    vec_t *coordinates = malloc((n_wanted > 0 ? n_wanted : 1) * sizeof(vec_t));
+    if (coordinates == NULL) return 1;
+
+    if (read_xtc_partial(xtc, system->n_atoms, &(system->step), &(system->time), box, coordinates, &(system->precision), (int) n_wanted) != 0) {
         free(coordinates);
         return 1;
     }
 
-    // update the system
     box_xtc2gro(box, system->box);
-    // loop through all the atoms and update their coordinates
-    for (size_t i = 0; i < system->n_atoms; ++i) {
+    for (size_t i = 0; i < n_wanted; ++i) {
         memcpy(system->atoms[i].position, coordinates[i], 3 * sizeof(float));
     }
 
-    /*DEBUG
-    for (size_t i = 0; i < system->n_atoms; ++i) {
-        atom_t *atom = &(system->atoms[i]);
-        printf("%f %f %f\n", atom->position[0], atom->position[1], atom->position[2]);
-    }*/
-
     free(coordinates);
-
     return 0;
 }
 
+int read_xtc_step_partial(XDRFILE *xtc, system_t *system, size_t max_atom_index)
+{
+    // avoid overflow for max_atom_index == SIZE_MAX
+    size_t n_wanted = max_atom_index >= system->n_atoms ? system->n_atoms : max_atom_index + 1;
+    return xtc_read_prefix(xtc, system, n_wanted);
+}
+
+int read_xtc_step_selection(XDRFILE *xtc, system_t *system, const atom_selection_t *selection)
+{
+    size_t n_wanted = 0;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        size_t index = (size_t) (selection->atoms[i] - system->atoms);
+        if (index + 1 > n_wanted) n_wanted = index + 1;
+    }
+
+    return xtc_read_prefix(xtc, system, n_wanted);
+}
+
 int write_xtc_step(
         XDRFILE *xtc, 
         const atom_selection_t *selection, 
@@ -82,6 +117,36 @@ int write_xtc_step(
     return 0;
 }
 
+traj_index_t *build_xtc_index(XDRFILE *xtc)
+{
+    traj_index_t *index = traj_index_create();
+    if (index == NULL) return NULL;
+
+    if (traj_index_extend(index, xtc, skip_xtc) != 0) {
+        traj_index_destroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+traj_index_t *load_xtc_index(const char *filename)
+{
+    return traj_index_obtain(filename, skip_xtc);
+}
+
+int seek_xtc_frame(XDRFILE *xtc, const traj_index_t *index, size_t frame)
+{
+    if (frame >= index->n_frames) return 1;
+
+    return xdr_seek(xtc, index->frames[frame].offset, SEEK_SET) != exdrOK;
+}
+
+int scan_xtc(const char *filename, int repair, traj_scan_t *report)
+{
+    return traj_scan(filename, skip_xtc, repair, report);
+}
+
 int validate_xtc(const char *filename, const int n_atoms)
 {
     int xtc_atoms = n_atoms;
@@ -7,6 +7,8 @@
 #include <string.h>
 #include "gro.h"
 #include "xdrfile/xdrfile_xtc.h"
+#include "traj_index.h"
+#include "traj_scan.h"
 
 /*! @brief Converts box dimensions from the xtc format into gro format.
  * 
@@ -36,6 +38,11 @@ void reset_velocities(system_t *system);
 
 
 /*! @brief Reads a single trajectory step from an open xtc file and updates the system.
+ * 
+ * @paragraph Contiguous block of positions
+ * If the block of positions of the system is enabled (see system_positions_enable()),
+ * the coordinates are decoded directly into the block and the atoms are not updated.
+ * The same applies to all other trajectory readers.
  * 
  * @param xtc           open XDRFILE structure corresponding to target xtc file
  * @param system        pointer to a structure containing information about the system
@@ -46,6 +53,48 @@ void reset_velocities(system_t *system);
 int read_xtc_step(XDRFILE *xtc, system_t *system);
 
 
+/*! @brief Reads a single trajectory step from an open xtc file and updates only the first atoms of the system.
+ *
+ * @paragraph Details
+ * Only positions of atoms with indices 0 to max_atom_index (inclusive) are updated.
+ * Positions of the other atoms are not changed. Box, step, time and precision are updated as usual.
+ *
+ * Coordinates in xtc files are compressed sequentially, so the decompression stops after the
+ * last requested atom and the rest of the frame is skipped using the byte count stored in the file.
+ * This is much faster than read_xtc_step() if the analyzed atoms lie at the beginning of the system
+ * (e.g. a protein followed by lots of solvent).
+ *
+ * If max_atom_index is larger than the index of the last atom, all atoms are updated.
+ *
+ * @param xtc               open XDRFILE structure corresponding to target xtc file
+ * @param system            pointer to a structure containing information about the system
+ * @param max_atom_index    index of the last atom to update
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int read_xtc_step_partial(XDRFILE *xtc, system_t *system, size_t max_atom_index);
+
+
+/*! @brief Reads a single trajectory step from an open xtc file and updates the atoms of the selection.
+ *
+ * @paragraph Details
+ * Calls read_xtc_step_partial() with max_atom_index set to the largest index of the selected atoms.
+ * Atoms of the selection must belong to the system. Some atoms that are not part of the selection
+ * (those with lower indices than the last selected atom) are updated too.
+ *
+ * If the selection is empty, only box, step, time and precision are updated.
+ *
+ * @param xtc           open XDRFILE structure corresponding to target xtc file
+ * @param system        pointer to a structure containing information about the system
+ * @param selection     selection of atoms which positions should be updated
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int read_xtc_step_selection(XDRFILE *xtc, system_t *system, const atom_selection_t *selection);
+
+
 /*! @brief Writes the current positions of the selected atoms to xtc file.
  * 
  * @param xtc           open XDRFILE structure corresponding to target xtc file
@@ -66,6 +115,70 @@ int write_xtc_step(
         float precision);
 
 
+/*! @brief Creates an index of frames of an open xtc file.
+ *
+ * @paragraph Details
+ * The file is scanned by reading only the headers of the frames. The compressed coordinates
+ * are skipped using the byte count stored in each frame, so no frame is decompressed.
+ * Scanning stops at the end of the file or at the first frame that is corrupted or truncated;
+ * such a frame and all frames after it are not part of the index.
+ *
+ * The position in the xtc file is restored after the index is created.
+ *
+ * @param xtc           open XDRFILE structure corresponding to target xtc file
+ *
+ * @return Pointer to the created traj_index_t structure. NULL if the file could not be scanned.
+ */
+traj_index_t *build_xtc_index(XDRFILE *xtc);
+
+
+/*! @brief Gets the index of frames of an xtc file, using the sidecar index file if possible.
+ *
+ * @paragraph Details
+ * If a valid sidecar index file (see traj_index_save()) exists next to the xtc file, the index is loaded from it.
+ * If the xtc file has grown since the sidecar file was written and the indexed part is unchanged, only the new frames are scanned.
+ * Otherwise, the whole file is scanned using build_xtc_index(). In both of these cases, the sidecar file
+ * is then (re)written so that other programs working with the same xtc file can use it.
+ * Failure to write the sidecar file is silently ignored.
+ *
+ * @param filename      path to the xtc file
+ *
+ * @return Pointer to the traj_index_t structure. NULL if the index could not be obtained.
+ */
+traj_index_t *load_xtc_index(const char *filename);
+
+
+/*! @brief Moves to the specified frame of an open xtc file.
+ *
+ * @paragraph Details
+ * The next call of read_xtc_step() will read the target frame.
+ *
+ * @param xtc           open XDRFILE structure corresponding to target xtc file
+ * @param index         index of frames of the xtc file (see build_xtc_index())
+ * @param frame         zero-based number of the frame to move to
+ *
+ * @return Zero if successful, else non-zero.
+ * Non-zero is also returned if the frame is not part of the index.
+ */
+int seek_xtc_frame(XDRFILE *xtc, const traj_index_t *index, size_t frame);
+
+
+/*! @brief Checks the integrity of an xtc file by reading only the headers of its frames.
+ *
+ * @paragraph Details
+ * Counts the frames, gets the time range and reports irregular time steps, changes in the number
+ * of atoms and the position of the first corrupted or truncated frame. No coordinates are decompressed.
+ * See traj_scan() for more details.
+ *
+ * @param filename      path to the xtc file
+ * @param repair        if non-zero, truncate the file to the last valid frame
+ * @param report        pointer to a structure in which the report will be stored
+ *
+ * @return Zero if the file has been scanned (and truncated, if requested), else non-zero.
+ */
+int scan_xtc(const char *filename, int repair, traj_scan_t *report);
+
+
 /*! @brief Checks that the number of atoms in xtc file matches the provided number.
  * 
  * @param filename      path to the xtc file
@@ -0,0 +1,242 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+
+#include <pthread.h>
+#include "xtc_parallel.h"
+
+/* States of a slot of the queue. */
+enum { slot_empty, slot_decoding, slot_ready };
+
+/* Slot of the queue holding a single decoded frame. */
+typedef struct xtc_slot {
+    size_t frame;           /* number of the frame stored in the slot */
+    int state;              /* slot_empty, slot_decoding or slot_ready */
+    int result;             /* exdrOK if the frame was decoded successfully */
+    int step;
+    float time;
+    float precision;
+    matrix box;
+    vec_t *coordinates;
+} xtc_slot_t;
+
+/* Data owned by a single worker thread. */
+typedef struct xtc_worker {
+    xtc_parallel_t *reader;
+    pthread_t thread;
+    FILE *file;             /* own handle of the xtc file */
+    char *raw;              /* raw bytes of the frame being decoded */
+    size_t raw_capacity;
+    XDRFILE *xdr;           /* in-memory XDRFILE owning the decompression buffers of the worker */
+} xtc_worker_t;
+
+struct xtc_parallel {
+    system_t *system;
+    traj_index_t *index;
+
+    size_t n_workers;
+    xtc_worker_t *workers;
+
+    size_t queue_size;
+    xtc_slot_t *slots;
+
+    size_t next_claim;      /* next frame to be claimed by a worker */
+    size_t next_read;       /* next frame to be passed to the caller */
+    int stop;               /* set when the reader is being destroyed */
+    int n_running;          /* number of started worker threads */
+
+    pthread_mutex_t lock;
+    pthread_cond_t frame_ready;
+    pthread_cond_t slot_free;
+};
+
+/*! @brief Reads and decodes the target frame into the slot. Returns exdrOK if successful. */
+static int xtc_worker_decode(xtc_worker_t *worker, size_t frame, xtc_slot_t *slot)
+{
+    const traj_index_t *index = worker->reader->index;
+    int64_t start = index->frames[frame].offset;
+    int64_t end = frame + 1 < index->n_frames ? index->frames[frame + 1].offset : index->end;
+    size_t size = (size_t) (end - start);
+
+    if (size > worker->raw_capacity) {
+        char *new_raw = realloc(worker->raw, size);
+        if (new_raw == NULL) return exdrNOMEM;
+        worker->raw = new_raw;
+        worker->raw_capacity = size;
+    }
+
+    if (fseeko(worker->file, (off_t) start, SEEK_SET) != 0) return exdrENDOFFILE;
+    if (fread(worker->raw, 1, size, worker->file) != size) return exdrENDOFFILE;
+
+    xdrfile_reset_buffer(worker->xdr, worker->raw, (int64_t) size);
+    return read_xtc(worker->xdr, worker->reader->system->n_atoms, &(slot->step), &(slot->time),
+            slot->box, slot->coordinates, &(slot->precision));
+}
+
+/*! @brief Main function of a worker thread. Claims frames in order and decodes them into free slots. */
+static void *xtc_worker_run(void *arg)
+{
+    xtc_worker_t *worker = (xtc_worker_t *) arg;
+    xtc_parallel_t *reader = worker->reader;
+
+    pthread_mutex_lock(&reader->lock);
+    while (1) {
+        // the slot of the next frame is free only once the caller is less than queue_size frames behind
+        while (!reader->stop && reader->next_claim < reader->index->n_frames &&
+                reader->next_claim >= reader->next_read + reader->queue_size) {
+            pthread_cond_wait(&reader->slot_free, &reader->lock);
+        }
+
+        if (reader->stop || reader->next_claim >= reader->index->n_frames) break;
+
+        size_t frame = reader->next_claim++;
+        xtc_slot_t *slot = &(reader->slots[frame % reader->queue_size]);
+        slot->frame = frame;
+        slot->state = slot_decoding;
+        pthread_mutex_unlock(&reader->lock);
+
+        int result = xtc_worker_decode(worker, frame, slot);
+
+        pthread_mutex_lock(&reader->lock);
+        slot->result = result;
+        slot->state = slot_ready;
+        pthread_cond_broadcast(&reader->frame_ready);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    return NULL;
+}
+
+xtc_parallel_t *xtc_parallel_create(const char *filename, system_t *system, size_t n_threads, size_t queue_size)
+{
+    if (n_threads == 0) return NULL;
+    if (queue_size == 0) queue_size = 2 * n_threads;
+
+    xtc_parallel_t *reader = calloc(1, sizeof(xtc_parallel_t));
+    if (reader == NULL) return NULL;
+
+    reader->system = system;
+    reader->queue_size = queue_size;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->frame_ready, NULL);
+    pthread_cond_init(&reader->slot_free, NULL);
+
+    reader->index = load_xtc_index(filename);
+    reader->slots = calloc(queue_size, sizeof(xtc_slot_t));
+    reader->workers = calloc(n_threads, sizeof(xtc_worker_t));
+    if (reader->index == NULL || reader->slots == NULL || reader->workers == NULL) {
+        xtc_parallel_destroy(reader);
+        return NULL;
+    }
+
+    size_t n_items = system->n_atoms > 0 ? system->n_atoms : 1;
+    for (size_t i = 0; i < queue_size; ++i) {
+        reader->slots[i].coordinates = malloc(n_items * sizeof(vec_t));
+        if (reader->slots[i].coordinates == NULL) {
+            xtc_parallel_destroy(reader);
+            return NULL;
+        }
+    }
+
+    reader->n_workers = n_threads;
+    for (size_t i = 0; i < n_threads; ++i) {
+        xtc_worker_t *worker = &(reader->workers[i]);
+        worker->reader = reader;
+        worker->file = fopen(filename, "rb");
+        worker->xdr = xdrfile_open_buffer(NULL, 0);
+        if (worker->file == NULL || worker->xdr == NULL) {
+            xtc_parallel_destroy(reader);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < n_threads; ++i) {
+        if (pthread_create(&(reader->workers[i].thread), NULL, xtc_worker_run, &(reader->workers[i])) != 0) {
+            xtc_parallel_destroy(reader);
+            return NULL;
+        }
+        reader->n_running++;
+    }
+
+    return reader;
+}
+
+int xtc_parallel_read(xtc_parallel_t *reader)
+{
+    pthread_mutex_lock(&reader->lock);
+    if (reader->next_read >= reader->index->n_frames) {
+        pthread_mutex_unlock(&reader->lock);
+        return 1;
+    }
+
+    xtc_slot_t *slot = &(reader->slots[reader->next_read % reader->queue_size]);
+    while (slot->state != slot_ready || slot->frame != reader->next_read) {
+        pthread_cond_wait(&reader->frame_ready, &reader->lock);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    // workers do not touch the slot until next_read is increased, so it can be read without the lock
+    int result = slot->result;
+    if (result == exdrOK) {
+        system_t *system = reader->system;
+        system->step = slot->step;
+        system->time = slot->time;
+        system->precision = slot->precision;
+        box_xtc2gro(slot->box, system->box);
+        if (system->positions != NULL) {
+            memcpy(system->positions, slot->coordinates, system->n_atoms * sizeof(vec_t));
+        } else {
+            for (size_t i = 0; i < system->n_atoms; ++i) {
+                memcpy(system->atoms[i].position, slot->coordinates[i], 3 * sizeof(float));
+            }
+        }
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    slot->state = slot_empty;
+    // a frame that could not be decoded ends the trajectory, like for read_xtc_step()
+    reader->next_read = result == exdrOK ? reader->next_read + 1 : reader->index->n_frames;
+    pthread_cond_broadcast(&reader->slot_free);
+    pthread_mutex_unlock(&reader->lock);
+
+    return result != exdrOK;
+}
+
+void xtc_parallel_destroy(xtc_parallel_t *reader)
+{
+    if (reader == NULL) return;
+
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = 1;
+    pthread_cond_broadcast(&reader->slot_free);
+    pthread_mutex_unlock(&reader->lock);
+
+    for (int i = 0; i < reader->n_running; ++i) {
+        pthread_join(reader->workers[i].thread, NULL);
+    }
+
+    if (reader->workers != NULL) {
+        for (size_t i = 0; i < reader->n_workers; ++i) {
+            if (reader->workers[i].file != NULL) fclose(reader->workers[i].file);
+            if (reader->workers[i].xdr != NULL) xdrfile_close(reader->workers[i].xdr);
+            free(reader->workers[i].raw);
+        }
+    }
+
+    if (reader->slots != NULL) {
+        for (size_t i = 0; i < reader->queue_size; ++i) {
+            free(reader->slots[i].coordinates);
+        }
+    }
+
+    free(reader->workers);
+    free(reader->slots);
+    traj_index_destroy(reader->index);
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->frame_ready);
+    pthread_cond_destroy(&reader->slot_free);
+    free(reader);
+}
@@ -0,0 +1,68 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef XTC_PARALLEL_H
+#define XTC_PARALLEL_H
+
+#include "gro.h"
+#include "xtc_io.h"
+
+/*! @brief Multi-threaded reader of xtc files.
+ *
+ * @paragraph Details
+ * The reader uses the index of frames of the xtc file (see load_xtc_index()) to hand whole
+ * compressed frames to a pool of worker threads. Each worker reads the raw bytes of its frame using
+ * its own file handle and decompresses them using its own decompression buffers.
+ * Decoded frames are stored in a bounded queue and are passed to the caller strictly in the order
+ * in which they are stored in the xtc file. Workers never run ahead of the caller by more frames
+ * than the size of the queue.
+ *
+ * The structure is opaque; use the functions below to work with it.
+ */
+typedef struct xtc_parallel xtc_parallel_t;
+
+
+/*! @brief Creates a multi-threaded reader for an xtc file and starts the worker threads.
+ *
+ * @paragraph Details
+ * The index of the xtc file is obtained using load_xtc_index(), so a sidecar index file
+ * may be written next to the xtc file.
+ *
+ * Memory for queue_size frames of system->n_atoms atoms is allocated.
+ * If queue_size is zero, twice the number of threads is used.
+ *
+ * @param filename      path to the xtc file
+ * @param system        pointer to a structure containing information about the system
+ * @param n_threads     number of worker threads (at least 1)
+ * @param queue_size    maximal number of decoded frames waiting to be read
+ *
+ * @return Pointer to the created xtc_parallel_t structure. NULL if the reader could not be created.
+ */
+xtc_parallel_t *xtc_parallel_create(const char *filename, system_t *system, size_t n_threads, size_t queue_size);
+
+
+/*! @brief Reads the next frame of the xtc file and updates the system.
+ *
+ * @paragraph Details
+ * Behaves exactly like read_xtc_step(): positions of atoms, box, step, time and precision
+ * of the system are updated. Waits until the frame is decoded by one of the workers.
+ *
+ * @param reader        pointer to xtc_parallel_t structure
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int xtc_parallel_read(xtc_parallel_t *reader);
+
+
+/*! @brief Stops the worker threads and deallocates memory for the reader.
+ *
+ * @paragraph Details
+ * The reader may be destroyed before all frames have been read.
+ * Does NOT deallocate the system.
+ *
+ * @param reader        pointer to xtc_parallel_t structure to destroy
+ */
+void xtc_parallel_destroy(xtc_parallel_t *reader);
+
+#endif /* XTC_PARALLEL_H */
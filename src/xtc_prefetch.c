@@ -0,0 +1,182 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include "xtc_prefetch.h"
+
+/* States of a slot of the ring. */
+enum { slot_empty, slot_ready };
+
+/* Slot of the ring holding a single decoded frame. */
+typedef struct xtc_prefetch_slot {
+    int state;              /* slot_empty or slot_ready */
+    int result;             /* exdrOK if the frame was decoded successfully */
+    int step;
+    float time;
+    float precision;
+    matrix box;
+    vec_t *coordinates;
+} xtc_prefetch_slot_t;
+
+struct xtc_prefetch {
+    XDRFILE *xtc;
+    system_t *system;
+
+    size_t queue_size;
+    xtc_prefetch_slot_t *slots;
+
+    size_t next_fill;       /* next frame to be decoded by the background thread */
+    size_t next_read;       /* next frame to be passed to the caller */
+    int exhausted;          /* set once the caller has been told that the file has been fully read */
+    int stop;               /* set when the reader is being destroyed */
+    int running;            /* set if the background thread has been started */
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t frame_ready;
+    pthread_cond_t slot_free;
+};
+
+/*! @brief Main function of the background thread. Decodes frames in order into free slots. */
+static void *xtc_prefetch_run(void *arg)
+{
+    xtc_prefetch_t *reader = (xtc_prefetch_t *) arg;
+
+    pthread_mutex_lock(&reader->lock);
+    while (1) {
+        while (!reader->stop && reader->next_fill >= reader->next_read + reader->queue_size) {
+            pthread_cond_wait(&reader->slot_free, &reader->lock);
+        }
+
+        if (reader->stop) break;
+
+        xtc_prefetch_slot_t *slot = &(reader->slots[reader->next_fill % reader->queue_size]);
+        pthread_mutex_unlock(&reader->lock);
+
+        // the caller does not touch the slot until it is marked as ready
+        int result = read_xtc(reader->xtc, reader->system->n_atoms, &(slot->step), &(slot->time),
+                slot->box, slot->coordinates, &(slot->precision));
+
+        pthread_mutex_lock(&reader->lock);
+        slot->result = result;
+        slot->state = slot_ready;
+        reader->next_fill++;
+        pthread_cond_broadcast(&reader->frame_ready);
+
+        // a frame that could not be decoded ends the trajectory, like for read_xtc_step()
+        if (result != exdrOK) break;
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    return NULL;
+}
+
+xtc_prefetch_t *xtc_prefetch_create(XDRFILE *xtc, system_t *system, size_t queue_size)
+{
+    if (queue_size == 0) queue_size = 2;
+
+    xtc_prefetch_t *reader = calloc(1, sizeof(xtc_prefetch_t));
+    if (reader == NULL) return NULL;
+
+    reader->xtc = xtc;
+    reader->system = system;
+    reader->queue_size = queue_size;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->frame_ready, NULL);
+    pthread_cond_init(&reader->slot_free, NULL);
+
+    reader->slots = calloc(queue_size, sizeof(xtc_prefetch_slot_t));
+    if (reader->slots == NULL) {
+        xtc_prefetch_destroy(reader);
+        return NULL;
+    }
+
+    // buffers have the same size as the block of positions, so that they can be swapped with it
+    size_t n_items = system->n_atoms > 0 ? system->n_atoms : 1;
+    for (size_t i = 0; i < queue_size; ++i) {
+        reader->slots[i].coordinates = malloc(n_items * sizeof(vec_t));
+        if (reader->slots[i].coordinates == NULL) {
+            xtc_prefetch_destroy(reader);
+            return NULL;
+        }
+    }
+
+    if (pthread_create(&reader->thread, NULL, xtc_prefetch_run, reader) != 0) {
+        xtc_prefetch_destroy(reader);
+        return NULL;
+    }
+    reader->running = 1;
+
+    return reader;
+}
+
+int xtc_prefetch_read(xtc_prefetch_t *reader)
+{
+    if (reader->exhausted) return 1;
+
+    xtc_prefetch_slot_t *slot = &(reader->slots[reader->next_read % reader->queue_size]);
+
+    pthread_mutex_lock(&reader->lock);
+    while (slot->state != slot_ready) {
+        pthread_cond_wait(&reader->frame_ready, &reader->lock);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    // the background thread does not touch the slot until next_read is increased
+    int result = slot->result;
+    if (result == exdrOK) {
+        system_t *system = reader->system;
+        system->step = slot->step;
+        system->time = slot->time;
+        system->precision = slot->precision;
+        box_xtc2gro(slot->box, system->box);
+
+        if (system->positions != NULL) {
+            // the previous block of positions becomes the buffer for one of the following frames
+            vec_t *previous = system->positions;
+            system->positions = slot->coordinates;
+            slot->coordinates = previous;
+        } else {
+            for (size_t i = 0; i < system->n_atoms; ++i) {
+                memcpy(system->atoms[i].position, slot->coordinates[i], 3 * sizeof(float));
+            }
+        }
+    } else {
+        reader->exhausted = 1;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    slot->state = slot_empty;
+    if (result == exdrOK) reader->next_read++;
+    pthread_cond_broadcast(&reader->slot_free);
+    pthread_mutex_unlock(&reader->lock);
+
+    return result != exdrOK;
+}
+
+void xtc_prefetch_destroy(xtc_prefetch_t *reader)
+{
+    if (reader == NULL) return;
+
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = 1;
+    pthread_cond_broadcast(&reader->slot_free);
+    pthread_mutex_unlock(&reader->lock);
+
+    if (reader->running) pthread_join(reader->thread, NULL);
+
+    if (reader->slots != NULL) {
+        for (size_t i = 0; i < reader->queue_size; ++i) {
+            free(reader->slots[i].coordinates);
+        }
+    }
+
+    free(reader->slots);
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->frame_ready);
+    pthread_cond_destroy(&reader->slot_free);
+    free(reader);
+}
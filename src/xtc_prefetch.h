@@ -0,0 +1,71 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef XTC_PREFETCH_H
+#define XTC_PREFETCH_H
+
+#include "gro.h"
+#include "xtc_io.h"
+
+/*! @brief Reader of xtc files decoding the following frames in a background thread.
+ *
+ * @paragraph Details
+ * A single background thread reads the xtc file sequentially and decodes up to queue_size frames
+ * ahead of the caller into a ring of preallocated coordinate buffers. While the caller analyzes frame N,
+ * frames N+1 to N+queue_size are being decoded, so reading and decompression overlap with the analysis.
+ *
+ * If the block of positions of the system is enabled (see system_positions_enable()), decoded frames
+ * are handed over to the system by swapping the system->positions pointer with the buffer of the frame;
+ * no coordinates are copied. In such case, system->positions changes with every frame read, so it
+ * must not be cached by the caller across calls of xtc_prefetch_read(). Otherwise, the positions are
+ * copied into the atoms of the system.
+ *
+ * The structure is opaque; use the functions below to work with it.
+ */
+typedef struct xtc_prefetch xtc_prefetch_t;
+
+
+/*! @brief Creates a prefetching reader for an open xtc file and starts the background thread.
+ *
+ * @paragraph Details
+ * Frames are read starting from the current position in the xtc file. The file must not be used
+ * by the caller while the reader exists. The reader does not own the file; close it after destroying the reader.
+ *
+ * Memory for queue_size frames of system->n_atoms atoms is allocated.
+ * If queue_size is zero, two frames are prefetched.
+ *
+ * @param xtc           open XDRFILE structure corresponding to target xtc file
+ * @param system        pointer to a structure containing information about the system
+ * @param queue_size    maximal number of decoded frames waiting to be read
+ *
+ * @return Pointer to the created xtc_prefetch_t structure. NULL if the reader could not be created.
+ */
+xtc_prefetch_t *xtc_prefetch_create(XDRFILE *xtc, system_t *system, size_t queue_size);
+
+
+/*! @brief Reads the next frame of the xtc file and updates the system.
+ *
+ * @paragraph Details
+ * Behaves like read_xtc_step(): positions of atoms, box, step, time and precision
+ * of the system are updated. Waits only if the frame has not been decoded yet.
+ *
+ * @param reader        pointer to xtc_prefetch_t structure
+ *
+ * @return Zero if reading was successful, else non-zero.
+ * Non-zero return code indicates that the file has been fully read.
+ */
+int xtc_prefetch_read(xtc_prefetch_t *reader);
+
+
+/*! @brief Stops the background thread and deallocates memory for the reader.
+ *
+ * @paragraph Details
+ * The reader may be destroyed before all frames have been read; the position in the xtc file
+ * is then undefined. Does NOT close the xtc file and does NOT deallocate the system.
+ * The buffer currently used as system->positions remains owned by the system.
+ *
+ * @param reader        pointer to xtc_prefetch_t structure to destroy
+ */
+void xtc_prefetch_destroy(xtc_prefetch_t *reader);
+
+#endif /* XTC_PREFETCH_H */
@@ -0,0 +1,288 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include "xtc_writer.h"
+
+/* States of a slot of the queue. */
+enum { slot_empty, slot_queued, slot_compressing, slot_compressed };
+
+/* Slot of the queue holding a single submitted frame. */
+typedef struct xtc_out_slot {
+    int state;              /* slot_empty, slot_queued, slot_compressing or slot_compressed */
+    int result;             /* zero if the frame was compressed successfully */
+    int step;
+    float time;
+    float precision;
+    matrix box;
+    size_t n_atoms;
+    vec_t *coordinates;
+    size_t coordinates_capacity;
+    char *data;             /* compressed frame */
+    size_t data_size;
+    size_t data_capacity;
+} xtc_out_slot_t;
+
+/* Data owned by a single worker thread. */
+typedef struct xtc_out_worker {
+    xtc_writer_t *writer;
+    pthread_t thread;
+    XDRFILE *xdr;           /* in-memory XDRFILE owning the compression buffers of the worker */
+} xtc_out_worker_t;
+
+struct xtc_writer {
+    FILE *file;
+
+    size_t n_workers;
+    xtc_out_worker_t *workers;
+
+    size_t queue_size;
+    xtc_out_slot_t *slots;
+
+    size_t next_submit;     /* number of frames submitted by the caller */
+    size_t next_claim;      /* next frame to be claimed by a worker */
+    size_t next_commit;     /* next frame to be written into the file */
+    int committing;         /* set while a worker is writing frames into the file */
+    int error;              /* set if any frame could not be compressed or written */
+    int stop;               /* set when the writer is being closed */
+    int n_running;          /* number of started worker threads */
+
+    pthread_mutex_t lock;
+    pthread_cond_t frame_queued;
+    pthread_cond_t slot_free;
+};
+
+/*! @brief Compresses the frame stored in the slot into the data of the slot. Returns 0 if successful, else 1. */
+static int xtc_worker_compress(xtc_out_worker_t *worker, xtc_out_slot_t *slot)
+{
+    if (xdr_seek(worker->xdr, 0, SEEK_SET) != exdrOK) return 1;
+    if (write_xtc(worker->xdr, (int) slot->n_atoms, slot->step, slot->time,
+            slot->box, slot->coordinates, slot->precision) != exdrOK) return 1;
+
+    int64_t size = 0;
+    char *data = xdrfile_output_data(worker->xdr, &size);
+    if (data == NULL) return 1;
+
+    if ((size_t) size > slot->data_capacity) {
+        char *new_data = realloc(slot->data, (size_t) size);
+        if (new_data == NULL) return 1;
+        slot->data = new_data;
+        slot->data_capacity = (size_t) size;
+    }
+
+    memcpy(slot->data, data, (size_t) size);
+    slot->data_size = (size_t) size;
+    return 0;
+}
+
+/*! @brief Writes all compressed frames that are next in order into the file. Must be called with the lock held. */
+static void xtc_writer_commit(xtc_writer_t *writer)
+{
+    // only one worker writes into the file at a time; it also writes frames compressed by other workers meanwhile
+    while (!writer->committing && writer->next_commit < writer->next_submit) {
+        xtc_out_slot_t *slot = &(writer->slots[writer->next_commit % writer->queue_size]);
+        if (slot->state != slot_compressed) break;
+
+        int failed = writer->error || slot->result != 0;
+        writer->committing = 1;
+        pthread_mutex_unlock(&writer->lock);
+
+        if (!failed) failed = fwrite(slot->data, 1, slot->data_size, writer->file) != slot->data_size;
+
+        pthread_mutex_lock(&writer->lock);
+        if (failed) writer->error = 1;
+        slot->state = slot_empty;
+        writer->next_commit++;
+        writer->committing = 0;
+        pthread_cond_broadcast(&writer->slot_free);
+    }
+}
+
+/*! @brief Main function of a worker thread. Claims submitted frames in order and compresses them. */
+static void *xtc_writer_run(void *arg)
+{
+    xtc_out_worker_t *worker = (xtc_out_worker_t *) arg;
+    xtc_writer_t *writer = worker->writer;
+
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        while (!writer->stop && writer->next_claim >= writer->next_submit) {
+            pthread_cond_wait(&writer->frame_queued, &writer->lock);
+        }
+
+        if (writer->next_claim >= writer->next_submit) break;
+
+        xtc_out_slot_t *slot = &(writer->slots[writer->next_claim % writer->queue_size]);
+        writer->next_claim++;
+        slot->state = slot_compressing;
+        pthread_mutex_unlock(&writer->lock);
+
+        int result = xtc_worker_compress(worker, slot);
+
+        pthread_mutex_lock(&writer->lock);
+        slot->result = result;
+        slot->state = slot_compressed;
+        xtc_writer_commit(writer);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+/*! @brief Stops the worker threads, closes the file and deallocates memory for the writer. Returns the result of closing the file. */
+static int xtc_writer_destroy(xtc_writer_t *writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = 1;
+    pthread_cond_broadcast(&writer->frame_queued);
+    pthread_mutex_unlock(&writer->lock);
+
+    for (int i = 0; i < writer->n_running; ++i) {
+        pthread_join(writer->workers[i].thread, NULL);
+    }
+
+    if (writer->workers != NULL) {
+        for (size_t i = 0; i < writer->n_workers; ++i) {
+            if (writer->workers[i].xdr != NULL) xdrfile_close(writer->workers[i].xdr);
+        }
+    }
+
+    if (writer->slots != NULL) {
+        for (size_t i = 0; i < writer->queue_size; ++i) {
+            free(writer->slots[i].coordinates);
+            free(writer->slots[i].data);
+        }
+    }
+
+    int result = writer->file != NULL ? fclose(writer->file) : 0;
+
+    free(writer->workers);
+    free(writer->slots);
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->frame_queued);
+    pthread_cond_destroy(&writer->slot_free);
+    free(writer);
+
+    return result;
+}
+
+xtc_writer_t *xtc_writer_create(const char *filename, const char *mode, size_t n_threads, size_t queue_size)
+{
+    if (n_threads == 0) return NULL;
+    if (queue_size == 0) queue_size = 2 * n_threads;
+
+    const char *file_mode = NULL;
+    if (mode[0] == 'w' || mode[0] == 'W') file_mode = "wb";
+    else if (mode[0] == 'a' || mode[0] == 'A') file_mode = "ab";
+    else return NULL;
+
+    xtc_writer_t *writer = calloc(1, sizeof(xtc_writer_t));
+    if (writer == NULL) return NULL;
+
+    writer->queue_size = queue_size;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->frame_queued, NULL);
+    pthread_cond_init(&writer->slot_free, NULL);
+
+    writer->file = fopen(filename, file_mode);
+    writer->slots = calloc(queue_size, sizeof(xtc_out_slot_t));
+    writer->workers = calloc(n_threads, sizeof(xtc_out_worker_t));
+    if (writer->file == NULL || writer->slots == NULL || writer->workers == NULL) {
+        xtc_writer_destroy(writer);
+        return NULL;
+    }
+
+    writer->n_workers = n_threads;
+    for (size_t i = 0; i < n_threads; ++i) {
+        xtc_out_worker_t *worker = &(writer->workers[i]);
+        worker->writer = writer;
+        worker->xdr = xdrfile_open_output_buffer();
+        if (worker->xdr == NULL) {
+            xtc_writer_destroy(writer);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < n_threads; ++i) {
+        if (pthread_create(&(writer->workers[i].thread), NULL, xtc_writer_run, &(writer->workers[i])) != 0) {
+            xtc_writer_destroy(writer);
+            return NULL;
+        }
+        writer->n_running++;
+    }
+
+    return writer;
+}
+
+int xtc_writer_submit(
+        xtc_writer_t *writer,
+        const atom_selection_t *selection,
+        int step,
+        float time,
+        box_t box,
+        float precision)
+{
+    pthread_mutex_lock(&writer->lock);
+    while (!writer->error && writer->next_submit >= writer->next_commit + writer->queue_size) {
+        pthread_cond_wait(&writer->slot_free, &writer->lock);
+    }
+    if (writer->error) {
+        pthread_mutex_unlock(&writer->lock);
+        return 1;
+    }
+    xtc_out_slot_t *slot = &(writer->slots[writer->next_submit % writer->queue_size]);
+    pthread_mutex_unlock(&writer->lock);
+
+    // workers do not touch the slot until next_submit is increased, so it can be filled without the lock
+    if (selection->n_atoms > slot->coordinates_capacity || slot->coordinates == NULL) {
+        size_t capacity = selection->n_atoms > 0 ? selection->n_atoms : 1;
+        vec_t *new_coordinates = realloc(slot->coordinates, capacity * sizeof(vec_t));
+        if (new_coordinates == NULL) return 1;
+        slot->coordinates = new_coordinates;
+        slot->coordinates_capacity = capacity;
+    }
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        memcpy(slot->coordinates[i], selection->atoms[i]->position, sizeof(vec_t));
+    }
+    slot->n_atoms = selection->n_atoms;
+    slot->step = step;
+    slot->time = time;
+    slot->precision = precision;
+    box_gro2xtc(box, slot->box);
+
+    pthread_mutex_lock(&writer->lock);
+    slot->state = slot_queued;
+    writer->next_submit++;
+    pthread_cond_signal(&writer->frame_queued);
+    pthread_mutex_unlock(&writer->lock);
+
+    return 0;
+}
+
+int xtc_writer_flush(xtc_writer_t *writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    while (writer->next_commit < writer->next_submit) {
+        pthread_cond_wait(&writer->slot_free, &writer->lock);
+    }
+    // no worker is writing into the file now
+    if (fflush(writer->file) != 0) writer->error = 1;
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+
+    return error;
+}
+
+int xtc_writer_close(xtc_writer_t *writer)
+{
+    if (writer == NULL) return 1;
+
+    int error = xtc_writer_flush(writer);
+    error |= xtc_writer_destroy(writer) != 0;
+
+    return error;
+}
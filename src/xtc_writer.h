@@ -0,0 +1,89 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef XTC_WRITER_H
+#define XTC_WRITER_H
+
+#include "gro.h"
+#include "xtc_io.h"
+
+/*! @brief Asynchronous multi-threaded writer of xtc files.
+ *
+ * @paragraph Details
+ * Frames submitted to the writer are copied into a bounded queue of preallocated buffers.
+ * A pool of worker threads compresses the queued frames, each worker using its own compression buffers.
+ * Compressed frames are written into the xtc file strictly in the order in which they were submitted,
+ * so the resulting file is identical to a file written frame by frame using write_xtc_step().
+ * If all buffers of the queue are occupied, submitting a frame waits until the oldest frame is written.
+ * Frames must be submitted from a single thread.
+ *
+ * The structure is opaque; use the functions below to work with it.
+ */
+typedef struct xtc_writer xtc_writer_t;
+
+
+/*! @brief Opens an xtc file for writing and starts the worker threads.
+ *
+ * @paragraph Details
+ * If queue_size is zero, twice the number of threads is used.
+ * Memory for the coordinates of the queued frames is allocated when the frames are submitted
+ * and is reused for the following frames.
+ *
+ * @param filename      path to the xtc file
+ * @param mode          "w" to create a new file or to overwrite an existing file, "a" to append to the file
+ * @param n_threads     number of worker threads (at least 1)
+ * @param queue_size    maximal number of frames waiting to be written
+ *
+ * @return Pointer to the created xtc_writer_t structure. NULL if the file could not be opened
+ * or the writer could not be created.
+ */
+xtc_writer_t *xtc_writer_create(const char *filename, const char *mode, size_t n_threads, size_t queue_size);
+
+
+/*! @brief Submits a frame to be written into the xtc file.
+ *
+ * @paragraph Details
+ * Positions of the atoms of the selection are copied into a free buffer of the queue,
+ * so the selection (and the system) may be changed right after this function returns.
+ * Compression and writing of the frame is done by the worker threads.
+ * Waits only if all buffers of the queue are occupied.
+ *
+ * Like for write_xtc_step(), box is in gro format.
+ *
+ * @param writer        pointer to xtc_writer_t structure
+ * @param selection     atoms to be written
+ * @param step          simulation step of the frame
+ * @param time          simulation time of the frame in ps
+ * @param box           simulation box dimensions
+ * @param precision     precision of the xtc frame
+ *
+ * @return Zero if the frame was submitted. Non-zero if the frame could not be submitted
+ * or if writing of any of the previous frames failed.
+ */
+int xtc_writer_submit(
+        xtc_writer_t *writer,
+        const atom_selection_t *selection,
+        int step,
+        float time,
+        box_t box,
+        float precision);
+
+
+/*! @brief Waits until all submitted frames are written into the xtc file and flushes the file.
+ *
+ * @param writer        pointer to xtc_writer_t structure
+ *
+ * @return Zero if all frames submitted so far have been successfully written, else non-zero.
+ */
+int xtc_writer_flush(xtc_writer_t *writer);
+
+
+/*! @brief Writes all submitted frames, stops the worker threads, closes the xtc file and deallocates the writer.
+ *
+ * @param writer        pointer to xtc_writer_t structure to close
+ *
+ * @return Zero if all frames have been successfully written and the file has been closed, else non-zero.
+ */
+int xtc_writer_close(xtc_writer_t *writer);
+
+#endif /* XTC_WRITER_H */
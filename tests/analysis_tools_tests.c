@@ -564,6 +564,75 @@ static void test_center_of_geometry(void)
     printf("OK\n");
 }
 
+static void test_center_of_geometry_block(void)
+{
+    printf("%-40s", "center_of_geometry_block ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    assert(system_positions_enable(system) == 0);
+    select_t *all = select_system(system);
+
+    select_t *protein = select_atoms(all, "LEU SER", &match_residue_name);
+    select_t *membrane = select_atoms(all, "POPE POPG", &match_residue_name);
+
+    select_t *selections[] = {protein, membrane, all};
+    for (int s = 0; s < 3; ++s) {
+        size_t *indices = selection_get_indices(selections[s], system);
+
+        vec_t center = {0.f};
+        vec_t center_block = {0.f};
+        assert(center_of_geometry(selections[s], center, system->box) == 0);
+        assert(center_of_geometry_block(system->positions, indices, selections[s]->n_atoms, center_block, system->box) == 0);
+        assert(memcmp(center, center_block, sizeof(vec_t)) == 0);
+
+        free(indices);
+    }
+
+    // the whole block without indices
+    vec_t center = {0.f};
+    vec_t center_block = {0.f};
+    center_of_geometry(all, center, system->box);
+    assert(center_of_geometry_block(system->positions, NULL, system->n_atoms, center_block, system->box) == 0);
+    assert(memcmp(center, center_block, sizeof(vec_t)) == 0);
+
+    assert(center_of_geometry_block(system->positions, NULL, 0, center_block, system->box) != 0);
+    assert(center_of_geometry_block(NULL, NULL, 10, center_block, system->box) != 0);
+
+    system_positions_disable(system);
+    free(protein);
+    free(membrane);
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+static void test_distance3D_block(void)
+{
+    printf("%-40s", "distance3D_block ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    assert(system_positions_enable(system) == 0);
+
+    float *distances = malloc(system->n_atoms * sizeof(float));
+    distance3D_block(system->positions, NULL, system->n_atoms, system->atoms[16094].position, system->box, distances);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(distances[i] == distance3D(system->atoms[i].position, system->atoms[16094].position, system->box));
+    }
+    assert(closef(distances[16095], 0.148246, 0.000001));
+
+    size_t indices[] = {42344, 7211};
+    distance3D_block(system->positions, indices, 2, system->atoms[24569].position, system->box, distances);
+    assert(closef(distances[0], 5.772264, 0.000001));
+    assert(distances[1] == distance3D(system->atoms[7211].position, system->atoms[24569].position, system->box));
+
+    free(distances);
+    system_positions_disable(system);
+    free(system);
+    printf("OK\n");
+}
+
 static void test_center_of_geometry_translated(void)
 {
     printf("%-40s", "center_of_geometry (translated) ");
@@ -969,6 +1038,8 @@ void test_analysis_tools(void)
 
     test_center_of_geometry();
     test_center_of_geometry_translated();
+    test_center_of_geometry_block();
+    test_distance3D_block();
     test_center_of_geometry_naive();
     test_smart_center_of_geometry();
 
@@ -130,8 +130,270 @@ static void test_write_gro()
 
 }
 
+/* Reference implementation of write_gro using fprintf. */
+static void reference_write_gro(FILE *stream, const atom_selection_t *atoms, const box_t boxsize, const write_mode_t write_mode, const char *comment)
+{
+    fprintf(stream, "%s\n", comment);
+    fprintf(stream, "%ld\n", atoms->n_atoms);
+
+    for (size_t i = 0; i < atoms->n_atoms; ++i) {
+        atom_t *atom = atoms->atoms[i];
+        fprintf(stream, "%5u%-5s%5s%5u%8.3f%8.3f%8.3f",
+        atom->residue_number, atom->residue_name, atom->atom_name, atom->atom_number,
+        atom->position[0], atom->position[1], atom->position[2]);
+
+        if (write_mode != no_velocities) {
+            fprintf(stream, "%8.4f%8.4f%8.4f", atom->velocity[0], atom->velocity[1], atom->velocity[2]);
+        }
+
+        fprintf(stream, "\n");
+    }
+
+    for (int i = 0; i < 9; ++i) {
+        fprintf(stream, " %9.5f", boxsize[i]);
+    }
+    fprintf(stream, "\n");
+}
+
+/* Checks that two files are byte-identical. */
+static int files_identical(const char *path1, const char *path2)
+{
+    FILE *file1 = fopen(path1, "rb");
+    FILE *file2 = fopen(path2, "rb");
+    int c1 = 0, c2 = 0;
+    do {
+        c1 = fgetc(file1);
+        c2 = fgetc(file2);
+    } while (c1 == c2 && c1 != EOF);
+
+    fclose(file1);
+    fclose(file2);
+    return c1 == c2;
+}
+
+static void test_write_gro_parallel(void)
+{
+    printf("%-40s", "write_gro_parallel ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+
+    // modify some atoms to test unusual values
+    float special[] = {0.0625f, -0.0625f, -0.0004f, -0.0f, 0.00005f, -0.00005f, 1e20f, -123456.789f, 99999.9995f, 1.0f / 0.0f};
+    for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); ++i) {
+        system->atoms[i].position[i % 3] = special[i];
+        system->atoms[i].velocity[(i + 1) % 3] = special[i];
+    }
+    system->atoms[20].residue_number = 4000000000u;
+    strcpy(system->atoms[21].atom_name, "");
+    strcpy(system->atoms[22].residue_name, "ABCDE");
+
+    // random values
+    unsigned int seed = 42;
+    for (size_t i = 100; i < 10100; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            seed = seed * 1103515245u + 12345u;
+            system->atoms[i].position[d] = ((float) (seed >> 8) / (1 << 24) - 0.5f) * 2000.0f;
+            seed = seed * 1103515245u + 12345u;
+            system->atoms[i].velocity[d] = ((float) (seed >> 8) / (1 << 24) - 0.5f) * 0.01f;
+        }
+    }
+
+    box_t box = {0};
+    memcpy(box, system->box, sizeof(box_t));
+    box[5] = -0.000004f;
+
+    write_mode_t modes[] = {velocities, no_velocities};
+    size_t threads[] = {0, 1, 2, 5};
+    for (int m = 0; m < 2; ++m) {
+        FILE *output = fopen("reference.gro", "w");
+        reference_write_gro(output, all, box, modes[m], "Temporary gro file.");
+        fclose(output);
+
+        output = fopen("temporary.gro", "w");
+        assert(write_gro(output, all, box, modes[m], "Temporary gro file.") == 0);
+        fclose(output);
+        assert(files_identical("reference.gro", "temporary.gro"));
+
+        for (int t = 0; t < 4; ++t) {
+            output = fopen("temporary.gro", "w");
+            assert(write_gro_parallel(output, all, box, modes[m], "Temporary gro file.", threads[t]) == 0);
+            fclose(output);
+            assert(files_identical("reference.gro", "temporary.gro"));
+        }
+    }
+
+    remove("reference.gro");
+    remove("temporary.gro");
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+static void test_load_gro_parallel(void)
+{
+    printf("%-40s", "load_gro_parallel ");
+    fflush(stdout);
+
+    system_t *reference = load_gro(INPUT_GRO_FILE);
+    size_t size = sizeof(system_t) + reference->n_atoms * sizeof(atom_t);
+
+    size_t threads[] = {1, 2, 3, 7, 16};
+    for (int t = 0; t < 5; ++t) {
+        system_t *system = load_gro_parallel(INPUT_GRO_FILE, threads[t]);
+        assert(system != NULL);
+        assert(memcmp(system, reference, size) == 0);
+        free(system);
+    }
+
+    // file with atom lines of different length (velocities missing for one atom) is read line by line
+    FILE *input = fopen(INPUT_GRO_FILE, "r");
+    FILE *output = fopen("temporary.gro", "w");
+    char line[1024] = "";
+    for (size_t i = 0; fgets(line, 1024, input) != NULL; ++i) {
+        if (i == 1002) strcpy(line + 44, "\n");
+        fputs(line, output);
+    }
+    fclose(input);
+    fclose(output);
+
+    system_t *irregular = load_gro_parallel("temporary.gro", 4);
+    assert(irregular != NULL);
+    assert(irregular->n_atoms == reference->n_atoms);
+    assert(irregular->atoms[1000].velocity[0] == 0.0f);
+    assert(irregular->atoms[1000].position[0] == reference->atoms[1000].position[0]);
+    assert(memcmp(&(irregular->atoms[1001]), &(reference->atoms[1001]), (reference->n_atoms - 1001) * sizeof(atom_t)) == 0);
+    free(irregular);
+
+    // truncated file
+    input = fopen(INPUT_GRO_FILE, "r");
+    output = fopen("temporary.gro", "w");
+    for (size_t i = 0; i < 5000 && fgets(line, 1024, input) != NULL; ++i) fputs(line, output);
+    fclose(input);
+    fclose(output);
+    assert(load_gro_parallel("temporary.gro", 2) == NULL);
+
+    remove("temporary.gro");
+    free(reference);
+    printf("OK\n");
+}
+
+/* Reference implementations of the segment parsers (slicing the segment and using the library functions). */
+static int reference_parse_int(const char *line, size_t start, size_t len, groint_t *element)
+{
+    char segment[64] = "";
+    get_fragment(line, segment, start, len);
+    if (!isdecimal(segment)) return 1;
+    *element = (groint_t) atoi(segment);
+    return 0;
+}
+
+static int reference_parse_float(const char *line, size_t start, size_t len, float *element)
+{
+    char segment[64] = "";
+    get_fragment(line, segment, start, len);
+    if (!isdecimalf(segment)) return 1;
+    *element = atof(segment);
+    return 0;
+}
+
+static void test_parse_segments(void)
+{
+    printf("%-40s", "parse_int/parse_float/parse_string ");
+    fflush(stdout);
+
+    const char *cases[] = {
+        "   1.234", "  -0.000", "-   1.00", "  12.345", "1.5 3.25", "   -.5  ", "    5.  ", "       .",
+        "       -", "        ", "5-      ", "  +1.001", "1.2.3   ", "--1     ", "  1e5   ", "\t 3.141 ",
+        "99999.99", "-9999.99", "0.000001", "   10\n  ", "12345678", "  -12   ", "  1 2   ", ""
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        char line[32] = "";
+        strcpy(line, cases[c]);
+
+        for (size_t len = 0; len <= 8; ++len) {
+            groint_t int1 = 7, int2 = 7;
+            assert(parse_int(line, 0, len, &int1) == reference_parse_int(line, 0, len, &int2));
+            assert(int1 == int2);
+
+            float float1 = 7.0f, float2 = 7.0f;
+            assert(parse_float(line, 0, len, &float1) == reference_parse_float(line, 0, len, &float2));
+            assert(memcmp(&float1, &float2, sizeof(float)) == 0);
+
+            char string1[16] = "old", string2[16] = "old";
+            char segment[16] = "";
+            get_fragment(line, segment, 0, len);
+            sscanf(segment, "%s", string2);
+            assert(parse_string(line, 0, len, string1) == 0);
+            assert(!strcmp(string1, string2));
+        }
+    }
+
+    // random segments
+    const char alphabet[] = " 0123456789.+-a\t";
+    unsigned int seed = 12345;
+    for (int n = 0; n < 200000; ++n) {
+        char line[16] = "";
+        for (int i = 0; i < 8; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            // strongly prefer digits to get many valid segments
+            unsigned int r = (seed >> 16) % 32;
+            line[i] = r < 16 ? alphabet[1 + r % 10] : alphabet[r % (sizeof(alphabet) - 1)];
+        }
+
+        groint_t int1 = 7, int2 = 7;
+        assert(parse_int(line, 3, 5, &int1) == reference_parse_int(line, 3, 5, &int2));
+        assert(int1 == int2);
+
+        float float1 = 7.0f, float2 = 7.0f;
+        assert(parse_float(line, 0, 8, &float1) == reference_parse_float(line, 0, 8, &float2));
+        assert(memcmp(&float1, &float2, sizeof(float)) == 0);
+    }
+
+    printf("OK\n");
+}
+
+static void test_system_positions(void)
+{
+    printf("%-40s", "system_positions ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    assert(system->positions == NULL);
+
+    assert(system_positions_enable(system) == 0);
+    assert(system->positions != NULL);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(memcmp(system->positions[i], system->atoms[i].position, sizeof(vec_t)) == 0);
+    }
+
+    // changes of the block are only visible in the atoms after syncing
+    system->positions[7][1] = 123.0f;
+    assert(system->atoms[7].position[1] != 123.0f);
+    system_positions_sync(system);
+    assert(system->atoms[7].position[1] == 123.0f);
+
+    system->positions[8][2] = 321.0f;
+    system_positions_disable(system);
+    assert(system->positions == NULL);
+    assert(system->atoms[8].position[2] == 321.0f);
+
+    // disabling and syncing without the block does nothing
+    system_positions_disable(system);
+    system_positions_sync(system);
+
+    free(system);
+    printf("OK\n");
+}
+
 void test_gro_io(void) 
 {
     test_load_gro();
+    test_load_gro_parallel();
+    test_parse_segments();
     test_write_gro();
+    test_write_gro_parallel();
+    test_system_positions();
 }
\ No newline at end of file
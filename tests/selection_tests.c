@@ -212,6 +212,33 @@ static void test_select_system(void)
     printf("OK\n");
 }
 
+static void test_selection_get_indices(void)
+{
+    printf("%-40s", "selection_get_indices ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    select_t *membrane = select_atoms(all, "POPE POPG", &match_residue_name);
+
+    size_t *indices = selection_get_indices(membrane, system);
+    for (size_t i = 0; i < membrane->n_atoms; ++i) {
+        assert(&(system->atoms[indices[i]]) == membrane->atoms[i]);
+    }
+    free(indices);
+
+    select_t *empty = selection_create(1);
+    indices = selection_get_indices(empty, system);
+    assert(indices != NULL);
+    free(indices);
+
+    free(empty);
+    free(membrane);
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
 static void test_selection_copy(void)
 {
     printf("%-40s", "selection_copy ");
@@ -926,6 +953,181 @@ static void test_selection_unique(void)
     printf("OK\n");
 }
 
+static void test_atom_bitmap(void)
+{
+    printf("%-40s", "atom_bitmap ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+
+    select_t *leu = select_atoms(all, "LEU", &match_residue_name);
+    select_t *ca = select_atoms(all, "CA", &match_atom_name);
+
+    atom_bitmap_t *leu_bitmap = atom_bitmap_from_selection(leu, system);
+    atom_bitmap_t *ca_bitmap = atom_bitmap_from_selection(ca, system);
+    assert(atom_bitmap_count(leu_bitmap) == leu->n_atoms);
+    assert(atom_bitmap_contains(leu_bitmap, leu->atoms[3]));
+    assert(!match_residue_name(&(system->atoms[system->n_atoms - 1]), "LEU"));
+    assert(!atom_bitmap_contains(leu_bitmap, &(system->atoms[system->n_atoms - 1])));
+
+    // leucine CA atoms
+    atom_bitmap_t *bitmap = atom_bitmap_create(system->atoms, system->n_atoms);
+    assert(atom_bitmap_union(bitmap, leu_bitmap) == 0);
+    assert(atom_bitmap_intersect(bitmap, ca_bitmap) == 0);
+    select_t *result = atom_bitmap_to_selection(bitmap);
+    select_t *expected = selection_intersect(leu, ca);
+    assert(result->n_atoms == 12);
+    assert(selection_compare_strict(result, expected));
+    free(result);
+    free(expected);
+
+    // leucine atoms other than CA
+    assert(atom_bitmap_union(bitmap, leu_bitmap) == 0);
+    assert(atom_bitmap_difference(bitmap, ca_bitmap) == 0);
+    assert(atom_bitmap_count(bitmap) == leu->n_atoms - 12);
+
+    // everything except leucine atoms other than CA
+    atom_bitmap_complement(bitmap);
+    assert(atom_bitmap_count(bitmap) == system->n_atoms - leu->n_atoms + 12);
+    atom_bitmap_complement(bitmap);
+    assert(atom_bitmap_count(bitmap) == leu->n_atoms - 12);
+
+    // bitmaps covering different atoms cannot be combined
+    atom_bitmap_t *small = atom_bitmap_create(system->atoms, 100);
+    assert(atom_bitmap_add(small, &(system->atoms[99])) == 0);
+    assert(atom_bitmap_add(small, &(system->atoms[100])) != 0);
+    assert(!atom_bitmap_contains(small, &(system->atoms[100])));
+    assert(atom_bitmap_union(bitmap, small) != 0);
+    atom_bitmap_complement(small);
+    assert(atom_bitmap_count(small) == 99);
+
+    // atoms of other systems
+    system_t *other = load_gro(INPUT_GRO_FILE);
+    select_t *other_all = select_system(other);
+    assert(atom_bitmap_from_selection(other_all, system) == NULL);
+
+    free(other_all);
+    free(other);
+    free(small);
+    free(bitmap);
+    free(leu_bitmap);
+    free(ca_bitmap);
+    free(leu);
+    free(ca);
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+/* Reference implementations of set operations on selections comparing every pair of atoms. */
+static select_t *reference_cat_unique(const select_t *selection1, const select_t *selection2)
+{
+    select_t *output = selection_copy(selection1);
+    output = realloc(output, sizeof(select_t) + (selection1->n_atoms + selection2->n_atoms) * sizeof(atom_t *));
+    for (size_t i = 0; i < selection2->n_atoms; ++i) {
+        int duplicate = 0;
+        for (size_t j = 0; j < selection1->n_atoms; ++j) duplicate |= selection2->atoms[i] == selection1->atoms[j];
+        if (!duplicate) output->atoms[output->n_atoms++] = selection2->atoms[i];
+    }
+    return output;
+}
+
+static select_t *reference_intersect(const select_t *selection1, const select_t *selection2)
+{
+    select_t *output = selection_create(selection1->n_atoms * (selection2->n_atoms + 1));
+    for (size_t i = 0; i < selection1->n_atoms; ++i) {
+        for (size_t j = 0; j < selection2->n_atoms; ++j) {
+            if (selection1->atoms[i] == selection2->atoms[j]) output->atoms[output->n_atoms++] = selection1->atoms[i];
+        }
+    }
+    return output;
+}
+
+static size_t reference_unique(select_t *selection)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        int duplicate = 0;
+        for (size_t j = 0; j < kept; ++j) duplicate |= selection->atoms[i] == selection->atoms[j];
+        if (!duplicate) selection->atoms[kept++] = selection->atoms[i];
+    }
+    size_t removed = selection->n_atoms - kept;
+    selection->n_atoms = kept;
+    return removed;
+}
+
+/* Creates a selection of random atoms of the system, possibly with duplicates and atoms of another system. */
+static select_t *random_selection(system_t *system, system_t *other, size_t n_atoms, size_t range)
+{
+    select_t *selection = selection_create(n_atoms);
+    for (size_t i = 0; i < n_atoms; ++i) {
+        system_t *source = (other != NULL && rand() % 10 == 0) ? other : system;
+        selection->atoms[i] = &(source->atoms[(size_t) rand() % range]);
+    }
+    selection->n_atoms = n_atoms;
+    return selection;
+}
+
+static void test_selection_set_operations(void)
+{
+    printf("%-40s", "selection set operations (bitmap) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    system_t *other = load_gro(INPUT_GRO_FILE);
+
+    srand(42);
+    for (int round = 0; round < 200; ++round) {
+        // small ranges produce many duplicates, large ranges sparse selections
+        size_t range = round % 2 == 0 ? 50 : system->n_atoms;
+        select_t *selection1 = random_selection(system, round % 4 == 3 ? other : NULL, (size_t) rand() % 300, range);
+        select_t *selection2 = random_selection(system, round % 8 == 5 ? other : NULL, (size_t) rand() % 300, range);
+        if (round % 3 == 0) selection_unique(selection2);
+
+        select_t *result = selection_cat_unique(selection1, selection2);
+        select_t *expected = reference_cat_unique(selection1, selection2);
+        assert(selection_compare_strict(result, expected));
+        free(result);
+        free(expected);
+
+        result = selection_intersect(selection1, selection2);
+        expected = reference_intersect(selection1, selection2);
+        assert(selection_compare_strict(result, expected));
+        free(result);
+        free(expected);
+
+        assert(selection_compare(selection1, selection2) == selection_compare(selection2, selection1));
+        select_t *copy = selection_copy(selection1);
+        selection_reverse(copy);
+        assert(selection_compare(selection1, copy));
+        free(copy);
+
+        result = selection_copy(selection1);
+        expected = selection_copy(selection1);
+        // the legacy function returns the size of the intersection, not the number of removed atoms
+        assert(selection_remove(result, selection2) == selection1->n_atoms - result->n_atoms);
+        selection_remove_legacy(expected, selection2);
+        assert(selection_compare_strict(result, expected));
+        free(result);
+        free(expected);
+
+        result = selection_copy(selection1);
+        expected = selection_copy(selection1);
+        assert(selection_unique(result) == reference_unique(expected));
+        assert(selection_compare_strict(result, expected));
+        free(result);
+        free(expected);
+
+        free(selection1);
+        free(selection2);
+    }
+
+    free(system);
+    free(other);
+    printf("OK\n");
+}
+
 static void test_selection_renumber(void)
 {
     printf("%-40s", "selection_renumber ");
@@ -1377,6 +1579,21 @@ static void test_selection_getresnames(void)
     assert(list_index(all_resnames, "NAH") < 0);
     assert(list_index(all_resnames, "NONEXISTENT") < 0);
 
+    // residue names alternating from atom to atom are listed in the order of their first occurrence
+    select_t *mixed = selection_create(all->n_atoms);
+    for (size_t i = 0; i < all->n_atoms; ++i) mixed->atoms[i] = all->atoms[(i * 7919) % all->n_atoms];
+    mixed->n_atoms = all->n_atoms;
+    list_t *mixed_resnames = selection_getresnames(mixed);
+    list_t *expected = list_create();
+    for (size_t i = 0; i < mixed->n_atoms; ++i) {
+        if (list_index(expected, mixed->atoms[i]->residue_name) < 0) list_append(&expected, mixed->atoms[i]->residue_name);
+    }
+    assert(mixed_resnames->n_items == 8 && expected->n_items == 8);
+    for (size_t i = 0; i < expected->n_items; ++i) assert(!strcmp(list_get(mixed_resnames, i), list_get(expected, i)));
+    list_destroy(mixed_resnames);
+    list_destroy(expected);
+    free(mixed);
+
     list_destroy(all_resnames);
     free(all);
     free(system);
@@ -2579,6 +2796,326 @@ static void test_smart_select_parentheses_fails(void)
     printf("OK\n");
 }
 
+static void test_smart_select_large_ranges(void)
+{
+    printf("%-40s", "smart_select (large ranges) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+
+    // ranges are evaluated as intervals, so their length does not matter
+    select_t *serial = smart_select(all, "serial 1 to 2000000", NULL);
+    assert(selection_compare_strict(serial, all));
+    free(serial);
+
+    select_t *serial_not = smart_select(all, "not serial 0 - 2000000000", NULL);
+    assert(serial_not->n_atoms == 0);
+    free(serial_not);
+
+    select_t *resid = smart_select(all, "resid 1000 to 100000 && not resid 2000 to 99999", NULL);
+    size_t expected = 0;
+    for (size_t i = 0; i < all->n_atoms; ++i) {
+        groint_t number = all->atoms[i]->residue_number;
+        if ((number >= 1000 && number < 2000) || number == 100000) {
+            assert(expected < resid->n_atoms && resid->atoms[expected] == all->atoms[i]);
+            ++expected;
+        }
+    }
+    assert(resid->n_atoms == expected && expected > 0);
+    free(resid);
+
+    // overlapping ranges and single numbers
+    select_t *overlapping = smart_select(all, "resid 1 to 5 3 - 8 7 12 to 12", NULL);
+    select_t *listed = smart_select(all, "resid 1 2 3 4 5 6 7 8 12", NULL);
+    assert(selection_compare_strict(overlapping, listed));
+    free(overlapping);
+    free(listed);
+
+    // the same with the topology index
+    assert(system_topology_enable(system) == 0);
+    select_t *serial_indexed = smart_select(all, "serial 1 to 2000000", NULL);
+    assert(selection_compare_strict(serial_indexed, all));
+    free(serial_indexed);
+
+    select_t *serial_part = smart_select(all, "serial 100 to 199 or serial 48200 - 2000000", NULL);
+    assert(serial_part->n_atoms == 100 + 85);
+    for (size_t i = 0; i < 100; ++i) assert(serial_part->atoms[i] == all->atoms[99 + i]);
+    free(serial_part);
+    system_topology_disable(system);
+
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+static void test_topology_index(void)
+{
+    printf("%-40s", "topology_index ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+
+    topology_index_t *index = topology_index_create(system);
+    assert(index != NULL);
+
+    // lookups return the same atoms as matching every atom
+    const char *resnames[] = { "POPE", "SOL", "LEU", "NOPE" };
+    for (size_t i = 0; i < 4; ++i) {
+        select_t *matched = select_atoms(all, resnames[i], &match_residue_name);
+        const size_t *atoms = NULL;
+        assert(topology_index_resname(index, resnames[i], &atoms) == matched->n_atoms);
+        for (size_t j = 0; j < matched->n_atoms; ++j) assert(matched->atoms[j] == &(system->atoms[atoms[j]]));
+        free(matched);
+    }
+
+    const size_t *atoms = NULL;
+    assert(topology_index_name(index, "P", &atoms) == 168);
+    for (size_t j = 0; j < 168; ++j) assert(!strcmp(system->atoms[atoms[j]].atom_name, "P"));
+    assert(topology_index_name(index, "XYZ", &atoms) == 0 && atoms == NULL);
+
+    const topology_range_t *ranges = NULL;
+    size_t n_ranges = topology_index_resid(index, 65, &ranges);
+    select_t *resid = select_atoms(all, "65", &match_residue_num);
+    size_t n_resid = 0;
+    for (size_t r = 0; r < n_ranges; ++r) {
+        assert(ranges[r].residue_number == 65);
+        for (size_t j = ranges[r].start; j < ranges[r].end; ++j) assert(resid->atoms[n_resid++] == &(system->atoms[j]));
+    }
+    assert(n_resid == resid->n_atoms);
+    free(resid);
+
+    const topology_serial_t *serials = NULL;
+    assert(topology_index_serial(index, 43243, &serials) == 1);
+    assert(system->atoms[serials[0].atom].gmx_atom_number == 43243);
+    assert(topology_index_serial(index, 0, &serials) == 0 && serials == NULL);
+    assert(topology_index_serial(index, 48285, &serials) == 0);
+
+    topology_index_destroy(index);
+
+    // selections are the same with and without the enabled index
+    const char *queries[] = { "resname POPE POPG", "name P CA or resid 100 to 200", "not serial 1 to 5000 && resname SOL",
+                              "resid 1 2 3 4 5 and not name CA", "(resname SOL and name OW) or serial 48284 1" };
+    select_t *inputs[3] = { all, selection_slice(all, 1000, 30000), NULL };
+    inputs[2] = selection_cat(inputs[1], all);
+    select_t *expected[5][3] = { { NULL } };
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t k = 0; k < 3; ++k) expected[i][k] = smart_select(inputs[k], queries[i], NULL);
+    }
+
+    assert(system->topology == NULL);
+    assert(system_topology_enable(system) == 0);
+    assert(system_topology(system) != NULL && system_topology(system) == system->topology);
+    // enabling the index again rebuilds it
+    assert(system_topology_enable(system) == 0);
+
+    for (size_t i = 0; i < 5; ++i) {
+        selection_query_t *compiled = query_compile(queries[i], NULL);
+        for (size_t k = 0; k < 3; ++k) {
+            select_t *selection = smart_select_system(inputs[k], queries[i], NULL, system);
+            assert(selection_compare_strict(selection, expected[i][k]));
+            free(selection);
+            selection = query_eval_system(compiled, inputs[k], system);
+            assert(selection_compare_strict(selection, expected[i][k]));
+            free(selection);
+            free(expected[i][k]);
+        }
+        query_destroy(compiled);
+    }
+
+    // atoms of another system are matched without the index
+    system_t *other = load_gro(INPUT_GRO_FILE);
+    select_t *other_all = select_system(other);
+    select_t *other_expected = smart_select(other_all, queries[1], NULL);
+    select_t *other_selected = smart_select_system(other_all, queries[1], NULL, system);
+    assert(other_selected->n_atoms > 0);
+    assert(selection_compare_strict(other_selected, other_expected));
+    free(other_selected);
+    free(other_expected);
+    free(other_all);
+    free(other);
+
+    select_t *pope = select_atoms_system(inputs[1], "POPE POPG", &match_residue_name, system);
+    select_t *pope_ref = selection_cat_unique_d(select_atoms(inputs[1], "POPE", &match_residue_name), select_atoms(inputs[1], "POPG", &match_residue_name));
+    assert(pope->n_atoms > 0);
+    assert(selection_compare_strict(pope, pope_ref));
+    free(pope);
+    free(pope_ref);
+
+    system_topology_disable(system);
+    assert(system_topology(system) == NULL);
+    system_topology_disable(system);
+
+    free(inputs[1]);
+    free(inputs[2]);
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+static void test_packed_names(void)
+{
+    printf("%-40s", "packed names ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+
+    // atoms are selected by their current names
+    select_t *before = smart_select(all, "resname NEWR", NULL);
+    assert(before->n_atoms == 0);
+    free(before);
+
+    strcpy(system->atoms[0].residue_name, "NEWR");
+    strcpy(system->atoms[3].atom_name, "NEWA");
+    select_t *renamed = smart_select(all, "resname NEWR or name NEWA", NULL);
+    assert(renamed->n_atoms == 2);
+    assert(renamed->atoms[0] == &(system->atoms[0]) && renamed->atoms[1] == &(system->atoms[3]));
+    free(renamed);
+
+    select_t *matched = select_atoms(all, "NEWR", &match_residue_name);
+    assert(matched->n_atoms == 1 && matched->atoms[0] == &(system->atoms[0]));
+    free(matched);
+
+    list_t *resnames = selection_getresnames(all);
+    assert(resnames->n_items == 9);
+    assert(!strcmp(list_get(resnames, 0), "NEWR"));
+    assert(list_index(resnames, "LEU") == 1);
+    list_destroy(resnames);
+
+    // bytes after the 0-terminator are ignored
+    strcpy(system->atoms[0].residue_name, "POPE");
+    strcpy(system->atoms[0].residue_name, "NA");
+    select_t *na = select_atoms(all, "NA", &match_residue_name);
+    assert(na->atoms[0] == &(system->atoms[0]));
+    select_t *na_strcmp = selection_create(system->n_atoms);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        if (!strcmp(system->atoms[i].residue_name, "NA")) na_strcmp->atoms[na_strcmp->n_atoms++] = &(system->atoms[i]);
+    }
+    assert(selection_compare_strict(na, na_strcmp));
+    free(na);
+    free(na_strcmp);
+
+    // names longer than 5 characters match no atom
+    strcpy(system->atoms[0].residue_name, "LONGN");
+    select_t *longer = smart_select(all, "resname LONGNA LONGN", NULL);
+    assert(longer->n_atoms == 1);
+    free(longer);
+    longer = smart_select(all, "resname LONGNA", NULL);
+    assert(longer->n_atoms == 0);
+    free(longer);
+
+    // atoms parsed outside of load_gro are matched as well
+    atom_t *atoms = malloc(2 * sizeof(atom_t));
+    memset(atoms, 0xab, 2 * sizeof(atom_t));
+    char line1[100] = "    1POPE     P    1   1.000   2.000   3.000";
+    char line2[100] = "    1POPE    C1    2   1.000   2.000   3.000";
+    assert(parse_gro_line(line1, &atoms[0]) == 0);
+    assert(parse_gro_line(line2, &atoms[1]) == 0);
+    select_t *parsed = selection_create(2);
+    parsed->atoms[0] = &atoms[0];
+    parsed->atoms[1] = &atoms[1];
+    parsed->n_atoms = 2;
+    select_t *p = smart_select(parsed, "resname POPE and name P", NULL);
+    assert(p->n_atoms == 1 && p->atoms[0] == &atoms[0]);
+    free(p);
+    free(parsed);
+    free(atoms);
+
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+static void test_query_compile(void)
+{
+    printf("%-40s", "query_compile ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    select_t *subset = selection_slice(all, 1000, 30000);
+    dict_t *ndx_groups = read_ndx(NDX_FILE, system);
+
+    // compiled query selects the same atoms as the query built from simple selections
+    selection_query_t *query = query_compile("(resname POPE and name P) or not (resid 1 to 200 || serial 40000 - 48284)", ndx_groups);
+    assert(query != NULL);
+    for (int i = 0; i < 3; ++i) {
+        select_t *input = (i == 1) ? subset : all;
+
+        select_t *phosphates = select_atoms_d(select_atoms(input, "POPE", &match_residue_name), "P", &match_atom_name);
+
+        select_t *evaluated = query_eval(query, input);
+        select_t *smart = smart_select(input, "(resname POPE and name P) or not (resid 1 to 200 || serial 40000 - 48284)", ndx_groups);
+        assert(evaluated != NULL);
+        assert(selection_compare_strict(evaluated, smart));
+
+        // every phosphate is selected, every selected atom is either a phosphate or outside the excluded region
+        for (size_t j = 0; j < phosphates->n_atoms; ++j) assert(selection_isin(evaluated, phosphates->atoms[j]));
+        for (size_t j = 0; j < evaluated->n_atoms; ++j) {
+            const atom_t *atom = evaluated->atoms[j];
+            int in_region = (atom->residue_number >= 1 && atom->residue_number <= 200) ||
+                            (atom->gmx_atom_number >= 40000 && atom->gmx_atom_number <= 48284);
+            assert(!in_region || (!strcmp(atom->residue_name, "POPE") && !strcmp(atom->atom_name, "P")));
+            assert(selection_isin(input, (atom_t *) atom));
+        }
+
+        free(phosphates);
+        free(evaluated);
+        free(smart);
+    }
+    query_destroy(query);
+
+    // ndx groups are copied into the compiled query; queries made of ndx groups only are evaluated once
+    selection_query_t *groups = query_compile("(POPE or POPG) and not W_ION or (ION && Membrane)", ndx_groups);
+    selection_query_t *static_groups = query_compile("(POPE || POPG) and Membrane", ndx_groups);
+    select_t *expected_groups = smart_select(all, "(POPE or POPG) and not W_ION or (ION && Membrane)", ndx_groups);
+    select_t *expected_static = selection_cat_unique(dict_get(ndx_groups, "POPE"), dict_get(ndx_groups, "POPG"));
+    assert(groups != NULL && static_groups != NULL);
+    assert(query_compile("Nonexistent", ndx_groups) == NULL);
+    dict_destroy(ndx_groups);
+
+    for (int i = 0; i < 3; ++i) {
+        select_t *evaluated = query_eval(groups, all);
+        assert(selection_compare_strict(evaluated, expected_groups));
+        free(evaluated);
+
+        // result of a query independent of the input selection does not change with the input selection
+        select_t *evaluated_static = query_eval(static_groups, (i == 1) ? subset : all);
+        assert(selection_compare_strict(evaluated_static, expected_static));
+        free(evaluated_static);
+    }
+
+    free(expected_groups);
+    free(expected_static);
+    query_destroy(groups);
+    query_destroy(static_groups);
+
+    // NULL query selects all atoms
+    selection_query_t *null_query = query_compile(NULL, NULL);
+    select_t *evaluated_null = query_eval(null_query, subset);
+    assert(selection_compare_strict(evaluated_null, subset));
+    assert(query_eval(null_query, NULL) == NULL);
+    assert(query_eval(NULL, subset) == NULL);
+    free(evaluated_null);
+    query_destroy(null_query);
+    query_destroy(NULL);
+
+    // syntax errors are reported during compilation
+    assert(query_compile("((resname SOL)", NULL) == NULL);
+    assert(query_compile("resname POPE &&", NULL) == NULL);
+    assert(query_compile("(resname POPE)&&(name P)", NULL) == NULL);
+    assert(query_compile("resid 10 to 5", NULL) == NULL);
+    assert(query_compile("POPE", NULL) == NULL);
+    assert(query_compile("resname (POPE && resid 55 to 60)", NULL) == NULL);
+
+    free(system);
+    free(all);
+    free(subset);
+    printf("OK\n");
+}
+
 static void test_smart_geometry(void)
 {
     printf("%-40s", "smart_geometry ");
@@ -2859,6 +3396,7 @@ void test_selection(void)
 
     test_selection_create();
     test_select_system();
+    test_selection_get_indices();
     test_selection_copy();
     test_selection_empty();
     test_selection_add_atom();
@@ -2899,6 +3437,8 @@ void test_selection(void)
     test_selection_compare_strict_empty();
     
     test_selection_unique();
+    test_atom_bitmap();
+    test_selection_set_operations();
     test_selection_renumber();
     test_selection_renumber_large();
 
@@ -2938,6 +3478,10 @@ void test_selection(void)
     test_smart_select_advanced_fails();
     test_smart_select_parentheses();
     test_smart_select_parentheses_fails();
+    test_smart_select_large_ranges();
+    test_query_compile();
+    test_topology_index();
+    test_packed_names();
 
     test_smart_geometry();
     test_smart_geometry_null();
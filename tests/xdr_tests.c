@@ -4,6 +4,7 @@
 /* This file contains test functions for xtc and trr input/output. */
 
 #include "tests.h"
+#include "xdrfile_testing.h"
 
 /* Simple function wrapping a coordinate into a simulation box. */
 static inline void wrap_coordinate(float *x, const float dimension)
@@ -460,6 +461,1442 @@ void test_write_trr_step_full(void)
     remove("temporary.trr");
 }
 
+void test_traj_reader_xtc(void)
+{
+    printf("%-40s", "traj_reader (xtc) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *xtc_copy = xdrfile_open(INPUT_XTC_FILE, "r");
+
+    traj_reader_t *reader = traj_reader_create(xtc, system, traj_xtc);
+    assert(reader != NULL);
+    assert(reader->velocities == NULL);
+    assert(reader->forces == NULL);
+
+    size_t n_frames = 0;
+    while (traj_reader_read(reader) == 0) {
+        assert(read_xtc_step(xtc_copy, system_copy) == 0);
+
+        assert(system->step == system_copy->step);
+        assert(system->time == system_copy->time);
+        assert(system->precision == system_copy->precision);
+        assert(memcmp(system->box, system_copy->box, sizeof(box_t)) == 0);
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+        }
+        ++n_frames;
+    }
+
+    assert(read_xtc_step(xtc_copy, system_copy) != 0);
+    assert(n_frames == 21);
+    assert(system->step == 20000);
+    assert(closef(system->atoms[48283].position[0], 1.78, 0.00001));
+
+    traj_reader_destroy(reader);
+    xdrfile_close(xtc);
+    xdrfile_close(xtc_copy);
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+void test_traj_reader_trr(void)
+{
+    printf("%-40s", "traj_reader (trr) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    int natoms = (int) system->n_atoms;
+
+    vec_t *coordinates = malloc(system->n_atoms * sizeof(vec_t));
+    vec_t *velocities  = malloc(system->n_atoms * sizeof(vec_t));
+    vec_t *forces      = malloc(system->n_atoms * sizeof(vec_t));
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            coordinates[i][j] = system->atoms[i].position[j];
+            velocities[i][j]  = system->atoms[i].velocity[j];
+            forces[i][j]      = (float) i + j;
+        }
+    }
+
+    float box[3][3] = {{0}};
+    box_gro2xtc(system->box, box);
+
+    // first frame contains everything, second frame lacks velocities, third frame only contains forces
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    assert(write_trr(output, natoms, 0, 0.0, 0.0, box, coordinates, velocities, forces) == exdrOK);
+    assert(write_trr(output, natoms, 10, 1.0, 0.5, box, coordinates, NULL, forces) == exdrOK);
+    assert(write_trr(output, natoms, 20, 2.0, 1.0, box, NULL, NULL, forces) == exdrOK);
+    xdrfile_close(output);
+
+    XDRFILE *trr = xdrfile_open("temporary.trr", "r");
+    traj_reader_t *reader = traj_reader_create(trr, system, traj_trr);
+    assert(reader != NULL);
+
+    assert(traj_reader_read(reader) == 0);
+    assert(system->step == 0);
+    assert(closef(system->box[0], 7.25725, 0.00001));
+    assert(closef(system->atoms[10004].position[0], coordinates[10004][0], 0.00001));
+    assert(closef(system->atoms[10004].velocity[1], velocities[10004][1], 0.00001));
+    assert(closef(system->atoms[10004].force[2], 10006.0, 0.01));
+
+    assert(traj_reader_read(reader) == 0);
+    assert(system->step == 10);
+    assert(closef(system->time, 1.0, 0.00001));
+    assert(closef(system->lambda, 0.5, 0.00001));
+    assert(closef(system->atoms[48283].position[2], coordinates[48283][2], 0.00001));
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(vec_len(system->atoms[i].velocity) == 0.0);
+    }
+    assert(closef(system->atoms[48283].force[0], 48283.0, 0.01));
+
+    assert(traj_reader_read(reader) == 0);
+    assert(system->step == 20);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(vec_len(system->atoms[i].position) == 0.0);
+        assert(vec_len(system->atoms[i].velocity) == 0.0);
+    }
+    assert(closef(system->atoms[1].force[1], 2.0, 0.00001));
+
+    assert(traj_reader_read(reader) != 0);
+
+    traj_reader_destroy(reader);
+    xdrfile_close(trr);
+    remove("temporary.trr");
+    free(coordinates);
+    free(velocities);
+    free(forces);
+    free(system);
+    printf("OK\n");
+}
+
+void test_build_xtc_index(void)
+{
+    printf("%-40s", "build_xtc_index ");
+    fflush(stdout);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_index_t *index = build_xtc_index(xtc);
+    assert(index != NULL);
+    assert(index->n_frames == 21);
+    assert(index->frames[0].offset == 0);
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        assert(index->frames[i].step == (int) i * 1000);
+        assert(closef(index->frames[i].time, (float) i * 2, 0.00001));
+        if (i > 0) assert(index->frames[i].offset > index->frames[i - 1].offset);
+    }
+    // position in the file is unchanged
+    assert(xdr_tell(xtc) == 0);
+
+    // copy the file without the second half of the last frame
+    int64_t truncated_size = index->frames[20].offset + 1000;
+    char *buffer = malloc(truncated_size);
+    FILE *input = fopen(INPUT_XTC_FILE, "rb");
+    assert(fread(buffer, 1, truncated_size, input) == (size_t) truncated_size);
+    fclose(input);
+    FILE *output = fopen("temporary.xtc", "wb");
+    assert(fwrite(buffer, 1, truncated_size, output) == (size_t) truncated_size);
+    fclose(output);
+    free(buffer);
+
+    XDRFILE *truncated = xdrfile_open("temporary.xtc", "r");
+    traj_index_t *truncated_index = build_xtc_index(truncated);
+    assert(truncated_index != NULL);
+    assert(truncated_index->n_frames == 20);
+    assert(truncated_index->frames[19].offset == index->frames[19].offset);
+
+    traj_index_destroy(truncated_index);
+    xdrfile_close(truncated);
+    remove("temporary.xtc");
+
+    traj_index_destroy(index);
+    xdrfile_close(xtc);
+    printf("OK\n");
+}
+
+void test_seek_xtc_frame(void)
+{
+    printf("%-40s", "seek_xtc_frame ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *xtc_copy = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_index_t *index = build_xtc_index(xtc);
+
+    // read frame 15 sequentially
+    for (int i = 0; i <= 15; ++i) assert(read_xtc_step(xtc_copy, system_copy) == 0);
+
+    assert(seek_xtc_frame(xtc, index, 15) == 0);
+    assert(read_xtc_step(xtc, system) == 0);
+    assert(system->step == 15000);
+    assert(closef(system->time, 30.0, 0.00001));
+    assert(memcmp(system->box, system_copy->box, sizeof(box_t)) == 0);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+    }
+
+    // seek backwards
+    assert(seek_xtc_frame(xtc, index, 0) == 0);
+    assert(read_xtc_step(xtc, system) == 0);
+    assert(system->step == 0);
+
+    // seek to the last frame
+    assert(seek_xtc_frame(xtc, index, 20) == 0);
+    assert(read_xtc_step(xtc, system) == 0);
+    assert(system->step == 20000);
+    assert(closef(system->atoms[48283].position[0], 1.78, 0.00001));
+    assert(read_xtc_step(xtc, system) != 0);
+
+    // nonexistent frame
+    assert(seek_xtc_frame(xtc, index, 21) != 0);
+
+    traj_index_destroy(index);
+    xdrfile_close(xtc);
+    xdrfile_close(xtc_copy);
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+/* Copies bytes [start, end) of the source file to the end of the target file. */
+static void copy_file_part(const char *source, const char *target, long start, long end, const char *mode)
+{
+    char *buffer = malloc(end - start);
+    FILE *input = fopen(source, "rb");
+    fseek(input, start, SEEK_SET);
+    assert(fread(buffer, 1, end - start, input) == (size_t) (end - start));
+    fclose(input);
+    FILE *output = fopen(target, mode);
+    assert(fwrite(buffer, 1, end - start, output) == (size_t) (end - start));
+    fclose(output);
+    free(buffer);
+}
+
+void test_load_xtc_index(void)
+{
+    printf("%-40s", "load_xtc_index ");
+    fflush(stdout);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_index_t *full = build_xtc_index(xtc);
+    xdrfile_close(xtc);
+
+    FILE *file = fopen(INPUT_XTC_FILE, "rb");
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fclose(file);
+    assert(full->end == file_size);
+
+    // trajectory containing the first 10 frames
+    remove("temporary.xtc.gidx");
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", 0, (long) full->frames[10].offset, "wb");
+
+    int up_to_date = 0;
+    assert(traj_index_load("temporary.xtc", &up_to_date) == NULL);
+
+    traj_index_t *index = load_xtc_index("temporary.xtc");
+    assert(index != NULL);
+    assert(index->n_frames == 10);
+    traj_index_destroy(index);
+
+    // sidecar file has been written
+    index = traj_index_load("temporary.xtc", &up_to_date);
+    assert(index != NULL);
+    assert(up_to_date == 1);
+    assert(index->n_frames == 10);
+    assert(index->end == full->frames[10].offset);
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        assert(memcmp(&(index->frames[i]), &(full->frames[i]), sizeof(traj_frame_t)) == 0);
+    }
+    traj_index_destroy(index);
+
+    // the trajectory grows
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", (long) full->frames[10].offset, file_size, "ab");
+
+    index = traj_index_load("temporary.xtc", &up_to_date);
+    assert(index != NULL);
+    assert(up_to_date == 0);
+    assert(index->n_frames == 10);
+    traj_index_destroy(index);
+
+    index = load_xtc_index("temporary.xtc");
+    assert(index != NULL);
+    assert(index->n_frames == 21);
+    assert(index->end == file_size);
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        assert(memcmp(&(index->frames[i]), &(full->frames[i]), sizeof(traj_frame_t)) == 0);
+    }
+    traj_index_destroy(index);
+
+    index = traj_index_load("temporary.xtc", &up_to_date);
+    assert(index != NULL);
+    assert(up_to_date == 1);
+    assert(index->n_frames == 21);
+    traj_index_destroy(index);
+
+    // the trajectory is rewritten by a longer run starting from the same structure
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", 0, (long) full->frames[10].offset, "wb");
+    index = load_xtc_index("temporary.xtc");
+    assert(index->n_frames == 10);
+    traj_index_destroy(index);
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", 0, (long) full->frames[3].offset, "wb");
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", (long) full->frames[8].offset, file_size, "ab");
+    assert(traj_index_load("temporary.xtc", &up_to_date) == NULL);
+    index = load_xtc_index("temporary.xtc");
+    assert(index->n_frames == 16);
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        size_t original = i < 3 ? i : i + 5;
+        assert(index->frames[i].step == full->frames[original].step);
+        assert(index->frames[i].offset == full->frames[original].offset - (i < 3 ? 0 : full->frames[8].offset - full->frames[3].offset));
+    }
+    traj_index_destroy(index);
+
+    // the trajectory is replaced by a different file of the same size
+    file = fopen("temporary.xtc", "r+b");
+    fseek(file, 20, SEEK_SET);
+    fputc(0x7f, file);
+    fclose(file);
+    assert(traj_index_load("temporary.xtc", &up_to_date) == NULL);
+
+    // the trajectory shrinks
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", 0, (long) full->frames[5].offset, "wb");
+    assert(traj_index_load("temporary.xtc", &up_to_date) == NULL);
+    index = load_xtc_index("temporary.xtc");
+    assert(index->n_frames == 5);
+    traj_index_destroy(index);
+
+    remove("temporary.xtc");
+    remove("temporary.xtc.gidx");
+    traj_index_destroy(full);
+    printf("OK\n");
+}
+
+void test_xtc_parallel(void)
+{
+    printf("%-40s", "xtc_parallel ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    assert(xtc_parallel_create("nonexistent.xtc", system, 4, 0) == NULL);
+    assert(xtc_parallel_create(INPUT_XTC_FILE, system, 0, 0) == NULL);
+
+    // queue smaller than the number of threads as well as larger queues
+    size_t threads[3] = {1, 4, 3};
+    size_t queues[3] = {1, 2, 16};
+    for (int t = 0; t < 3; ++t) {
+        XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+        xtc_parallel_t *reader = xtc_parallel_create(INPUT_XTC_FILE, system, threads[t], queues[t]);
+        assert(reader != NULL);
+
+        size_t n_frames = 0;
+        while (xtc_parallel_read(reader) == 0) {
+            assert(read_xtc_step(xtc, system_copy) == 0);
+            assert(system->step == system_copy->step);
+            assert(system->time == system_copy->time);
+            assert(system->precision == system_copy->precision);
+            assert(memcmp(system->box, system_copy->box, sizeof(box_t)) == 0);
+            for (size_t i = 0; i < system->n_atoms; ++i) {
+                assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+            }
+            ++n_frames;
+        }
+        assert(n_frames == 21);
+        assert(read_xtc_step(xtc, system_copy) != 0);
+        assert(xtc_parallel_read(reader) != 0);
+
+        xtc_parallel_destroy(reader);
+        xdrfile_close(xtc);
+    }
+
+    // destroying the reader before reading the whole trajectory
+    xtc_parallel_t *reader = xtc_parallel_create(INPUT_XTC_FILE, system, 4, 4);
+    for (int i = 0; i < 3; ++i) assert(xtc_parallel_read(reader) == 0);
+    assert(system->step == 2000);
+    xtc_parallel_destroy(reader);
+
+    remove(INPUT_XTC_FILE TRAJ_INDEX_SUFFIX);
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+void test_read_xtc_step_partial(void)
+{
+    printf("%-40s", "read_xtc_step_partial ");
+    fflush(stdout);
+
+    system_t *full = load_gro(INPUT_GRO_FILE);
+
+    // the last value is larger than the index of the last atom
+    size_t cutoffs[] = {0, 5, 10004, 48283, 100000};
+
+    for (int c = 0; c < 5; ++c) {
+        // positions of atoms above the cutoff must not be changed
+        system_t *partial = load_gro(INPUT_GRO_FILE);
+        for (size_t i = 0; i < partial->n_atoms; ++i) partial->atoms[i].position[0] = -1.0f;
+
+        XDRFILE *xtc_full = xdrfile_open(INPUT_XTC_FILE, "r");
+        XDRFILE *xtc_partial = xdrfile_open(INPUT_XTC_FILE, "r");
+
+        size_t n_frames = 0;
+        while (read_xtc_step(xtc_full, full) == 0) {
+            assert(read_xtc_step_partial(xtc_partial, partial, cutoffs[c]) == 0);
+            // both files must stay aligned to frame boundaries
+            assert(xdr_tell(xtc_full) == xdr_tell(xtc_partial));
+            assert(partial->step == full->step);
+            assert(partial->time == full->time);
+            assert(partial->precision == full->precision);
+            assert(memcmp(partial->box, full->box, sizeof(box_t)) == 0);
+            for (size_t i = 0; i < partial->n_atoms; ++i) {
+                if (i <= cutoffs[c]) assert(memcmp(partial->atoms[i].position, full->atoms[i].position, sizeof(vec_t)) == 0);
+                else assert(partial->atoms[i].position[0] == -1.0f);
+            }
+            ++n_frames;
+        }
+        assert(n_frames == 21);
+        assert(read_xtc_step_partial(xtc_partial, partial, cutoffs[c]) != 0);
+
+        xdrfile_close(xtc_full);
+        xdrfile_close(xtc_partial);
+        free(partial);
+    }
+
+    free(full);
+    printf("OK\n");
+}
+
+void test_read_xtc_step_selection(void)
+{
+    printf("%-40s", "read_xtc_step_selection ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    system_t *full = load_gro(INPUT_GRO_FILE);
+
+    size_t allocated = 3;
+    select_t *selection = selection_create(allocated);
+    selection_add_atom(&selection, &allocated, &(system->atoms[17]));
+    selection_add_atom(&selection, &allocated, &(system->atoms[3012]));
+    selection_add_atom(&selection, &allocated, &(system->atoms[250]));
+
+    XDRFILE *xtc_full = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *xtc_partial = xdrfile_open(INPUT_XTC_FILE, "r");
+
+    while (read_xtc_step(xtc_full, full) == 0) {
+        assert(read_xtc_step_selection(xtc_partial, system, selection) == 0);
+        assert(system->step == full->step);
+        for (size_t i = 0; i < selection->n_atoms; ++i) {
+            size_t index = selection->atoms[i] - system->atoms;
+            assert(memcmp(selection->atoms[i]->position, full->atoms[index].position, sizeof(vec_t)) == 0);
+        }
+    }
+    assert(read_xtc_step_selection(xtc_partial, system, selection) != 0);
+
+    // empty selection only reads the frame headers
+    select_t *empty = selection_create(1);
+    assert(xdr_seek(xtc_partial, 0, SEEK_SET) == exdrOK);
+    assert(read_xtc_step_selection(xtc_partial, system, empty) == 0);
+    assert(read_xtc_step_selection(xtc_partial, system, empty) == 0);
+    assert(system->step == 1000);
+
+    xdrfile_close(xtc_full);
+    xdrfile_close(xtc_partial);
+    free(empty);
+    free(selection);
+    free(system);
+    free(full);
+    printf("OK\n");
+}
+
+void test_read_xtc_step_positions(void)
+{
+    printf("%-40s", "read_xtc_step (block of positions) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    system_t *reference = load_gro(INPUT_GRO_FILE);
+    vec_t first_atom = {0.f};
+    memcpy(first_atom, system->atoms[0].position, sizeof(vec_t));
+    assert(system_positions_enable(system) == 0);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *xtc_reference = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_reader_t *reader = traj_reader_create(xtc, system, traj_xtc);
+
+    size_t n_frames = 0;
+    while (read_xtc_step(xtc_reference, reference) == 0) {
+        // alternate between the reading functions
+        if (n_frames % 3 == 0) assert(read_xtc_step(xtc, system) == 0);
+        else if (n_frames % 3 == 1) assert(traj_reader_read(reader) == 0);
+        else assert(read_xtc_step_partial(xtc, system, 100000) == 0);
+
+        assert(system->step == reference->step);
+        assert(memcmp(system->box, reference->box, sizeof(box_t)) == 0);
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            assert(memcmp(system->positions[i], reference->atoms[i].position, sizeof(vec_t)) == 0);
+        }
+
+        // the atoms themselves are not updated
+        assert(memcmp(system->atoms[0].position, first_atom, sizeof(vec_t)) == 0);
+        ++n_frames;
+    }
+    assert(n_frames == 21);
+    traj_reader_destroy(reader);
+
+    system_positions_sync(system);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(memcmp(system->atoms[i].position, reference->atoms[i].position, sizeof(vec_t)) == 0);
+    }
+
+    // multi-threaded reader
+    xtc_parallel_t *parallel = xtc_parallel_create(INPUT_XTC_FILE, system, 2, 0);
+    assert(xdr_seek(xtc_reference, 0, SEEK_SET) == exdrOK);
+    while (xtc_parallel_read(parallel) == 0) {
+        assert(read_xtc_step(xtc_reference, reference) == 0);
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            assert(memcmp(system->positions[i], reference->atoms[i].position, sizeof(vec_t)) == 0);
+        }
+    }
+    xtc_parallel_destroy(parallel);
+
+    xdrfile_close(xtc);
+    xdrfile_close(xtc_reference);
+    remove(INPUT_XTC_FILE TRAJ_INDEX_SUFFIX);
+    system_positions_disable(system);
+    free(system);
+    free(reference);
+    printf("OK\n");
+}
+
+void test_xdrfile_open_backends(void)
+{
+    printf("%-40s", "xdrfile_open (mmap and stdio) ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    // read the whole file into memory and compare with the file opened using xdrfile_open
+    FILE *file = fopen(INPUT_XTC_FILE, "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size);
+    assert(fread(data, 1, size, file) == (size_t) size);
+    fclose(file);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *memory = xdrfile_open_buffer(data, size);
+    assert(xdrfile_reset_buffer(xtc, data, size) != exdrOK);
+
+    while (read_xtc_step(xtc, system) == 0) {
+        assert(read_xtc_step(memory, system_copy) == 0);
+        assert(xdr_tell(xtc) == xdr_tell(memory));
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+        }
+    }
+    assert(read_xtc_step(memory, system_copy) != 0);
+    assert(xdr_tell(xtc) == size);
+
+    // reusing the in-memory file for the second frame only
+    assert(xdr_seek(xtc, 0, SEEK_SET) == exdrOK);
+    traj_index_t *index = build_xtc_index(xtc);
+    assert(xdrfile_reset_buffer(memory, data + index->frames[1].offset, index->frames[2].offset - index->frames[1].offset) == exdrOK);
+    assert(read_xtc_step(memory, system_copy) == 0);
+    assert(system_copy->step == 1000);
+    assert(read_xtc_step(memory, system_copy) != 0);
+    traj_index_destroy(index);
+
+    xdrfile_close(xtc);
+    xdrfile_close(memory);
+    free(data);
+
+    // empty files can not be mapped and are read using stdio
+    file = fopen("temporary.xtc", "wb");
+    fclose(file);
+    xtc = xdrfile_open("temporary.xtc", "r");
+    assert(xtc != NULL);
+    assert(read_xtc_step(xtc, system) != 0);
+    xdrfile_close(xtc);
+    remove("temporary.xtc");
+
+    assert(xdrfile_open("nonexistent.xtc", "r") == NULL);
+
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+/* Returns a random integer from the interval [0, n). */
+static int random_below(int n)
+{
+    return (int) ((((unsigned long) rand() << 15) ^ (unsigned long) rand()) % (unsigned long) n);
+}
+
+void test_xtc_compression_roundtrip(void)
+{
+    printf("%-40s", "xtc compression (random frames) ");
+    fflush(stdout);
+
+    const int n_atoms = 300;
+    const int n_frames = 400;
+    rvec *coordinates = calloc(n_frames * n_atoms, sizeof(rvec));
+    rvec *decoded = calloc(n_atoms, sizeof(rvec));
+    matrix box = {{10.0f, 0.0f, 0.0f}, {0.0f, 10.0f, 0.0f}, {0.0f, 0.0f, 10.0f}};
+
+    // with precision 1, integer coordinates are stored exactly, so the decoded frames must be identical
+    // ranges of coordinates are log-uniformly distributed so that the packed integers span 3 to more than 64 bits
+    // neighbouring atoms are often close to each other so that runs of small differences are also encoded
+    srand(1234);
+    for (int f = 0; f < n_frames; ++f) {
+        int range[3];
+        for (int d = 0; d < 3; ++d) {
+            range[d] = 2 + (int) exp(log(16000000.0) * rand() / RAND_MAX);
+        }
+
+        for (int i = 0; i < n_atoms; ++i) {
+            float *x = coordinates[f * n_atoms + i];
+            int close = i > 0 && rand() % 10 < 7;
+            for (int d = 0; d < 3; ++d) {
+                int value = random_below(range[d]);
+                if (close) {
+                    value = (int) coordinates[f * n_atoms + i - 1][d] + random_below(11) - 5;
+                    if (value < 0) value = 0;
+                    if (value >= range[d]) value = range[d] - 1;
+                }
+                x[d] = (float) (value - range[d] / 2);
+            }
+        }
+    }
+
+    XDRFILE *output = xdrfile_open("temporary.xtc", "w");
+    for (int f = 0; f < n_frames; ++f) {
+        assert(write_xtc(output, n_atoms, f, (float) f, box, &coordinates[f * n_atoms], 1.0f) == exdrOK);
+    }
+    xdrfile_close(output);
+
+    int step = -1;
+    float time = 0, precision = 0;
+    matrix read_box;
+    XDRFILE *input = xdrfile_open("temporary.xtc", "r");
+    for (int f = 0; f < n_frames; ++f) {
+        assert(read_xtc(input, n_atoms, &step, &time, read_box, decoded, &precision) == exdrOK);
+        assert(step == f);
+        assert(memcmp(decoded, &coordinates[f * n_atoms], n_atoms * sizeof(rvec)) == 0);
+    }
+    assert(read_xtc(input, n_atoms, &step, &time, read_box, decoded, &precision) != exdrOK);
+    xdrfile_close(input);
+    remove("temporary.xtc");
+
+    free(coordinates);
+    free(decoded);
+    printf("OK\n");
+}
+
+void test_xtc_decodeints_generic(void)
+{
+    printf("%-40s", "xtc decodeints (native vs generic) ");
+    fflush(stdout);
+
+    // random bit streams are decoded using the native and the byte-wise division
+    // the packed integers cover all lengths up to 72 bits with extra weight around 64 bits
+    srand(4321);
+    unsigned char data[16] = {0};
+    for (int k = 0; k < 200000; ++k) {
+        int num_of_bits = k % 4 == 0 ? 56 + random_below(17) : 1 + random_below(72);
+
+        unsigned int sizes[3];
+        for (int d = 0; d < 3; ++d) {
+            int bits = 1 + random_below(23);
+            sizes[d] = (1u << (bits - 1)) + (unsigned int) random_below(1 << (bits - 1)) + 1;
+        }
+
+        for (int b = 0; b < 16; ++b) data[b] = (unsigned char) random_below(256);
+
+        int nums[3] = {0}, nums_generic[3] = {0};
+        assert(xdrfile_decodeints_check(data, 16, 3, num_of_bits, sizes, nums, nums_generic) == exdrOK);
+        assert(memcmp(nums, nums_generic, sizeof(nums)) == 0);
+    }
+
+    // all bits set, largest allowed sizes
+    unsigned int sizes[3] = {1u << 23, 1u << 23, 1u << 23};
+    memset(data, 0xff, sizeof(data));
+    for (int num_of_bits = 1; num_of_bits <= 72; ++num_of_bits) {
+        int nums[3] = {0}, nums_generic[3] = {0};
+        assert(xdrfile_decodeints_check(data, 16, 3, num_of_bits, sizes, nums, nums_generic) == exdrOK);
+        assert(memcmp(nums, nums_generic, sizeof(nums)) == 0);
+    }
+
+    int nums[3], nums_generic[3];
+    assert(xdrfile_decodeints_check(data, 8, 3, 72, sizes, nums, nums_generic) == exdrNR);
+    sizes[1] = 0;
+    assert(xdrfile_decodeints_check(data, 16, 3, 72, sizes, nums, nums_generic) == exdrNR);
+
+    printf("OK\n");
+}
+
+/* Reads the whole file into memory. The returned buffer must be deallocated. */
+static char *read_whole_file(const char *filename, long *size)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(*size + 1);
+    if (fread(data, 1, *size, file) != (size_t) *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+/* Returns 1 if both files have identical content, else 0. */
+static int files_identical(const char *first, const char *second)
+{
+    long size1 = 0, size2 = 0;
+    char *data1 = read_whole_file(first, &size1);
+    char *data2 = read_whole_file(second, &size2);
+    int identical = data1 != NULL && data2 != NULL && size1 == size2 && memcmp(data1, data2, size1) == 0;
+    free(data1);
+    free(data2);
+    return identical;
+}
+
+void test_xtc_compression_identical(void)
+{
+    printf("%-40s", "xtc compression (identical output) ");
+    fflush(stdout);
+
+    // example.xtc is rewritten into the very same bytes
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *output = xdrfile_open("temporary.xtc", "w");
+    while (read_xtc_step(xtc, system) == 0) {
+        assert(write_xtc_step(output, all, system->step, system->time, system->box, system->precision) == 0);
+    }
+    xdrfile_close(xtc);
+    xdrfile_close(output);
+    assert(files_identical("temporary.xtc", INPUT_XTC_FILE));
+    free(all);
+    free(system);
+
+    // the double precision compressor still uses the original byte-wise routines,
+    // so it produces the reference output for random frames
+    const int n_atoms = 500;
+    const int n_frames = 200;
+    const float precision = 1000.0f;
+    float *coordinates = malloc(3 * n_atoms * sizeof(float));
+    double *coordinates_d = malloc(3 * n_atoms * sizeof(double));
+    float *decoded = malloc(3 * n_atoms * sizeof(float));
+
+    srand(4321);
+    output = xdrfile_open("temporary.xtc", "w");
+    XDRFILE *reference = xdrfile_open("temporary2.xtc", "w");
+    for (int f = 0; f < n_frames; ++f) {
+        // from tiny boxes up to boxes requiring the large size encoding
+        float range = exp(log(30000.0) * rand() / RAND_MAX);
+        for (int i = 0; i < 3 * n_atoms; ++i) {
+            if (i >= 3 && rand() % 10 < 7) {
+                coordinates[i] = coordinates[i - 3] + 0.2f * ((float) rand() / RAND_MAX - 0.5f);
+            } else {
+                coordinates[i] = range * ((float) rand() / RAND_MAX - 0.5f);
+            }
+            coordinates_d[i] = coordinates[i];
+        }
+
+        assert(xdrfile_compress_coord_float(coordinates, n_atoms, precision, output) == n_atoms);
+        assert(xdrfile_compress_coord_double(coordinates_d, n_atoms, precision, reference) == n_atoms);
+    }
+    xdrfile_close(output);
+    xdrfile_close(reference);
+    assert(files_identical("temporary.xtc", "temporary2.xtc"));
+
+    // compressed frames are decoded back within the precision
+    srand(4321);
+    XDRFILE *input = xdrfile_open("temporary.xtc", "r");
+    for (int f = 0; f < n_frames; ++f) {
+        float range = exp(log(30000.0) * rand() / RAND_MAX);
+        for (int i = 0; i < 3 * n_atoms; ++i) {
+            if (i >= 3 && rand() % 10 < 7) {
+                coordinates[i] = coordinates[i - 3] + 0.2f * ((float) rand() / RAND_MAX - 0.5f);
+            } else {
+                coordinates[i] = range * ((float) rand() / RAND_MAX - 0.5f);
+            }
+        }
+
+        int size = n_atoms;
+        float read_precision = 0;
+        assert(xdrfile_decompress_coord_float(decoded, &size, &read_precision, input) == n_atoms);
+        assert(read_precision == precision);
+        for (int i = 0; i < 3 * n_atoms; ++i) {
+            assert(fabsf(decoded[i] - coordinates[i]) <= 0.5f / precision + fabsf(coordinates[i]) * 1e-6f);
+        }
+    }
+    xdrfile_close(input);
+
+    remove("temporary.xtc");
+    remove("temporary2.xtc");
+    free(coordinates);
+    free(coordinates_d);
+    free(decoded);
+    printf("OK\n");
+}
+
+void test_xtc_writer(void)
+{
+    printf("%-40s", "xtc_writer ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    select_t *protein = select_atoms(all, "LEU SER", &match_residue_name);
+
+    assert(xtc_writer_create("nonexistent/temporary.xtc", "w", 2, 0) == NULL);
+    assert(xtc_writer_create("temporary.xtc", "w", 0, 0) == NULL);
+    assert(xtc_writer_create("temporary.xtc", "r", 2, 0) == NULL);
+
+    // frames are committed in order, so rewriting example.xtc reproduces the file exactly
+    size_t threads[3] = {1, 4, 3};
+    size_t queues[3] = {1, 2, 16};
+    for (int t = 0; t < 3; ++t) {
+        XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+        xtc_writer_t *writer = xtc_writer_create("temporary.xtc", "w", threads[t], queues[t]);
+        assert(writer != NULL);
+        size_t n_frames = 0;
+        while (read_xtc_step(xtc, system) == 0) {
+            assert(xtc_writer_submit(writer, all, system->step, system->time, system->box, system->precision) == 0);
+            if (++n_frames == 10) assert(xtc_writer_flush(writer) == 0);
+        }
+        assert(xtc_writer_close(writer) == 0);
+        xdrfile_close(xtc);
+        assert(files_identical("temporary.xtc", INPUT_XTC_FILE));
+    }
+
+    // appending frames of a selection gives the same file as write_xtc_step
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    XDRFILE *output = xdrfile_open("temporary2.xtc", "w");
+    xtc_writer_t *writer = xtc_writer_create("temporary.xtc", "w", 2, 0);
+    for (int i = 0; read_xtc_step(xtc, system) == 0; ++i) {
+        if (i == 5) {
+            assert(xtc_writer_close(writer) == 0);
+            writer = xtc_writer_create("temporary.xtc", "a", 2, 0);
+        }
+        assert(xtc_writer_submit(writer, protein, system->step, system->time, system->box, system->precision) == 0);
+        assert(write_xtc_step(output, protein, system->step, system->time, system->box, system->precision) == 0);
+    }
+    assert(xtc_writer_close(writer) == 0);
+    xdrfile_close(output);
+    xdrfile_close(xtc);
+    assert(files_identical("temporary.xtc", "temporary2.xtc"));
+
+    // the in-memory output buffer used by the workers can be read back
+    XDRFILE *memory = xdrfile_open_output_buffer();
+    int64_t size = -1;
+    assert(xdrfile_output_data(memory, &size) == NULL);
+    assert(write_xtc_step(memory, protein, 17, 3.5f, system->box, 100.0f) == 0);
+    char *data = xdrfile_output_data(memory, &size);
+    assert(data != NULL && size == xdr_tell(memory));
+    assert(xdrfile_reset_buffer(memory, data, size) != exdrOK);
+    XDRFILE *input = xdrfile_open_buffer(data, size);
+    system_t *protein_system = selection_to_system(protein, system->box, 0, 0);
+    assert(read_xtc_step(input, protein_system) == 0);
+    assert(protein_system->step == 17 && protein_system->time == 3.5f && protein_system->precision == 100.0f);
+    assert(read_xtc_step(input, protein_system) != 0);
+    assert(xdrfile_output_data(input, &size) == NULL);
+    xdrfile_close(input);
+    xdrfile_close(memory);
+
+    remove("temporary.xtc");
+    remove("temporary2.xtc");
+    free(protein_system);
+    free(protein);
+    free(all);
+    free(system);
+    printf("OK\n");
+}
+
+/* Writes a frame of a double precision trr file containing box, coordinates and velocities. */
+static void write_trr_double_frame(XDRFILE *xdr, int natoms, int step, double time, double *box, double *x, double *v)
+{
+    int header[14] = {1993, 13, 0, 0, 9 * 8, 0, 0, 0, 0, natoms * 24, natoms * 24, 0, natoms, step};
+    int nre = 0;
+    double lambda = 0.25;
+
+    assert(xdrfile_write_int(header, 2, xdr) == 2);
+    assert(xdrfile_write_string("GMX_trn_file", xdr) == 13);
+    assert(xdrfile_write_int(header + 2, 12, xdr) == 12);
+    assert(xdrfile_write_int(&nre, 1, xdr) == 1);
+    assert(xdrfile_write_double(&time, 1, xdr) == 1);
+    assert(xdrfile_write_double(&lambda, 1, xdr) == 1);
+    assert(xdrfile_write_double(box, 9, xdr) == 9);
+    assert(xdrfile_write_double(x, 3 * natoms, xdr) == 3 * natoms);
+    assert(xdrfile_write_double(v, 3 * natoms, xdr) == 3 * natoms);
+}
+
+void test_read_trr_bulk(void)
+{
+    printf("%-40s", "read_trr (bulk arrays) ");
+    fflush(stdout);
+
+    // more values than fit into a single conversion chunk and a count not divisible by it
+    const int natoms = 1001;
+    rvec *x = malloc(natoms * sizeof(rvec));
+    rvec *v = malloc(natoms * sizeof(rvec));
+    rvec *f = malloc(natoms * sizeof(rvec));
+    rvec *x_read = malloc(natoms * sizeof(rvec));
+    rvec *v_read = malloc(natoms * sizeof(rvec));
+    rvec *f_read = malloc(natoms * sizeof(rvec));
+    double *xd = malloc(3 * natoms * sizeof(double));
+    double *vd = malloc(3 * natoms * sizeof(double));
+    matrix box = {{5.0f, 0.0f, 0.0f}, {0.0f, 6.0f, 0.0f}, {1.0f, 2.0f, 7.0f}};
+    double boxd[9] = {5.0, 0.0, 0.0, 0.0, 6.0, 0.0, 1.0, 2.0, 7.0};
+    matrix box_read;
+
+    srand(99);
+    for (int i = 0; i < natoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            x[i][j] = 20.0f * rand() / RAND_MAX - 10.0f;
+            v[i][j] = -1.0f / (i + j + 1);
+            f[i][j] = 1e6f * rand() / RAND_MAX;
+            // values representable in single precision are converted exactly
+            xd[3 * i + j] = x[i][j];
+            vd[3 * i + j] = v[i][j];
+        }
+    }
+
+    // single precision file read using the mapped file and using an in-memory buffer
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    assert(write_trr(output, natoms, 1, 0.5f, 0.1f, box, x, v, f) == exdrOK);
+    assert(write_trr(output, natoms, 2, 1.5f, 0.1f, box, x, NULL, f) == exdrOK);
+    xdrfile_close(output);
+
+    long size = 0;
+    char *data = read_whole_file("temporary.trr", &size);
+    XDRFILE *inputs[2] = {xdrfile_open("temporary.trr", "r"), xdrfile_open_buffer(data, size)};
+    for (int k = 0; k < 2; ++k) {
+        int step = 0;
+        float time = 0, lambda = 0;
+        assert(read_trr(inputs[k], natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read) == exdrOK);
+        assert(step == 1 && time == 0.5f);
+        assert(memcmp(box, box_read, sizeof(matrix)) == 0);
+        assert(memcmp(x, x_read, natoms * sizeof(rvec)) == 0);
+        assert(memcmp(v, v_read, natoms * sizeof(rvec)) == 0);
+        assert(memcmp(f, f_read, natoms * sizeof(rvec)) == 0);
+
+        // coordinates not requested by the caller are skipped
+        memset(f_read, 0, natoms * sizeof(rvec));
+        assert(read_trr(inputs[k], natoms, &step, &time, &lambda, box_read, NULL, v_read, f_read) == exdrOK);
+        assert(step == 2);
+        assert(memcmp(f, f_read, natoms * sizeof(rvec)) == 0);
+
+        assert(read_trr(inputs[k], natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read) != exdrOK);
+        xdrfile_close(inputs[k]);
+    }
+
+    // truncated frames are reported
+    XDRFILE *truncated = xdrfile_open_buffer(data, size - 4);
+    int step = 0;
+    float time = 0, lambda = 0;
+    assert(read_trr(truncated, natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read) == exdrOK);
+    assert(read_trr(truncated, natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read) == exdrFLOAT);
+    xdrfile_close(truncated);
+    free(data);
+
+    // double precision file is converted to single precision
+    output = xdrfile_open("temporary.trr", "w");
+    write_trr_double_frame(output, natoms, 7, 2.5, boxd, xd, vd);
+    write_trr_double_frame(output, natoms, 8, 3.5, boxd, vd, xd);
+    xdrfile_close(output);
+
+    XDRFILE *input = xdrfile_open("temporary.trr", "r");
+    int fields = 0;
+    assert(read_trr_fields(input, natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read, &fields) == exdrOK);
+    assert(step == 7 && time == 2.5f && lambda == 0.25f && fields == (TRR_X | TRR_V));
+    assert(memcmp(box, box_read, sizeof(matrix)) == 0);
+    assert(memcmp(x, x_read, natoms * sizeof(rvec)) == 0);
+    assert(memcmp(v, v_read, natoms * sizeof(rvec)) == 0);
+    assert(read_trr(input, natoms, &step, &time, &lambda, box_read, NULL, x_read, NULL) == exdrOK);
+    assert(step == 8);
+    assert(memcmp(x, x_read, natoms * sizeof(rvec)) == 0);
+    assert(read_trr(input, natoms, &step, &time, &lambda, box_read, x_read, v_read, f_read) != exdrOK);
+    xdrfile_close(input);
+
+    remove("temporary.trr");
+    free(x);
+    free(v);
+    free(f);
+    free(x_read);
+    free(v_read);
+    free(f_read);
+    free(xd);
+    free(vd);
+    printf("OK\n");
+}
+
+void test_read_trr_step_fields(void)
+{
+    printf("%-40s", "read_trr_step_fields ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    int natoms = (int) system->n_atoms;
+
+    vec_t *coordinates = malloc(system->n_atoms * sizeof(vec_t));
+    vec_t *velocities  = malloc(system->n_atoms * sizeof(vec_t));
+    vec_t *forces      = malloc(system->n_atoms * sizeof(vec_t));
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            coordinates[i][j] = system->atoms[i].position[j];
+            velocities[i][j]  = (float) i - j;
+            forces[i][j]      = (float) i + j;
+        }
+    }
+
+    float box[3][3] = {{0}};
+    box_gro2xtc(system->box, box);
+
+    // first frame contains everything, second frame lacks velocities
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    assert(write_trr(output, natoms, 0, 0.0, 0.0, box, coordinates, velocities, forces) == exdrOK);
+    assert(write_trr(output, natoms, 10, 1.0, 0.5, box, coordinates, NULL, forces) == exdrOK);
+    xdrfile_close(output);
+
+    // properties that are not requested are never touched
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            system->atoms[i].position[j] = -1.0f;
+            system->atoms[i].force[j] = -2.0f;
+        }
+    }
+
+    XDRFILE *trr = xdrfile_open("temporary.trr", "r");
+    assert(read_trr_step_fields(trr, system, TRR_V) == 0);
+    assert(system->step == 0);
+    assert(closef(system->box[0], 7.25725, 0.00001));
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(memcmp(system->atoms[i].velocity, velocities[i], sizeof(vec_t)) == 0);
+        for (int j = 0; j < 3; ++j) {
+            assert(system->atoms[i].position[j] == -1.0f);
+            assert(system->atoms[i].force[j] == -2.0f);
+        }
+    }
+
+    // requested properties missing from the frame are set to zero
+    assert(read_trr_step_fields(trr, system, TRR_V | TRR_F) == 0);
+    assert(system->step == 10);
+    assert(closef(system->lambda, 0.5, 0.00001));
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(vec_len(system->atoms[i].velocity) == 0.0);
+        assert(memcmp(system->atoms[i].force, forces[i], sizeof(vec_t)) == 0);
+        assert(system->atoms[i].position[0] == -1.0f);
+    }
+    assert(read_trr_step_fields(trr, system, TRR_V) != 0);
+    xdrfile_close(trr);
+
+    // traj_reader with positions only, switching to all fields for the second frame
+    trr = xdrfile_open("temporary.trr", "r");
+    traj_reader_t *reader = traj_reader_create(trr, system, traj_trr);
+    reader->fields = TRR_X;
+    assert(traj_reader_read(reader) == 0);
+    for (size_t i = 0; i < system->n_atoms; ++i) {
+        assert(memcmp(system->atoms[i].position, coordinates[i], sizeof(vec_t)) == 0);
+        assert(system->atoms[i].force[0] == forces[i][0] + 0.0f);
+    }
+    reader->fields = TRR_X | TRR_V | TRR_F;
+    assert(traj_reader_read(reader) == 0);
+    assert(system->step == 10);
+    assert(vec_len(system->atoms[100].velocity) == 0.0);
+    assert(traj_reader_read(reader) != 0);
+    traj_reader_destroy(reader);
+    xdrfile_close(trr);
+
+    // truncated frames are detected even if the truncated block is skipped
+    long size = 0;
+    char *data = read_whole_file("temporary.trr", &size);
+    XDRFILE *truncated = xdrfile_open_buffer(data, size - 4);
+    int step = 0, fields = 0;
+    float time = 0, lambda = 0;
+    assert(read_trr_select(truncated, natoms, &step, &time, &lambda, box, coordinates, NULL, NULL, TRR_X, &fields) == exdrOK);
+    assert(fields == (TRR_X | TRR_V | TRR_F));
+    assert(read_trr_select(truncated, natoms, &step, &time, &lambda, box, coordinates, NULL, NULL, TRR_X, &fields) != exdrOK);
+    xdrfile_close(truncated);
+    free(data);
+
+    remove("temporary.trr");
+    free(coordinates);
+    free(velocities);
+    free(forces);
+    free(system);
+    printf("OK\n");
+}
+
+void test_trr_index(void)
+{
+    printf("%-40s", "build_trr_index & seek_trr_frame ");
+    fflush(stdout);
+
+    const int natoms = 500;
+    rvec *x = malloc(natoms * sizeof(rvec));
+    rvec *x_read = malloc(natoms * sizeof(rvec));
+    double *xd = malloc(3 * natoms * sizeof(double));
+    double boxd[9] = {5.0, 0, 0, 0, 6.0, 0, 0, 0, 7.0};
+    matrix box = {{5.0f, 0, 0}, {0, 6.0f, 0}, {0, 0, 7.0f}};
+
+    // frames of different sizes: every third frame lacks velocities and forces, the last two are double precision
+    remove("temporary.trr.gidx");
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    for (int frame = 0; frame < 10; ++frame) {
+        for (int i = 0; i < natoms; ++i) {
+            for (int j = 0; j < 3; ++j) x[i][j] = (float) (frame * 1000 + i * 3 + j);
+        }
+        if (frame % 3 == 0) assert(write_trr(output, natoms, frame * 100, frame * 0.2f, 0.0f, box, x, NULL, NULL) == exdrOK);
+        else assert(write_trr(output, natoms, frame * 100, frame * 0.2f, 0.0f, box, x, x, x) == exdrOK);
+    }
+    for (int frame = 10; frame < 12; ++frame) {
+        for (int i = 0; i < 3 * natoms; ++i) xd[i] = frame * 1000 + i;
+        write_trr_double_frame(output, natoms, frame * 100, frame * 0.2, boxd, xd, xd);
+    }
+    xdrfile_close(output);
+
+    XDRFILE *trr = xdrfile_open("temporary.trr", "r");
+    traj_index_t *index = build_trr_index(trr);
+    assert(index != NULL);
+    assert(index->n_frames == 12);
+    assert(index->frames[0].offset == 0);
+    for (size_t i = 0; i < index->n_frames; ++i) {
+        assert(index->frames[i].step == (int) i * 100);
+        assert(closef(index->frames[i].time, (float) i * 0.2f, 0.00001));
+        if (i > 0) assert(index->frames[i].offset > index->frames[i - 1].offset);
+    }
+    assert(xdr_tell(trr) == 0);
+
+    // random access
+    int step = 0;
+    float time = 0, lambda = 0;
+    int order[] = {7, 2, 11, 0, 9, 10, 3};
+    for (size_t k = 0; k < sizeof(order) / sizeof(int); ++k) {
+        assert(seek_trr_frame(trr, index, order[k]) == 0);
+        assert(read_trr(trr, natoms, &step, &time, &lambda, box, x_read, NULL, NULL) == exdrOK);
+        assert(step == order[k] * 100);
+        for (int i = 0; i < natoms; ++i) {
+            for (int j = 0; j < 3; ++j) assert(x_read[i][j] == (float) (order[k] * 1000 + i * 3 + j));
+        }
+    }
+    assert(seek_trr_frame(trr, index, 12) != 0);
+
+    // time lookup
+    assert(traj_index_find_time(index, 1.0f) == 5);
+    assert(traj_index_find_time(index, 1.09f) == 5);
+    assert(traj_index_find_time(index, 1.11f) == 6);
+    assert(traj_index_find_time(index, -3.0f) == 0);
+    assert(traj_index_find_time(index, 100.0f) == 11);
+    xdrfile_close(trr);
+
+    // truncated frames are not part of the index
+    long size = 0;
+    char *data = read_whole_file("temporary.trr", &size);
+    XDRFILE *truncated = xdrfile_open_buffer(data, (size_t) index->frames[6].offset + 100);
+    traj_index_t *truncated_index = build_trr_index(truncated);
+    assert(truncated_index != NULL);
+    assert(truncated_index->n_frames == 6);
+    assert(truncated_index->end == index->frames[6].offset);
+    traj_index_destroy(truncated_index);
+    xdrfile_close(truncated);
+    free(data);
+
+    // sidecar file
+    traj_index_t *loaded = load_trr_index("temporary.trr");
+    assert(loaded != NULL);
+    assert(loaded->n_frames == 12);
+    traj_index_destroy(loaded);
+    int up_to_date = 0;
+    loaded = traj_index_load("temporary.trr", &up_to_date);
+    assert(loaded != NULL && up_to_date == 1);
+    assert(memcmp(loaded->frames, index->frames, index->n_frames * sizeof(traj_frame_t)) == 0);
+    traj_index_destroy(loaded);
+
+    // sidecar of a shorter trajectory is not reused for a longer rewrite with the same first frames
+    copy_file_part("temporary.trr", "temporary_full.trr", 0, (long) index->end, "wb");
+    copy_file_part("temporary_full.trr", "temporary.trr", 0, (long) index->frames[4].offset, "wb");
+    loaded = load_trr_index("temporary.trr");
+    assert(loaded != NULL && loaded->n_frames == 4);
+    traj_index_destroy(loaded);
+    copy_file_part("temporary_full.trr", "temporary.trr", 0, (long) index->frames[2].offset, "wb");
+    copy_file_part("temporary_full.trr", "temporary.trr", (long) index->frames[6].offset, (long) index->end, "ab");
+    assert(traj_index_load("temporary.trr", &up_to_date) == NULL);
+    loaded = load_trr_index("temporary.trr");
+    assert(loaded != NULL && loaded->n_frames == 8);
+    for (size_t i = 0; i < loaded->n_frames; ++i) assert(loaded->frames[i].step == (int) (i < 2 ? i : i + 4) * 100);
+    traj_index_destroy(loaded);
+    remove("temporary_full.trr");
+
+    remove("temporary.trr.gidx");
+    remove("temporary.trr");
+    traj_index_destroy(index);
+    free(x);
+    free(x_read);
+    free(xd);
+    printf("OK\n");
+}
+
+void test_xtc_prefetch(void)
+{
+    printf("%-40s", "xtc_prefetch ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    // copying into atoms as well as swapping the block of positions
+    size_t queues[4] = {1, 0, 5, 30};
+    for (int q = 0; q < 4; ++q) {
+        if (q >= 2) assert(system_positions_enable(system) == 0);
+
+        XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+        XDRFILE *xtc_copy = xdrfile_open(INPUT_XTC_FILE, "r");
+        xtc_prefetch_t *reader = xtc_prefetch_create(xtc, system, queues[q]);
+        assert(reader != NULL);
+
+        size_t n_frames = 0;
+        vec_t *previous = system->positions;
+        while (xtc_prefetch_read(reader) == 0) {
+            assert(read_xtc_step(xtc_copy, system_copy) == 0);
+            assert(system->step == system_copy->step);
+            assert(system->time == system_copy->time);
+            assert(system->precision == system_copy->precision);
+            assert(memcmp(system->box, system_copy->box, sizeof(box_t)) == 0);
+            if (system->positions != NULL) {
+                assert(system->positions != previous);
+                previous = system->positions;
+                for (size_t i = 0; i < system->n_atoms; ++i) {
+                    assert(memcmp(system->positions[i], system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+                }
+            } else {
+                for (size_t i = 0; i < system->n_atoms; ++i) {
+                    assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+                }
+            }
+            ++n_frames;
+        }
+        assert(n_frames == 21);
+        assert(read_xtc_step(xtc_copy, system_copy) != 0);
+        assert(xtc_prefetch_read(reader) != 0);
+
+        xtc_prefetch_destroy(reader);
+        xdrfile_close(xtc);
+        xdrfile_close(xtc_copy);
+    }
+
+    // block of positions obtained from the reader outlives it
+    system_positions_disable(system);
+    assert(closef(system->atoms[48283].position[0], 1.78, 0.00001));
+
+    // starting in the middle of the file and destroying the reader before reading the whole trajectory
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    assert(read_xtc_step(xtc, system) == 0);
+    xtc_prefetch_t *reader = xtc_prefetch_create(xtc, system, 3);
+    for (int i = 0; i < 3; ++i) assert(xtc_prefetch_read(reader) == 0);
+    assert(system->step == 3000);
+    xtc_prefetch_destroy(reader);
+    xdrfile_close(xtc);
+
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+void test_traj_reader_window(void)
+{
+    printf("%-40s", "traj_reader_set_window ");
+    fflush(stdout);
+
+    system_t *system = load_gro(INPUT_GRO_FILE);
+    select_t *all = select_system(system);
+    system_t *system_copy = selection_to_system_d(all, system->box, system->step, system->time);
+
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_index_t *index = build_xtc_index(xtc);
+    xdrfile_close(xtc);
+
+    // corrupt the compressed coordinates of frames that are skipped: they must never be decompressed
+    long size = 0;
+    char *data = read_whole_file(INPUT_XTC_FILE, &size);
+    int skipped[] = {2, 7, 13, 15};
+    for (size_t k = 0; k < sizeof(skipped) / sizeof(int); ++k) {
+        memset(data + index->frames[skipped[k]].offset + 200, 0xff, 500);
+    }
+
+    // frames with time 10 to 30 ps, every third frame
+    xtc = xdrfile_open_buffer(data, size);
+    XDRFILE *xtc_copy = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_reader_t *reader = traj_reader_create(xtc, system, traj_xtc);
+    traj_reader_set_window(reader, 10.0f, 30.0f, 3);
+
+    int expected[] = {5, 8, 11, 14};
+    for (size_t k = 0; k < sizeof(expected) / sizeof(int); ++k) {
+        assert(traj_reader_read(reader) == 0);
+        assert(seek_xtc_frame(xtc_copy, index, expected[k]) == 0);
+        assert(read_xtc_step(xtc_copy, system_copy) == 0);
+        assert(system->step == expected[k] * 1000);
+        assert(system->time == system_copy->time);
+        for (size_t i = 0; i < system->n_atoms; ++i) {
+            assert(memcmp(system->atoms[i].position, system_copy->atoms[i].position, sizeof(vec_t)) == 0);
+        }
+    }
+    assert(traj_reader_read(reader) != 0);
+
+    // open window with a stride, reading the frames of the file from the start
+    assert(xdr_seek(xtc, 0, SEEK_SET) == exdrOK);
+    traj_reader_set_window(reader, -INFINITY, INFINITY, 4);
+    for (int frame = 0; frame <= 20; frame += 4) {
+        assert(traj_reader_read(reader) == 0);
+        assert(system->step == frame * 1000);
+    }
+    assert(traj_reader_read(reader) != 0);
+
+    // window without a stride
+    assert(xdr_seek(xtc, 0, SEEK_SET) == exdrOK);
+    traj_reader_set_window(reader, 33.0f, INFINITY, 0);
+    assert(reader->windowed);
+    for (int frame = 17; frame <= 20; ++frame) {
+        assert(traj_reader_read(reader) == 0);
+        assert(system->step == frame * 1000);
+    }
+    assert(traj_reader_read(reader) != 0);
+
+    // disabling the window
+    traj_reader_set_window(reader, -INFINITY, INFINITY, 1);
+    assert(!reader->windowed);
+    traj_reader_destroy(reader);
+    xdrfile_close(xtc);
+    xdrfile_close(xtc_copy);
+    free(data);
+    traj_index_destroy(index);
+
+    // trr file
+    all = select_system(system);
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    for (int frame = 0; frame < 10; ++frame) {
+        system->step = frame;
+        system->atoms[0].velocity[0] = (float) frame;
+        assert(write_trr_step(output, all, frame, frame * 0.5f, system->box, 0.0f) == 0);
+    }
+    xdrfile_close(output);
+
+    XDRFILE *trr = xdrfile_open("temporary.trr", "r");
+    reader = traj_reader_create(trr, system, traj_trr);
+    traj_reader_set_window(reader, 1.0f, 4.0f, 2);
+    reader->fields = TRR_V;
+    for (int frame = 2; frame <= 8; frame += 2) {
+        assert(traj_reader_read(reader) == 0);
+        assert(system->step == frame);
+        assert(system->atoms[0].velocity[0] == (float) frame);
+    }
+    assert(traj_reader_read(reader) != 0);
+    traj_reader_destroy(reader);
+    xdrfile_close(trr);
+    remove("temporary.trr");
+
+    free(all);
+    free(system);
+    free(system_copy);
+    printf("OK\n");
+}
+
+void test_scan_trajectory(void)
+{
+    printf("%-40s", "scan_xtc & scan_trr ");
+    fflush(stdout);
+
+    traj_scan_t report = {0};
+    assert(scan_xtc("nonexistent.xtc", 0, &report) != 0);
+
+    // intact file
+    assert(scan_xtc(INPUT_XTC_FILE, 0, &report) == 0);
+    assert(report.n_frames == 21);
+    assert(report.n_atoms == 48284);
+    assert(report.first_time == 0.0f && report.last_time == 40.0f && report.dt == 2.0f);
+    assert(report.n_dt_irregular == 0 && report.first_dt_irregular == -1);
+    assert(report.n_natoms_changes == 0 && report.first_natoms_change == -1);
+    assert(report.corrupt_offset == -1 && report.valid_size == report.file_size);
+    assert(!report.truncated);
+
+    // frames 0 to 9, then frames 12 to 14 and a part of frame 15
+    XDRFILE *xtc = xdrfile_open(INPUT_XTC_FILE, "r");
+    traj_index_t *index = build_xtc_index(xtc);
+    xdrfile_close(xtc);
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", 0, (long) index->frames[10].offset, "wb");
+    copy_file_part(INPUT_XTC_FILE, "temporary.xtc", (long) index->frames[12].offset, (long) index->frames[15].offset + 5000, "ab");
+    int64_t valid_size = index->frames[10].offset + index->frames[15].offset - index->frames[12].offset;
+
+    assert(scan_xtc("temporary.xtc", 0, &report) == 0);
+    assert(report.n_frames == 13);
+    assert(report.last_time == 28.0f);
+    assert(report.n_dt_irregular == 1 && report.first_dt_irregular == 10);
+    assert(report.corrupt_offset == valid_size && report.valid_size == valid_size);
+    assert(report.file_size == valid_size + 5000);
+    assert(!report.truncated);
+
+    // repairing the file
+    assert(scan_xtc("temporary.xtc", 1, &report) == 0);
+    assert(report.truncated);
+    assert(scan_xtc("temporary.xtc", 1, &report) == 0);
+    assert(!report.truncated && report.corrupt_offset == -1);
+    assert(report.n_frames == 13 && report.file_size == valid_size);
+    remove("temporary.xtc");
+    traj_index_destroy(index);
+
+    // trr file with a changing number of atoms followed by garbage
+    const int natoms = 100;
+    rvec *x = calloc(natoms, sizeof(rvec));
+    matrix box = {{1.0f, 0, 0}, {0, 1.0f, 0}, {0, 0, 1.0f}};
+    XDRFILE *output = xdrfile_open("temporary.trr", "w");
+    for (int frame = 0; frame < 6; ++frame) {
+        int n = frame < 4 ? natoms : natoms / 2;
+        assert(write_trr(output, n, frame, frame * 0.1f, 0.0f, box, x, x, NULL) == exdrOK);
+    }
+    xdrfile_close(output);
+    long size = 0;
+    free(read_whole_file("temporary.trr", &size));
+    FILE *file = fopen("temporary.trr", "ab");
+    assert(fwrite(x, 1, 64, file) == 64);
+    fclose(file);
+
+    assert(scan_trr("temporary.trr", 0, &report) == 0);
+    assert(report.n_frames == 6);
+    assert(report.n_atoms == natoms);
+    assert(closef(report.dt, 0.1, 0.00001));
+    assert(report.n_dt_irregular == 0);
+    assert(report.n_natoms_changes == 1 && report.first_natoms_change == 4);
+    assert(report.corrupt_offset == size && report.file_size == size + 64);
+    assert(scan_trr("temporary.trr", 1, &report) == 0);
+    assert(report.truncated);
+    assert(scan_trr("temporary.trr", 0, &report) == 0);
+    assert(report.corrupt_offset == -1 && report.file_size == size);
+
+    remove("temporary.trr");
+    free(x);
+    printf("OK\n");
+}
+
 void test_xdr(void)
 {
     test_box_xtc2gro();
@@ -467,9 +1904,29 @@ void test_xdr(void)
     test_reset_velocities();
 
     test_validate_xtc();
+    test_xdrfile_open_backends();
     test_read_xtc_step_first(INPUT_XTC_FILE);
     test_read_xtc_step_last(INPUT_XTC_FILE);
     test_write_xtc_step_full();
+    test_xtc_compression_roundtrip();
+    test_xtc_decodeints_generic();
+    test_xtc_compression_identical();
+    test_read_xtc_step_partial();
+    test_read_xtc_step_selection();
+    test_read_xtc_step_positions();
+    test_traj_reader_xtc();
+    test_build_xtc_index();
+    test_seek_xtc_frame();
+    test_load_xtc_index();
+    test_xtc_parallel();
+    test_xtc_prefetch();
+    test_xtc_writer();
+    test_traj_reader_trr();
+    test_read_trr_bulk();
+    test_read_trr_step_fields();
+    test_trr_index();
+    test_traj_reader_window();
+    test_scan_trajectory();
 
     test_validate_trr();
     test_read_trr_step_first4(INPUT_TRR_FILE);
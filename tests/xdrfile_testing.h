@@ -0,0 +1,38 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+/* Declarations of xdrfile functions that are only compiled for the tests.
+ * The `tests` make target builds its own copy of xdrfile.c with XDRFILE_TESTING defined. */
+
+#ifndef XDRFILE_TESTING_H
+#define XDRFILE_TESTING_H
+
+/*! \brief Decode packed integers using both integer decoders (for testing)
+ *
+ *  Decodes \a num_of_ints integers packed into the first \a num_of_bits
+ *  bits of \a data twice: using the native 64-bit and 128-bit division
+ *  used by the xtc decompression and using the byte-wise long division
+ *  kept for packed integers that do not fit into the native types.
+ *  Both results must always be identical.
+ *
+ *  \param data         Bit stream containing the packed integer
+ *  \param num_of_bytes Length of data (at least (num_of_bits + 7) / 8)
+ *  \param num_of_ints  Number of packed integers (at most 32)
+ *  \param num_of_bits  Number of bits of the packed integer (at most 256)
+ *  \param sizes        Ranges of the packed integers (each at most 2^23)
+ *  \param nums         Integers decoded using the native division
+ *  \param nums_generic Integers decoded using the byte-wise long division
+ *
+ *  \return             exdrOK on success, exdrNR for invalid arguments,
+ *                      exdrNOMEM if memory could not be allocated.
+ */
+int
+xdrfile_decodeints_check(const unsigned char * data,
+                         int                   num_of_bytes,
+                         int                   num_of_ints,
+                         int                   num_of_bits,
+                         unsigned int          sizes[],
+                         int                   nums[],
+                         int                   nums_generic[]);
+
+#endif /* XDRFILE_TESTING_H */